@@ -12,6 +12,8 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <algorithm>
+
 #include "common/exception.h"
 #include "common/macros.h"
 
@@ -32,7 +34,7 @@ BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManag
     free_list_.emplace_back(static_cast<int>(i));
     pages_[i].pin_count_ = 0;
     pages_[i].is_dirty_ = false;
-    pages_[i].page_id_ = 0;
+    pages_[i].page_id_ = INVALID_PAGE_ID;
   }
 
   /// TODO:(students): remove this line after you have implemented the buffer
@@ -50,29 +52,37 @@ BufferPoolManagerInstance::~BufferPoolManagerInstance() {
 }
 
 auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
-  std::scoped_lock<std::shared_mutex> lock(latch_);
+  std::unique_lock<std::shared_mutex> lock(latch_);
 
   frame_id_t frame_id;
 
-  if (!free_list_.empty()) {
-    frame_id = free_list_.front();
-    free_list_.pop_front();
-    // pages_[frame_id].WLatch();
-
-    // 这里不脏，从free_list_里面拿出来的都不脏。
-    pages_[frame_id].pin_count_ = 1;
-    *page_id = AllocatePage();
-    page_table_->Insert(*page_id, frame_id);
-    replacer_->RecordAccess(frame_id);
-    replacer_->SetEvictable(frame_id, false);
-    pages_[frame_id].page_id_ = *page_id;
-
-    // pages_[frame_id].WUnlatch();
-    return pages_ + frame_id;
-  }
+  // 挑中的帧日志还没落盘时，EvictFrame放掉latch_去刷日志，回来之后要从头看。
+  while (true) {
+    if (!free_list_.empty()) {
+      frame_id = free_list_.front();
+      free_list_.pop_front();
+      // pages_[frame_id].WLatch();
+
+      // 这里不脏，从free_list_里面拿出来的都不脏。
+      pages_[frame_id].pin_count_ = 1;
+      *page_id = AllocatePage();
+      page_table_->Insert(*page_id, frame_id);
+      replacer_->RecordAccess(frame_id);
+      replacer_->SetEvictable(frame_id, false);
+      pages_[frame_id].page_id_ = *page_id;
+      pages_[frame_id].rec_lsn_ = NewPageRecLSN();
+
+      // pages_[frame_id].WUnlatch();
+      return pages_ + frame_id;
+    }
 
-  if (!replacer_->Evict(&frame_id)) {
-    return nullptr;
+    auto eviction = EvictFrame(&lock, &frame_id);
+    if (eviction == Eviction::NONE) {
+      return nullptr;
+    }
+    if (eviction == Eviction::EVICTED) {
+      break;
+    }
   }
 
   *page_id = AllocatePage();
@@ -82,7 +92,7 @@ auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
   // pages_[frame_id].WLatch();
 
   if (pages_[frame_id].is_dirty_) {
-    disk_manager_->WritePage(pages_[frame_id].page_id_, pages_[frame_id].data_);
+    WritePage(frame_id);
   }
 
   // 这里不做修改。
@@ -93,49 +103,58 @@ auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
 
   pages_[frame_id].pin_count_ = 1;
   pages_[frame_id].page_id_ = *page_id;
+  pages_[frame_id].rec_lsn_ = NewPageRecLSN();
 
   // pages_[frame_id].WUnlatch();
   return pages_ + frame_id;
 }
 
 auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
-  std::scoped_lock<std::shared_mutex> lock(latch_);
+  std::unique_lock<std::shared_mutex> lock(latch_);
 
   frame_id_t frame_id = -1;
 
-  if (page_table_->Find(page_id, frame_id)) {
-    replacer_->RecordAccess(frame_id);
-    replacer_->SetEvictable(frame_id, false);
+  // 刷日志的时候放掉过latch_的话，别的线程可能已经把这一页读进来了，从头看。
+  while (true) {
+    if (page_table_->Find(page_id, frame_id)) {
+      replacer_->RecordAccess(frame_id);
+      replacer_->SetEvictable(frame_id, false);
 
-    // pages_[frame_id].WLatch();
-    pages_[frame_id].is_dirty_ = true;
-    ++pages_[frame_id].pin_count_;
-    // pages_[frame_id].WUnlatch();
+      // pages_[frame_id].WLatch();
+      pages_[frame_id].is_dirty_ = true;
+      ++pages_[frame_id].pin_count_;
+      // pages_[frame_id].WUnlatch();
 
-    return pages_ + frame_id;
-  }
+      return pages_ + frame_id;
+    }
 
-  if (!free_list_.empty()) {
-    frame_id = free_list_.front();
-    free_list_.pop_front();
+    if (!free_list_.empty()) {
+      frame_id = free_list_.front();
+      free_list_.pop_front();
 
-    // pages_[frame_id].WLatch();
-    pages_[frame_id].pin_count_ = 1;
-    pages_[frame_id].page_id_ = page_id;
-    disk_manager_->ReadPage(page_id, pages_[frame_id].data_);
+      // pages_[frame_id].WLatch();
+      pages_[frame_id].pin_count_ = 1;
+      pages_[frame_id].page_id_ = page_id;
+      disk_manager_->ReadPage(page_id, pages_[frame_id].data_);
+      pages_[frame_id].rec_lsn_ = pages_[frame_id].GetLSN();
 
-    // pages_[frame_id].WUnlatch();
+      // pages_[frame_id].WUnlatch();
 
-    page_table_->Insert(page_id, frame_id);
+      page_table_->Insert(page_id, frame_id);
 
-    replacer_->RecordAccess(frame_id);
-    replacer_->SetEvictable(frame_id, false);
+      replacer_->RecordAccess(frame_id);
+      replacer_->SetEvictable(frame_id, false);
 
-    return pages_ + frame_id;
-  }
+      return pages_ + frame_id;
+    }
 
-  if (!replacer_->Evict(&frame_id)) {
-    return nullptr;
+    auto eviction = EvictFrame(&lock, &frame_id);
+    if (eviction == Eviction::NONE) {
+      return nullptr;
+    }
+    if (eviction == Eviction::EVICTED) {
+      break;
+    }
   }
 
   page_table_->Remove(pages_[frame_id].page_id_);
@@ -147,13 +166,14 @@ auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
   // pages_[frame_id].WLatch();
 
   if (pages_[frame_id].is_dirty_) {
-    disk_manager_->WritePage(pages_[frame_id].page_id_, pages_[frame_id].data_);
+    WritePage(frame_id);
   }
 
   pages_[frame_id].ResetMemory();
   ++pages_[frame_id].pin_count_;
   pages_[frame_id].page_id_ = page_id;
   disk_manager_->ReadPage(page_id, pages_[frame_id].data_);
+  pages_[frame_id].rec_lsn_ = pages_[frame_id].GetLSN();
 
   // pages_[frame_id].WUnlatch();
   return pages_ + frame_id;
@@ -190,13 +210,18 @@ auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) ->
 }
 
 auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
-  std::scoped_lock<std::shared_mutex> lock(latch_);
+  std::unique_lock<std::shared_mutex> lock(latch_);
 
   frame_id_t frame_id;
 
-  if (page_table_->Find(page_id, frame_id)) {
+  while (page_table_->Find(page_id, frame_id)) {
+    if (!LogIsDurable(frame_id)) {
+      // 放掉latch_刷完日志之后页面可能已经被换出去了，重新找。
+      ForceLog(&lock, frame_id);
+      continue;
+    }
     // pages_[frame_id].WLatch();
-    disk_manager_->WritePage(page_id, pages_[frame_id].data_);
+    WritePage(frame_id);
     pages_[frame_id].is_dirty_ = false;
     // pages_[frame_id].WUnlatch();
     return true;
@@ -206,12 +231,22 @@ auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
-  std::scoped_lock<std::shared_mutex> lock(latch_);
+  // 先不拿latch_把现有的日志都刷下去，之后一般就不用为哪一页再刷了。
+  if (enable_logging && log_manager_ != nullptr) {
+    log_manager_->Flush(log_manager_->GetNextLSN() - 1);
+  }
+  std::unique_lock<std::shared_mutex> lock(latch_);
 
   for (page_id_t i = 0, j = -1; i < next_page_id_; ++i) {
     if (page_table_->Find(i, j)) {
+      if (!LogIsDurable(j)) {
+        // 放掉latch_刷日志期间这一页可能被换出去了，这一页重新找。
+        ForceLog(&lock, j);
+        --i;
+        continue;
+      }
       // pages_[j].WLatch();
-      disk_manager_->WritePage(i, pages_[j].data_);
+      WritePage(j);
       pages_[j].is_dirty_ = false;
       // pages_[j].WUnlatch();
     }
@@ -219,13 +254,19 @@ void BufferPoolManagerInstance::FlushAllPgsImp() {
 }
 
 auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
-  std::scoped_lock<std::shared_mutex> lock(latch_);
+  std::unique_lock<std::shared_mutex> lock(latch_);
 
   frame_id_t frame_id = -1;
 
   if (!page_table_->Find(page_id, frame_id)) {
     return true;
   }
+  while (pages_[frame_id].is_dirty_ && pages_[frame_id].pin_count_ == 0 && !LogIsDurable(frame_id)) {
+    ForceLog(&lock, frame_id);
+    if (!page_table_->Find(page_id, frame_id)) {
+      return true;
+    }
+  }
 
   // pages_[frame_id].WLatch();
   if (pages_[frame_id].pin_count_ > 0) {
@@ -235,12 +276,12 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
 
   // 脏了，写回去。
   if (pages_[frame_id].is_dirty_) {
-    disk_manager_->WritePage(pages_[frame_id].page_id_, pages_[frame_id].data_);
+    WritePage(frame_id);
   }
 
   pages_[frame_id].ResetMemory();
   pages_[frame_id].is_dirty_ = false;
-  pages_[frame_id].page_id_ = 0;
+  pages_[frame_id].page_id_ = INVALID_PAGE_ID;
 
   page_table_->Remove(page_id);
   replacer_->SetEvictable(frame_id, true);
@@ -256,4 +297,70 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
 // 仅在内部使用，无需上锁。
 auto BufferPoolManagerInstance::AllocatePage() -> page_id_t { return next_page_id_++; }
 
+void BufferPoolManagerInstance::WritePage(frame_id_t frame_id) {
+  // 先读LSN再写：写的时候还在改的那一处，它的LSN不会比这个小。
+  auto lsn = pages_[frame_id].GetLSN();
+  disk_manager_->WritePage(pages_[frame_id].page_id_, pages_[frame_id].data_);
+  pages_[frame_id].rec_lsn_ = lsn;
+}
+
+auto BufferPoolManagerInstance::LogIsDurable(frame_id_t frame_id) -> bool {
+  // 先写日志：页面上最新的修改对应的日志没落盘之前，页面不能写回去。
+  if (!enable_logging || log_manager_ == nullptr) {
+    return true;
+  }
+  // 不是每种页面都在4..7字节放LSN（比如header page），读出来的可能比发出去的任何LSN都大，永远等不到落盘。
+  // Flush最多也只刷到GetNextLSN() - 1，所以发出去的日志都落盘了就算可以写。按页面LSN、下一个LSN、落盘LSN的顺序读，
+  // 真正的LSN一定在读下一个LSN之前就发出去了。
+  auto lsn = pages_[frame_id].GetLSN();
+  auto last_lsn = log_manager_->GetNextLSN() - 1;
+  auto persistent_lsn = log_manager_->GetPersistentLSN();
+  return lsn <= persistent_lsn || last_lsn <= persistent_lsn;
+}
+
+void BufferPoolManagerInstance::ForceLog(std::unique_lock<std::shared_mutex> *lock, frame_id_t frame_id) {
+  // 写日志要等磁盘，不能让所有用缓冲池的线程陪着等。
+  auto lsn = pages_[frame_id].GetLSN();
+  lock->unlock();
+  log_manager_->Flush(lsn);
+  lock->lock();
+}
+
+auto BufferPoolManagerInstance::EvictFrame(std::unique_lock<std::shared_mutex> *lock, frame_id_t *frame_id)
+    -> Eviction {
+  if (!replacer_->Evict(frame_id)) {
+    return Eviction::NONE;
+  }
+  if (!pages_[*frame_id].is_dirty_ || LogIsDurable(*frame_id)) {
+    return Eviction::EVICTED;
+  }
+  // 还回替换器，刷日志的时候别人照样能用这一页。
+  replacer_->RecordAccess(*frame_id);
+  replacer_->SetEvictable(*frame_id, true);
+  ForceLog(lock, *frame_id);
+  return Eviction::RELATCHED;
+}
+
+auto BufferPoolManagerInstance::NewPageRecLSN() -> lsn_t {
+  // 新页面还没有任何修改，以后的修改都不会比现在的下一个LSN小。
+  return log_manager_ != nullptr ? log_manager_->GetNextLSN() : 0;
+}
+
+auto BufferPoolManagerInstance::GetDirtyPages() -> std::vector<std::pair<page_id_t, lsn_t>> {
+  std::scoped_lock<std::shared_mutex> lock(latch_);
+
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  for (size_t i = 0; i < pool_size_; ++i) {
+    frame_id_t frame_id = -1;
+    if (!page_table_->Find(pages_[i].page_id_, frame_id) || frame_id != static_cast<frame_id_t>(i)) {
+      continue;
+    }
+    // 被钉住的页面可能正在改，改完才会标脏，也要算上。索引页之类不记LSN，那个位置读出来可能是负数。
+    if (pages_[i].is_dirty_ || pages_[i].pin_count_ > 0) {
+      dirty_pages.emplace_back(pages_[i].page_id_, std::max(pages_[i].rec_lsn_, 0));
+    }
+  }
+  return dirty_pages;
+}
+
 }  // namespace bustub
@@ -1,3 +1,4 @@
+#include <chrono>  // NOLINT
 #include <optional>
 #include <shared_mutex>
 #include <string>
@@ -38,7 +39,10 @@
 namespace bustub {
 
 auto BustubInstance::MakeExecutorContext(Transaction *txn) -> std::unique_ptr<ExecutorContext> {
-  return std::make_unique<ExecutorContext>(txn, catalog_, buffer_pool_manager_, txn_manager_, lock_manager_);
+  auto exec_ctx =
+      std::make_unique<ExecutorContext>(txn, catalog_, buffer_pool_manager_, txn_manager_, lock_manager_);
+  exec_ctx->SetAggregationMemoryBudget(GetAggregationMemoryBudget());
+  return exec_ctx;
 }
 
 BustubInstance::BustubInstance(const std::string &db_file_name) {
@@ -146,6 +150,89 @@ void BustubInstance::CmdDisplayIndices(ResultWriter &writer) {
   writer.EndTable();
 }
 
+void BustubInstance::CmdDisplayLocks(const std::string &arg, ResultWriter &writer) {
+  auto *profiler = lock_manager_->GetProfiler();
+  if (arg == "json") {
+    WriteOneCell(profiler->ToJson(), writer);
+    return;
+  }
+  if (arg == "reset") {
+    profiler->Reset();
+    WriteOneCell("lock counters reset", writer);
+    return;
+  }
+  auto table_name = [this](table_oid_t oid) -> std::string {
+    if (oid >= LockProfiler::PROFILED_TABLES) {
+      return "(other)";
+    }
+    const auto *table_info = catalog_->GetTable(oid);
+    return table_info == Catalog::NULL_TABLE_INFO ? "" : table_info->name_;
+  };
+
+  writer.BeginTable(false);
+  writer.BeginHeader();
+  if (arg == "waits") {
+    // 谁在等、等的是什么、被谁挡着，出事时第一个要看的。
+    for (const auto *header : {"txn", "resource", "mode", "waited_us", "blocked_by"}) {
+      writer.WriteHeaderCell(header);
+    }
+    writer.EndHeader();
+    auto now = LockProfiler::Clock::now();
+    for (const auto &waiter : profiler->GetWaiters()) {
+      std::string resource;
+      if (waiter.rid_.has_value()) {
+        resource = fmt::format("row {} {}", table_name(waiter.oid_), waiter.rid_->ToString());
+      } else if (waiter.key_.has_value()) {
+        resource = fmt::format("key {} of index {}", *waiter.key_, waiter.oid_);
+      } else {
+        resource = fmt::format("table {}", table_name(waiter.oid_));
+      }
+      writer.BeginRow();
+      writer.WriteCell(fmt::format("{}", waiter.txn_id_));
+      writer.WriteCell(resource);
+      writer.WriteCell(waiter.mode_);
+      writer.WriteCell(
+          fmt::format("{}", std::chrono::duration_cast<std::chrono::microseconds>(now - waiter.since_).count()));
+      writer.WriteCell(fmt::format("{}", fmt::join(waiter.blockers_, ",")));
+      writer.EndRow();
+    }
+  } else if (arg == "rows") {
+    constexpr size_t rows_shown = 20;
+    for (const auto *header : {"table", "rid", "sampled_acquisitions", "waits", "wait_us"}) {
+      writer.WriteHeaderCell(header);
+    }
+    writer.EndHeader();
+    for (const auto &[row, counters] : profiler->GetRowCounters(rows_shown)) {
+      writer.BeginRow();
+      writer.WriteCell(table_name(row.first));
+      writer.WriteCell(row.second.ToString());
+      writer.WriteCell(fmt::format("{}", counters.sampled_acquisitions_));
+      writer.WriteCell(fmt::format("{}", counters.waits_));
+      writer.WriteCell(fmt::format("{}", counters.wait_us_));
+      writer.EndRow();
+    }
+  } else {
+    for (const auto *header :
+         {"oid", "table", "acquisitions", "upgrades", "row_acquisitions", "row_upgrades", "waits", "wait_us"}) {
+      writer.WriteHeaderCell(header);
+    }
+    writer.EndHeader();
+    for (const auto &[oid, counters] : profiler->GetTableCounters()) {
+      writer.BeginRow();
+      writer.WriteCell(fmt::format("{}", oid));
+      writer.WriteCell(table_name(oid));
+      writer.WriteCell(fmt::format("{}", counters.acquisitions_));
+      writer.WriteCell(fmt::format("{}", counters.upgrades_));
+      writer.WriteCell(fmt::format("{}", counters.row_acquisitions_));
+      writer.WriteCell(fmt::format("{}", counters.row_upgrades_));
+      writer.WriteCell(fmt::format("{}", counters.waits_));
+      writer.WriteCell(fmt::format("{}", counters.wait_us_));
+      writer.EndRow();
+    }
+  }
+  writer.EndTable();
+}
+
 void BustubInstance::WriteOneCell(const std::string &cell, ResultWriter &writer) {
   writer.BeginTable(true);
   writer.BeginRow();
@@ -159,6 +246,11 @@ void BustubInstance::CmdDisplayHelp(ResultWriter &writer) {
 
 \dt: show all tables
 \di: show all indices
+\locks: show lock grants and waits per table
+\locks rows: show the hottest rows
+\locks waits: show who is blocking whom right now
+\locks json: dump all lock counters as JSON
+\locks reset: zero the lock counters
 \help: show this message again
 
 BusTub shell currently only supports a small set of Postgres queries. We'll set
@@ -174,6 +266,9 @@ see the execution plan of your query.
 
 auto BustubInstance::ExecuteSql(const std::string &sql, ResultWriter &writer) -> bool {
   auto txn = txn_manager_->Begin();
+  if (IsAsyncCommit()) {
+    txn->SetCommitMode(CommitMode::ASYNCHRONOUS);
+  }
   auto result = ExecuteSqlTxn(sql, writer, txn);
   txn_manager_->Commit(txn);
   delete txn;
@@ -191,6 +286,10 @@ auto BustubInstance::ExecuteSqlTxn(const std::string &sql, ResultWriter &writer,
       CmdDisplayIndices(writer);
       return true;
     }
+    if (sql == "\\locks" || sql.rfind("\\locks ", 0) == 0) {
+      CmdDisplayLocks(sql.size() > 7 ? StringUtil::Strip(sql.substr(7), ' ') : "", writer);
+      return true;
+    }
     if (sql == "\\help") {
       CmdDisplayHelp(writer);
       return true;
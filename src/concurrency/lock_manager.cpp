@@ -15,9 +15,11 @@
 #include <cstddef>
 #include <cstdio>
 #include <functional>
+#include <limits>
 #include <list>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <optional>
 #include <shared_mutex>
 #include <string>
 #include <unordered_map>
@@ -50,6 +52,7 @@ auto CheckLockMode(LockManager::LockMode lock_mode) -> std::string {
 }
 
 void LockManager::ThrowException(txn_id_t tid, AbortReason reason, int line) {
+  profiler_.RecordAbort(reason);
   auto tmp = TransactionAbortException(tid, reason);
   // printf("throw in line %d message : %s\n", line, tmp.GetInfo().c_str());
   throw tmp;
@@ -129,13 +132,24 @@ void LockManager::TableLockAllocate(Transaction *txn, LockMode lock_mode, table_
   }
 }
 
+void LockManager::KeyLockAllocate(Transaction *txn, LockMode lock_mode, index_oid_t index_oid, int64_t key) {
+  auto key_lock_set = lock_mode == LockMode::SHARED ? txn->GetSharedKeyLockSet() : txn->GetExclusiveKeyLockSet();
+  (*key_lock_set)[index_oid].emplace(key);
+}
+
+void LockManager::KeyLockRemove(Transaction *txn, LockMode lock_mode, index_oid_t index_oid, int64_t key) {
+  auto key_lock_set = lock_mode == LockMode::SHARED ? txn->GetSharedKeyLockSet() : txn->GetExclusiveKeyLockSet();
+  (*key_lock_set)[index_oid].erase(key);
+}
+
 void LockManager::SetState(Transaction *txn, IsolationLevel ioslevel, LockMode lock_mode) {
   if (txn->GetState() == TransactionState::ABORTED || txn->GetState() == TransactionState::COMMITTED) {
     return;
   }
   // 意向锁不改变事务的状态。
 
-  if (ioslevel == IsolationLevel::REPEATABLE_READ &&
+  // 快照隔离的写锁和REPEATABLE_READ一样，两阶段持有到提交。
+  if ((ioslevel == IsolationLevel::REPEATABLE_READ || ioslevel == IsolationLevel::SNAPSHOT_ISOLATION) &&
       (lock_mode == LockMode::EXCLUSIVE || lock_mode == LockMode::SHARED)) {
     txn->SetState(TransactionState::SHRINKING);
     return;
@@ -175,8 +189,299 @@ auto LockManager::CheckLock(LockMode lock_mode_, LockMode lock_mode) -> bool {
   return true;
 }
 
-auto LockManager::GrantLock(std::shared_ptr<LockRequestQueue> &que, LockMode lock_mode,
-                            std::shared_ptr<LockRequest> &lr, txn_id_t tid) -> bool {
+auto LockManager::HoldsTableLock(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool {
+  // 锁集合只有事务自己的线程会改，这里不加锁直接查。
+  if (txn->IsTableExclusiveLocked(oid)) {
+    return true;
+  }
+  bool six = txn->IsTableSharedIntentionExclusiveLocked(oid);
+  switch (lock_mode) {
+    case LockMode::INTENTION_SHARED:
+      return six || txn->IsTableIntentionSharedLocked(oid) || txn->IsTableSharedLocked(oid) ||
+             txn->IsTableIntentionExclusiveLocked(oid);
+    case LockMode::SHARED:
+      return six || txn->IsTableSharedLocked(oid);
+    case LockMode::INTENTION_EXCLUSIVE:
+      return six || txn->IsTableIntentionExclusiveLocked(oid);
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return six;
+    default:
+      return false;
+  }
+}
+
+auto LockManager::TableLockCovers(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool {
+  // 只看升级过的表，事务自己申请的表锁照旧加行锁。
+  if (!txn->IsTableEscalated(oid)) {
+    return false;
+  }
+  if (txn->IsTableExclusiveLocked(oid)) {
+    return true;
+  }
+  return lock_mode == LockMode::SHARED &&
+         (txn->IsTableSharedLocked(oid) || txn->IsTableSharedIntentionExclusiveLocked(oid));
+}
+
+void LockManager::EscalateRowLocks(Transaction *txn, LockMode lock_mode, table_oid_t oid) {
+  // S行锁：IS -> S，IX -> SIX；X行锁：IX/SIX -> X。都在允许的升级路径里。
+  LockMode target;
+  if (lock_mode == LockMode::SHARED && txn->IsTableIntentionSharedLocked(oid)) {
+    target = LockMode::SHARED;
+  } else if (lock_mode == LockMode::SHARED && txn->IsTableIntentionExclusiveLocked(oid)) {
+    target = LockMode::SHARED_INTENTION_EXCLUSIVE;
+  } else if (lock_mode == LockMode::EXCLUSIVE &&
+             (txn->IsTableIntentionExclusiveLocked(oid) || txn->IsTableSharedIntentionExclusiveLocked(oid))) {
+    target = LockMode::EXCLUSIVE;
+  } else {
+    return;
+  }
+
+  // 收缩阶段只有READ_COMMITTED还能加S锁，表锁也一样。
+  if (txn->GetState() == TransactionState::SHRINKING && target != LockMode::SHARED) {
+    return;
+  }
+
+  if (!TryUpgradeTableLock(txn, target, oid)) {
+    return;
+  }
+  txn->GetEscalatedTableSet()->insert(oid);
+
+  // 表锁已经覆盖了这些行，放掉行锁，但不像UnlockRow那样改变事务状态。
+  auto drop = [this, txn, oid](const std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> &set) {
+    auto iter = set->find(oid);
+    if (iter == set->end()) {
+      return;
+    }
+    for (const auto &rid : iter->second) {
+      DropRowLock(txn, rid);
+    }
+    set->erase(iter);
+  };
+  drop(txn->GetSharedRowLockSet());
+  if (target == LockMode::EXCLUSIVE) {
+    drop(txn->GetExclusiveRowLockSet());
+  }
+}
+
+auto LockManager::TryUpgradeTableLock(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool {
+  table_lock_map_latch_.lock();
+  auto que_iter = table_lock_map_.find(oid);
+  if (que_iter == table_lock_map_.end()) {
+    table_lock_map_latch_.unlock();
+    return false;
+  }
+  auto que = que_iter->second;
+  std::unique_lock<std::mutex> lock(que->latch_);
+  table_lock_map_latch_.unlock();
+
+  // 别人正在升级，或者别的事务持有不兼容的锁，就不升级，绝不在这里等待。
+  if (que->upgrading_ != INVALID_TXN_ID) {
+    return false;
+  }
+  txn_id_t id = txn->GetTransactionId();
+  LockRequest *held = nullptr;
+  for (auto *lr : que->request_queue_) {
+    if (lr->txn_id_ == id) {
+      held = lr;
+    } else if (lr->granted_ && !CheckLock(lr->lock_mode_, lock_mode)) {
+      return false;
+    }
+  }
+  if (held == nullptr || !held->granted_) {
+    return false;
+  }
+
+  // 原地换掉模式，排在后面等待的请求本来就在等，不用唤醒。
+  TableLockRemove(txn, held->lock_mode_, oid);
+  held->lock_mode_ = lock_mode;
+  TableLockAllocate(txn, lock_mode, oid);
+  return true;
+}
+
+void LockManager::DropRowLock(Transaction *txn, const RID &rid) {
+  auto &shard = GetRowLockShard(rid);
+  shard.latch_.lock();
+  auto que_iter = shard.lock_map_.find(rid);
+  if (que_iter == shard.lock_map_.end()) {
+    shard.latch_.unlock();
+    return;
+  }
+  auto *que = &que_iter->second;
+  std::unique_lock<std::mutex> lock(que->latch_);
+  shard.latch_.unlock();
+
+  txn_id_t id = txn->GetTransactionId();
+  auto iter = std::find_if(que->request_queue_.begin(), que->request_queue_.end(),
+                           [id](LockRequest *lr) { return lr->granted_ && lr->txn_id_ == id; });
+  if (iter != que->request_queue_.end()) {
+    que->FreeRequest(iter);
+    que->NotifyWaiters();
+  }
+}
+
+auto LockManager::IsAborted(txn_id_t tid) -> bool {
+  // 已经结束的事务不会再挡着谁，当作已经放弃。
+  auto *txn = TransactionManager::GetTransaction(tid);
+  return txn == nullptr || txn->GetState() == TransactionState::ABORTED;
+}
+
+auto LockManager::StartTs(txn_id_t tid) -> timestamp_t {
+  // 已经结束的事务当作最年轻的，反正谁也不会再等它。
+  auto *txn = TransactionManager::GetTransaction(tid);
+  return txn == nullptr ? std::numeric_limits<timestamp_t>::max() : txn->GetStartTs();
+}
+
+auto LockManager::CollectBlockers(LockRequestQueue *que, LockRequest *lr) -> std::vector<txn_id_t> {
+  // 已授予的不兼容锁，以及排在前面的不兼容请求，都挡着这个请求。
+  std::vector<txn_id_t> blockers;
+  std::vector<txn_id_t> ahead;
+  bool is_ahead = true;
+  for (auto *other : que->request_queue_) {
+    if (other == lr) {
+      is_ahead = false;
+      continue;
+    }
+    if (other->txn_id_ == lr->txn_id_) {
+      continue;
+    }
+    if ((other->granted_ || is_ahead) && !CheckLock(other->lock_mode_, lr->lock_mode_)) {
+      blockers.push_back(other->txn_id_);
+    } else if (is_ahead) {
+      ahead.push_back(other->txn_id_);
+    }
+  }
+  if (que->upgrading_ != INVALID_TXN_ID && que->upgrading_ != lr->txn_id_) {
+    blockers.push_back(que->upgrading_);
+  }
+  // 和谁都兼容却还是拿不到，那就是被前面排队的请求挡住了。
+  return blockers.empty() ? ahead : blockers;
+}
+
+auto LockManager::PrepareToWait(LockRequestQueue *que, std::unique_lock<std::mutex> *lock, Transaction *txn,
+                                LockRequest *lr) -> WaitDecision {
+  // 周期检测由后台线程负责，这里直接等。
+  if (policy_ == DeadlockPolicy::DETECTION) {
+    return WaitDecision::WAIT;
+  }
+
+  txn_id_t id = txn->GetTransactionId();
+  timestamp_t start_ts = txn->GetStartTs();
+  auto blockers = CollectBlockers(que, lr);
+
+  // wait-die：只有老的等年轻的，等待边总是从老指向年轻，不可能成环。
+  if (policy_ == DeadlockPolicy::WAIT_DIE) {
+    bool die = std::any_of(blockers.begin(), blockers.end(),
+                           [start_ts](txn_id_t blocker) { return StartTs(blocker) < start_ts; });
+    return die ? WaitDecision::DIE : WaitDecision::WAIT;
+  }
+
+  std::vector<txn_id_t> victims;
+  {
+    std::scoped_lock<std::mutex> waits_lock(waits_for_latch_);
+    // 每次要等之前都重新登记出边，挡路的事务可能已经变了。
+    waits_for_.erase(id);
+    for (auto blocker : blockers) {
+      AddEdge(id, blocker);
+    }
+    waiting_on_[id] = que;
+
+    if (policy_ == DeadlockPolicy::WOUND_WAIT) {
+      // 有更老的事务在等自己，说明自己早该被wound了，自己退出。
+      for (const auto &[waiter, edges] : waits_for_) {
+        if (edges.count(id) > 0 && StartTs(waiter) < start_ts && !IsAborted(waiter)) {
+          return WaitDecision::DIE;
+        }
+      }
+      // 只wound正在等锁的年轻事务；还在运行的那个等它自己去等锁时发现有老事务在等它。
+      for (auto blocker : blockers) {
+        if (start_ts < StartTs(blocker) && waiting_on_.count(blocker) > 0 && !IsAborted(blocker)) {
+          victims.push_back(blocker);
+        }
+      }
+    } else {
+      // 增量检测：只有新加的出边可能形成环，所以只从自己出发找。
+      std::vector<txn_id_t> cycle;
+      if (FindCycle(id, &cycle)) {
+        txn_id_t victim = *std::max_element(cycle.begin(), cycle.end(),
+                                            [](txn_id_t a, txn_id_t b) { return StartTs(a) < StartTs(b); });
+        if (victim == id) {
+          return WaitDecision::DIE;
+        }
+        victims.push_back(victim);
+      }
+    }
+  }
+
+  if (victims.empty()) {
+    return WaitDecision::WAIT;
+  }
+  // 叫醒别的队列上的事务要拿那个队列的锁，先放掉自己的，避免两个队列互相等。
+  lock->unlock();
+  for (auto victim : victims) {
+    Wound(victim);
+  }
+  lock->lock();
+  return WaitDecision::RETRY;
+}
+
+void LockManager::StopWaiting(txn_id_t tid) {
+  if (policy_ == DeadlockPolicy::DETECTION || policy_ == DeadlockPolicy::WAIT_DIE) {
+    return;
+  }
+  std::scoped_lock<std::mutex> waits_lock(waits_for_latch_);
+  waits_for_.erase(tid);
+  waiting_on_.erase(tid);
+}
+
+auto LockManager::FindCycle(txn_id_t tid, std::vector<txn_id_t> *cycle) -> bool {
+  std::unordered_set<txn_id_t> visited;
+  std::function<bool(txn_id_t)> dfs = [&](txn_id_t now) -> bool {
+    cycle->push_back(now);
+    auto iter = waits_for_.find(now);
+    if (iter != waits_for_.end()) {
+      for (auto next : iter->second) {
+        if (next == tid) {
+          return true;
+        }
+        if (visited.count(next) > 0 || IsAborted(next)) {
+          continue;
+        }
+        visited.emplace(next);
+        if (dfs(next)) {
+          return true;
+        }
+      }
+    }
+    cycle->pop_back();
+    return false;
+  };
+  visited.emplace(tid);
+  return dfs(tid);
+}
+
+void LockManager::Wound(txn_id_t tid) {
+  auto *txn = TransactionManager::GetTransaction(tid);
+  if (txn == nullptr) {
+    return;
+  }
+  txn->SetState(TransactionState::ABORTED);
+  profiler_.RecordDeadlockVictim();
+  LockRequestQueue *que = nullptr;
+  {
+    std::scoped_lock<std::mutex> waits_lock(waits_for_latch_);
+    auto iter = waiting_on_.find(tid);
+    if (iter != waiting_on_.end()) {
+      que = iter->second;
+    }
+  }
+  // 先改状态再找队列：它要是之后才开始等，等之前一定能看到自己已经被杀死了。
+  if (que != nullptr) {
+    std::scoped_lock<std::mutex> que_lock(que->latch_);
+    que->cv_.notify_all();
+  }
+}
+
+auto LockManager::GrantLock(LockRequestQueue *que, LockMode lock_mode, LockRequest *lr, txn_id_t tid) -> bool {
   // 第一步，检查申请类型与已经granted_的是否兼容。
   // for (const auto &it : que->request_queue_) {
   //   if (!it->granted_) {
@@ -214,15 +519,15 @@ auto LockManager::GrantLock(std::shared_ptr<LockRequestQueue> &que, LockMode loc
   // }
 
   // return false;
-  for (auto &i : que->request_queue_) {
+  for (auto *i : que->request_queue_) {
     if (i->granted_ && !CheckLock(i->lock_mode_, lock_mode)) {
       return false;
     }
   }
 
-  for (auto &i : que->request_queue_) {
+  for (auto *i : que->request_queue_) {
     if (!i->granted_) {
-      for (auto &j : que->request_queue_) {
+      for (auto *j : que->request_queue_) {
         if (i == j) {
           break;
         }
@@ -274,7 +579,8 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
     if (state == TransactionState::SHRINKING) {
       // REPEATABLE_READ不能申请锁。
       // 因为前面先判断了READ_UNCOMMITTED，所以这里可以直接返回。
-      if (ioslevel == IsolationLevel::REPEATABLE_READ || ioslevel == IsolationLevel::READ_UNCOMMITTED) {
+      if (ioslevel == IsolationLevel::REPEATABLE_READ || ioslevel == IsolationLevel::READ_UNCOMMITTED ||
+          ioslevel == IsolationLevel::SNAPSHOT_ISOLATION) {
         // throw TransactionAbortException(id, AbortReason::LOCK_ON_SHRINKING);
         txn->SetState(TransactionState::ABORTED);
 
@@ -300,6 +606,16 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
   // 现在，锁事务一定处于可以申请锁的阶段。
   // 可以开始尝试获取锁。
 
+  // 行锁升级把IS换成了S，事务之后再来要IX时，S加IX就是SIX，按S -> SIX升级，而不是当成S -> IX的反向升级。
+  if (lock_mode == LockMode::INTENTION_EXCLUSIVE && txn->IsTableEscalated(oid) && txn->IsTableSharedLocked(oid)) {
+    lock_mode = LockMode::SHARED_INTENTION_EXCLUSIVE;
+  }
+
+  // 已经持有同样或更强的锁，不用进全局的map，连闩都不用拿。连接内侧每次重新Init都会走到这里。
+  if (HoldsTableLock(txn, lock_mode, oid)) {
+    return true;
+  }
+
   // 第二步，获取table对应的lock request queue。
   table_lock_map_latch_.lock();
 
@@ -320,7 +636,7 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
   {
     // 寻找tid相同的事务。
     auto iter = std::find_if(que->request_queue_.begin(), que->request_queue_.end(),
-                             [id](std::shared_ptr<LockRequest> &lr) -> bool { return lr->txn_id_ == id; });
+                             [id](LockRequest *lr) -> bool { return lr->txn_id_ == id; });
 
     // 存在，且这个时候granted_一定为true；
     if (iter != que->request_queue_.end()) {
@@ -367,25 +683,41 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
       TableLockRemove(txn, (*iter)->lock_mode_, oid);
       upgrade = true;
       que->upgrading_ = id;
-      que->request_queue_.erase(iter);
+      que->FreeRequest(iter);
     }
   }
 
   // 第四步，将锁请求放入请求队列。
-  std::shared_ptr<LockRequest> lr(new LockRequest(id, lock_mode, oid));
-  que->request_queue_.push_back(lr);
+  // 请求从队列自己的池子里拿，不用每次都new。
+  LockRequest *lr = que->NewRequest(id, lock_mode, oid);
+  // 队列里没有别人就直接授予，不用扫描队列也不用碰条件变量。
+  bool uncontended = que->request_queue_.Empty();
+  que->request_queue_.PushBack(lr);
 
   // 第五步，尝试获取锁。
   // 条件变量并不是某一个特定语言中的概念，而是操作系统中线程同步的一种机制。
 
-  while (!GrantLock(que, lock_mode, lr, id)) {
-    que->cv_.wait(lock);
+  bool waited = false;
+  while (!uncontended && !GrantLock(que.get(), lock_mode, lr, id)) {
+    auto decision = PrepareToWait(que.get(), &lock, txn, lr);
+    if (decision == WaitDecision::DIE) {
+      txn->SetState(TransactionState::ABORTED);
+      profiler_.RecordDeadlockVictim();
+    } else if (decision == WaitDecision::WAIT && txn->GetState() != TransactionState::ABORTED) {
+      // 记下谁在等、被谁挡着。只有真的要等才走到这里，不碰没有冲突的路径。
+      profiler_.BeginWait({id, oid, std::nullopt, std::nullopt, CheckLockMode(lock_mode),
+                           CollectBlockers(que.get(), lr), LockProfiler::Clock::now()});
+      waited = true;
+      que->waiters_++;
+      que->cv_.wait(lock);
+      que->waiters_--;
+    }
     // printf("%d wake up\n", id);
     if (txn->GetState() == TransactionState::ABORTED) {
       for (auto it = que->request_queue_.begin(); it != que->request_queue_.end();) {
         if ((*it)->txn_id_ == id) {
           TableLockRemove(txn, (*it)->lock_mode_, (*it)->oid_);
-          it = que->request_queue_.erase(it);
+          it = que->FreeRequest(it);
         } else {
           ++it;
         }
@@ -394,13 +726,23 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
       if (que->upgrading_ == id) {
         que->upgrading_ = INVALID_TXN_ID;
       }
-      que->cv_.notify_all();
+      que->NotifyWaiters();
       // printf("%d be killed\n", id);
       // RemovePoint(txn, id);
+      StopWaiting(id);
+      if (waited) {
+        profiler_.EndWait(id);
+      }
 
       return false;
     }
   }
+  if (!uncontended) {
+    StopWaiting(id);
+  }
+  if (waited) {
+    profiler_.EndWait(id);
+  }
 
   lr->granted_ = true;
 
@@ -409,6 +751,7 @@ auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, const table_oi
   if (upgrade) {
     que->upgrading_ = INVALID_TXN_ID;
   }
+  profiler_.RecordTableLock(oid, upgrade);
 
   return true;
   // } catch (...) {
@@ -464,7 +807,7 @@ auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool
   }
 
   auto iter = std::find_if(que->request_queue_.begin(), que->request_queue_.end(),
-                           [id](std::shared_ptr<LockRequest> &lr) { return lr->granted_ && lr->txn_id_ == id; });
+                           [id](LockRequest *lr) { return lr->granted_ && lr->txn_id_ == id; });
 
   if (iter == que->request_queue_.end()) {
     //
@@ -483,10 +826,11 @@ auto LockManager::UnlockTable(Transaction *txn, const table_oid_t &oid) -> bool
   }
 
   if (iter != que->request_queue_.end()) {
-    que->request_queue_.erase(iter);
+    que->FreeRequest(iter);
   }
   TableLockRemove(txn, lock_mode, oid);
-  que->cv_.notify_all();
+  txn->GetEscalatedTableSet()->erase(oid);
+  que->NotifyWaiters();
 
   return true;
   // } catch (...) {
@@ -561,7 +905,8 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
     if (state == TransactionState::SHRINKING) {
       // REPEATABLE_READ不能申请锁。
       // 因为前面先判断了READ_UNCOMMITTED，所以这里可以直接返回。
-      if (ioslevel == IsolationLevel::REPEATABLE_READ || ioslevel == IsolationLevel::READ_UNCOMMITTED) {
+      if (ioslevel == IsolationLevel::REPEATABLE_READ || ioslevel == IsolationLevel::READ_UNCOMMITTED ||
+          ioslevel == IsolationLevel::SNAPSHOT_ISOLATION) {
         //
         // throw TransactionAbortException(id, AbortReason::LOCK_ON_SHRINKING);
         txn->SetState(TransactionState::ABORTED);
@@ -586,24 +931,32 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
   // 现在，锁事务一定处于可以申请锁的阶段。
   // 可以开始尝试获取锁。
 
-  // 第二步，获取table对应的lock request queue。
-  row_lock_map_latch_.lock();
+  // 这一行已经持有同样或更强的锁，不用去分片里找队列。
+  if (txn->IsRowExclusiveLocked(oid, rid) || (lock_mode == LockMode::SHARED && txn->IsRowSharedLocked(oid, rid))) {
+    return true;
+  }
 
-  if (row_lock_map_.count(rid) == 0) {
-    std::shared_ptr<LockRequestQueue> tmp(new LockRequestQueue());
-    row_lock_map_[rid] = tmp;
+  // 行锁已经升级成表锁了，被表锁覆盖的行不用再进队列。
+  if (TableLockCovers(txn, lock_mode, oid)) {
+    return true;
   }
-  auto &que = row_lock_map_[rid];
+
+  // 第二步，获取rid对应的lock request queue。
+  // 行锁表按rid分片，每个分片一把锁，不同分片上的行锁互不干扰。
+  auto &shard = GetRowLockShard(rid);
+  shard.latch_.lock();
+  // 队列直接放在map的节点里，节点地址不会变，第一次锁这一行时也只分配一次。
+  auto *que = &shard.lock_map_[rid];
 
   std::unique_lock<std::mutex> lock(que->latch_);
-  row_lock_map_latch_.unlock();
+  shard.latch_.unlock();
   bool upgrade = false;
 
   // 第三步，检查是否为锁升级。
   {
     // 寻找tid一样的
     auto iter = std::find_if(que->request_queue_.begin(), que->request_queue_.end(),
-                             [id](std::shared_ptr<LockRequest> &lr) -> bool { return lr->txn_id_ == id; });
+                             [id](LockRequest *lr) -> bool { return lr->txn_id_ == id; });
 
     // 存在，且这个时候granted_一定为true；
     if (iter != que->request_queue_.end()) {
@@ -641,26 +994,40 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
       RowLockRemove(txn, (*iter)->lock_mode_, oid, rid);
       que->upgrading_ = id;
       upgrade = true;
-      que->request_queue_.erase(iter);
+      que->FreeRequest(iter);
     }
   }
 
   // 第四步，将锁请求放入请求队列。
   // 小溪了，这里应该是RID的请求。
-  std::shared_ptr<LockRequest> lr(new LockRequest(id, lock_mode, oid, rid));
-  que->request_queue_.push_back(lr);
+  LockRequest *lr = que->NewRequest(id, lock_mode, oid, rid);
+  bool uncontended = que->request_queue_.Empty();
+  que->request_queue_.PushBack(lr);
 
   // 第五步，尝试获取锁。
   // 条件变量并不是某一个特定语言中的概念，而是操作系统中线程同步的一种机制。
 
-  while (!GrantLock(que, lock_mode, lr, id)) {
-    que->cv_.wait(lock);
+  bool waited = false;
+  while (!uncontended && !GrantLock(que, lock_mode, lr, id)) {
+    auto decision = PrepareToWait(que, &lock, txn, lr);
+    if (decision == WaitDecision::DIE) {
+      txn->SetState(TransactionState::ABORTED);
+      profiler_.RecordDeadlockVictim();
+    } else if (decision == WaitDecision::WAIT && txn->GetState() != TransactionState::ABORTED) {
+      // 记下谁在等、被谁挡着。只有真的要等才走到这里，不碰没有冲突的路径。
+      profiler_.BeginWait({id, oid, rid, std::nullopt, CheckLockMode(lock_mode), CollectBlockers(que, lr),
+                           LockProfiler::Clock::now()});
+      waited = true;
+      que->waiters_++;
+      que->cv_.wait(lock);
+      que->waiters_--;
+    }
     //  printf("%d wake up\n", id);
     if (txn->GetState() == TransactionState::ABORTED) {
       for (auto it = que->request_queue_.begin(); it != que->request_queue_.end();) {
         if ((*it)->txn_id_ == id) {
           RowLockRemove(txn, (*it)->lock_mode_, (*it)->oid_, rid);
-          it = que->request_queue_.erase(it);
+          it = que->FreeRequest(it);
         } else {
           ++it;
         }
@@ -669,13 +1036,23 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
       if (que->upgrading_ == id) {
         que->upgrading_ = INVALID_TXN_ID;
       }
-      que->cv_.notify_all();
+      que->NotifyWaiters();
       // printf("%d be killed\n", id);
       // RemovePoint(txn, id);
+      StopWaiting(id);
+      if (waited) {
+        profiler_.EndWait(id);
+      }
 
       return false;
     }
   }
+  if (!uncontended) {
+    StopWaiting(id);
+  }
+  if (waited) {
+    profiler_.EndWait(id);
+  }
 
   lr->granted_ = true;
 
@@ -684,6 +1061,18 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
   }
 
   RowLockAllocate(txn, lock_mode, oid, rid);
+  lock.unlock();
+  profiler_.RecordRowLock(oid, rid, upgrade);
+
+  // 这张表上的行锁每攒够一个阈值，就试着升级成表锁。
+  size_t threshold = txn->GetLockEscalationThreshold();
+  if (threshold > 0) {
+    auto &row_lock_set = lock_mode == LockMode::SHARED ? (*txn->GetSharedRowLockSet())[oid]
+                                                       : (*txn->GetExclusiveRowLockSet())[oid];
+    if (row_lock_set.size() % threshold == 0) {
+      EscalateRowLocks(txn, lock_mode, oid);
+    }
+  }
 
   return true;
   // } catch (...) {
@@ -696,22 +1085,24 @@ auto LockManager::LockRow(Transaction *txn, LockMode lock_mode, const table_oid_
 auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID &rid) -> bool {
   // try {
   // printf("tid : %d unlock oid : %d rid : %s \n", txn->GetTransactionId(), oid, rid.ToString().c_str());
-  row_lock_map_latch_.lock();
+  auto &shard = GetRowLockShard(rid);
+  shard.latch_.lock();
 
-  if (row_lock_map_.count(rid) == 0) {
+  auto que_iter = shard.lock_map_.find(rid);
+  if (que_iter == shard.lock_map_.end()) {
     txn->SetState(TransactionState::ABORTED);
-    row_lock_map_latch_.unlock();
+    shard.latch_.unlock();
 
     ThrowException(txn->GetTransactionId(), AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD, 584);
     return false;
   }
-  auto &que = row_lock_map_[rid];
+  auto *que = &que_iter->second;
   std::unique_lock<std::mutex> lock(que->latch_);
-  row_lock_map_latch_.unlock();
+  shard.latch_.unlock();
   txn_id_t id = txn->GetTransactionId();
 
   auto iter = std::find_if(que->request_queue_.begin(), que->request_queue_.end(),
-                           [id](std::shared_ptr<LockRequest> &lr) { return lr->granted_ && lr->txn_id_ == id; });
+                           [id](LockRequest *lr) { return lr->granted_ && lr->txn_id_ == id; });
 
   if (iter == que->request_queue_.end() && txn->GetState() != TransactionState::ABORTED &&
       txn->GetState() != TransactionState::COMMITTED) {
@@ -731,9 +1122,9 @@ auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID
   }
 
   if (iter != que->request_queue_.end()) {
-    que->request_queue_.erase(iter);
+    que->FreeRequest(iter);
   }
-  que->cv_.notify_all();
+  que->NotifyWaiters();
   RowLockRemove(txn, lock_mode, oid, rid);
 
   return true;
@@ -743,6 +1134,127 @@ auto LockManager::UnlockRow(Transaction *txn, const table_oid_t &oid, const RID
   // return false;
 }
 
+auto LockManager::LockKey(Transaction *txn, LockMode lock_mode, index_oid_t index_oid, int64_t key) -> bool {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  txn_id_t id = txn->GetTransactionId();
+
+  // 键锁只有S和X两种，而且和行锁一样持有到事务结束，收缩阶段不能再申请。
+  if (lock_mode != LockMode::SHARED && lock_mode != LockMode::EXCLUSIVE) {
+    txn->SetState(TransactionState::ABORTED);
+    ThrowException(id, AbortReason::ATTEMPTED_INTENTION_LOCK_ON_ROW, __LINE__);
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    txn->SetState(TransactionState::ABORTED);
+    ThrowException(id, AbortReason::LOCK_ON_SHRINKING, __LINE__);
+    return false;
+  }
+  if (txn->IsKeyExclusiveLocked(index_oid, key) ||
+      (lock_mode == LockMode::SHARED && txn->IsKeySharedLocked(index_oid, key))) {
+    return true;
+  }
+
+  key_lock_map_latch_.lock();
+  auto *que = &key_lock_map_[{index_oid, key}];
+  std::unique_lock<std::mutex> lock(que->latch_);
+  key_lock_map_latch_.unlock();
+
+  // 已经有S锁，这次是升级成X：和行锁一样，先放掉S锁再当成普通请求排队。
+  bool upgrade = txn->IsKeySharedLocked(index_oid, key);
+  if (upgrade) {
+    if (que->upgrading_ != INVALID_TXN_ID && que->upgrading_ != id) {
+      txn->SetState(TransactionState::ABORTED);
+      ThrowException(id, AbortReason::UPGRADE_CONFLICT, __LINE__);
+      return false;
+    }
+    auto iter = std::find_if(que->request_queue_.begin(), que->request_queue_.end(),
+                             [id](LockRequest *lr) { return lr->txn_id_ == id; });
+    KeyLockRemove(txn, LockMode::SHARED, index_oid, key);
+    que->FreeRequest(iter);
+    que->upgrading_ = id;
+  }
+
+  // 键锁请求的oid_是索引的oid，rid_不用。
+  LockRequest *lr = que->NewRequest(id, lock_mode, index_oid);
+  bool uncontended = que->request_queue_.Empty();
+  que->request_queue_.PushBack(lr);
+
+  bool waited = false;
+  while (!uncontended && !GrantLock(que, lock_mode, lr, id)) {
+    auto decision = PrepareToWait(que, &lock, txn, lr);
+    if (decision == WaitDecision::DIE) {
+      txn->SetState(TransactionState::ABORTED);
+      profiler_.RecordDeadlockVictim();
+    } else if (decision == WaitDecision::WAIT && txn->GetState() != TransactionState::ABORTED) {
+      // 记下谁在等、被谁挡着。只有真的要等才走到这里，不碰没有冲突的路径。
+      profiler_.BeginWait({id, index_oid, std::nullopt, key, CheckLockMode(lock_mode), CollectBlockers(que, lr),
+                           LockProfiler::Clock::now()});
+      waited = true;
+      que->waiters_++;
+      que->cv_.wait(lock);
+      que->waiters_--;
+    }
+    if (txn->GetState() == TransactionState::ABORTED) {
+      for (auto it = que->request_queue_.begin(); it != que->request_queue_.end();) {
+        it = (*it)->txn_id_ == id ? que->FreeRequest(it) : std::next(it);
+      }
+      if (que->upgrading_ == id) {
+        que->upgrading_ = INVALID_TXN_ID;
+      }
+      que->NotifyWaiters();
+      StopWaiting(id);
+      if (waited) {
+        profiler_.EndWait(id);
+      }
+      return false;
+    }
+  }
+  if (!uncontended) {
+    StopWaiting(id);
+  }
+  if (waited) {
+    profiler_.EndWait(id);
+  }
+
+  lr->granted_ = true;
+  if (upgrade) {
+    que->upgrading_ = INVALID_TXN_ID;
+  }
+  KeyLockAllocate(txn, lock_mode, index_oid, key);
+  return true;
+}
+
+auto LockManager::UnlockKey(Transaction *txn, index_oid_t index_oid, int64_t key) -> bool {
+  key_lock_map_latch_.lock();
+  auto que_iter = key_lock_map_.find({index_oid, key});
+  if (que_iter == key_lock_map_.end()) {
+    txn->SetState(TransactionState::ABORTED);
+    key_lock_map_latch_.unlock();
+    ThrowException(txn->GetTransactionId(), AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD, __LINE__);
+    return false;
+  }
+  auto *que = &que_iter->second;
+  std::unique_lock<std::mutex> lock(que->latch_);
+  key_lock_map_latch_.unlock();
+  txn_id_t id = txn->GetTransactionId();
+
+  auto iter = std::find_if(que->request_queue_.begin(), que->request_queue_.end(),
+                           [id](LockRequest *lr) { return lr->granted_ && lr->txn_id_ == id; });
+  if (iter == que->request_queue_.end()) {
+    txn->SetState(TransactionState::ABORTED);
+    ThrowException(id, AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD, __LINE__);
+    return false;
+  }
+
+  // 键锁要么持有到事务结束，要么是插入时的瞬时锁，放掉它都不改变事务状态。
+  KeyLockRemove(txn, (*iter)->lock_mode_, index_oid, key);
+  que->FreeRequest(iter);
+  que->NotifyWaiters();
+  return true;
+}
+
 void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
   // printf("addedge %d -> %d \n", t1, t2);
   waits_for_[t1].emplace(t2);
@@ -758,28 +1270,31 @@ void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
 }
 
 void LockManager::CreateGraph() {
-  row_lock_map_latch_.lock();
-  table_lock_map_latch_.lock();
   // printf("row lock : \n");
 
-  for (const auto &[t, que] : row_lock_map_) {
-    std::unique_lock<std::mutex> lock(que->latch_);
-    // printf("row : %s \n", t.ToString().c_str());
-    for (auto &i : que->request_queue_) {
-      // printf("%d/%d ", (i)->txn_id_, (i)->granted_);
-      for (auto &j : que->request_queue_) {
-        if (!i->granted_ && j->granted_) {
-          AddEdge((i)->txn_id_, j->txn_id_);
+  // 一次只锁一个分片，检测死锁时不会把所有行锁请求都挡住。
+  for (auto &shard : row_lock_shards_) {
+    std::scoped_lock<std::mutex> shard_lock(shard.latch_);
+    for (auto &[t, que] : shard.lock_map_) {
+      std::unique_lock<std::mutex> lock(que.latch_);
+      // printf("row : %s \n", t.ToString().c_str());
+      for (auto *i : que.request_queue_) {
+        // printf("%d/%d ", (i)->txn_id_, (i)->granted_);
+        for (auto *j : que.request_queue_) {
+          if (!i->granted_ && j->granted_) {
+            AddEdge((i)->txn_id_, j->txn_id_);
+          }
         }
       }
+      // printf("\n");
     }
-    // printf("\n");
   }
   // printf("--------------------------------\n");
+  table_lock_map_latch_.lock();
   for (const auto &[t, que] : table_lock_map_) {
     std::unique_lock<std::mutex> lock(que->latch_);
-    for (auto &i : que->request_queue_) {
-      for (auto &j : que->request_queue_) {
+    for (auto *i : que->request_queue_) {
+      for (auto *j : que->request_queue_) {
         if (!i->granted_ && j->granted_) {
           AddEdge(i->txn_id_, j->txn_id_);
         }
@@ -788,7 +1303,18 @@ void LockManager::CreateGraph() {
   }
 
   table_lock_map_latch_.unlock();
-  row_lock_map_latch_.unlock();
+
+  std::scoped_lock<std::mutex> key_map_lock(key_lock_map_latch_);
+  for (auto &[k, que] : key_lock_map_) {
+    std::unique_lock<std::mutex> lock(que.latch_);
+    for (auto *i : que.request_queue_) {
+      for (auto *j : que.request_queue_) {
+        if (!i->granted_ && j->granted_) {
+          AddEdge(i->txn_id_, j->txn_id_);
+        }
+      }
+    }
+  }
 }
 
 void LockManager::ShowGraph() {
@@ -806,50 +1332,51 @@ void LockManager::Abort(Transaction *txn) {}
 void LockManager::ReleaseLocks(Transaction *txn) {}
 
 void LockManager::RemovePoint(Transaction *txn, txn_id_t tid) {
-  std::scoped_lock<std::mutex> lock1(row_lock_map_latch_);
-  std::scoped_lock<std::mutex> lock2(table_lock_map_latch_);
-
-  for (const auto &[t, que] : row_lock_map_) {
-    std::unique_lock<std::mutex> lock(que->latch_);
-    bool flag = false;
-
-    for (auto i = que->request_queue_.begin(); i != que->request_queue_.end(); ++i) {
-      if ((*i)->txn_id_ == tid) {
-        flag = true;
-      }
+  for (auto &shard : row_lock_shards_) {
+    std::scoped_lock<std::mutex> shard_lock(shard.latch_);
+    for (auto &[t, que] : shard.lock_map_) {
+      std::unique_lock<std::mutex> lock(que.latch_);
+      bool flag = false;
+
+      for (auto i = que.request_queue_.begin(); i != que.request_queue_.end(); ++i) {
+        if ((*i)->txn_id_ == tid) {
+          flag = true;
+        }
 
-      for (auto &j : que->request_queue_) {
-        if (j->granted_ && !(*i)->granted_ && (j->txn_id_ == tid || (*i)->txn_id_ == tid)) {
-          RemoveEdge((*i)->txn_id_, j->txn_id_);
+        for (auto *j : que.request_queue_) {
+          if (j->granted_ && !(*i)->granted_ && (j->txn_id_ == tid || (*i)->txn_id_ == tid)) {
+            RemoveEdge((*i)->txn_id_, j->txn_id_);
+          }
         }
       }
-    }
 
-    if (flag) {
-      que->cv_.notify_all();
+      if (flag) {
+        que.NotifyWaiters();
+      }
+      // std::list<std::list<std::shared_ptr<LockRequest>>::iterator> li;
+
+      // for (auto i = que->request_queue_.begin(); i != que->request_queue_.end(); ++i) {
+      //   if ((*i)->txn_id_ == tid) {
+      //     li.emplace_back(i);
+      //   }
+
+      //   for (auto &j : que->request_queue_) {
+      //     if (j->granted_ && !(*i)->granted_ && (j->txn_id_ == tid || (*i)->txn_id_ == tid)) {
+      //       RemoveEdge((*i)->txn_id_, j->txn_id_);
+      //     }
+      //   }
+      // }
+      // if (que->upgrading_ == tid) {
+      //   que->upgrading_ = INVALID_TXN_ID;
+      // }
+
+      // if (!li.empty()) {
+      //   que->cv_.notify_all();
+      // }
     }
-    // std::list<std::list<std::shared_ptr<LockRequest>>::iterator> li;
-
-    // for (auto i = que->request_queue_.begin(); i != que->request_queue_.end(); ++i) {
-    //   if ((*i)->txn_id_ == tid) {
-    //     li.emplace_back(i);
-    //   }
-
-    //   for (auto &j : que->request_queue_) {
-    //     if (j->granted_ && !(*i)->granted_ && (j->txn_id_ == tid || (*i)->txn_id_ == tid)) {
-    //       RemoveEdge((*i)->txn_id_, j->txn_id_);
-    //     }
-    //   }
-    // }
-    // if (que->upgrading_ == tid) {
-    //   que->upgrading_ = INVALID_TXN_ID;
-    // }
-
-    // if (!li.empty()) {
-    //   que->cv_.notify_all();
-    // }
   }
 
+  std::scoped_lock<std::mutex> lock2(table_lock_map_latch_);
   for (const auto &[t, que] : table_lock_map_) {
     std::unique_lock<std::mutex> lock(que->latch_);
 
@@ -860,7 +1387,7 @@ void LockManager::RemovePoint(Transaction *txn, txn_id_t tid) {
         flag = true;
       }
 
-      for (auto &j : que->request_queue_) {
+      for (auto *j : que->request_queue_) {
         if (j->granted_ && !(*i)->granted_ && (j->txn_id_ == tid || (*i)->txn_id_ == tid)) {
           RemoveEdge((*i)->txn_id_, j->txn_id_);
         }
@@ -868,7 +1395,7 @@ void LockManager::RemovePoint(Transaction *txn, txn_id_t tid) {
     }
 
     if (flag) {
-      que->cv_.notify_all();
+      que->NotifyWaiters();
     }
 
     // std::list<std::list<std::shared_ptr<LockRequest>>::iterator> li;
@@ -904,6 +1431,23 @@ void LockManager::RemovePoint(Transaction *txn, txn_id_t tid) {
     //   que->cv_.notify_all();
     // }
   }
+
+  std::scoped_lock<std::mutex> key_map_lock(key_lock_map_latch_);
+  for (auto &[k, que] : key_lock_map_) {
+    std::unique_lock<std::mutex> lock(que.latch_);
+    bool flag = false;
+    for (auto *i : que.request_queue_) {
+      flag = flag || i->txn_id_ == tid;
+      for (auto *j : que.request_queue_) {
+        if (j->granted_ && !i->granted_ && (j->txn_id_ == tid || i->txn_id_ == tid)) {
+          RemoveEdge(i->txn_id_, j->txn_id_);
+        }
+      }
+    }
+    if (flag) {
+      que.NotifyWaiters();
+    }
+  }
 }
 
 auto LockManager::HasCycle(txn_id_t *txn_id) -> bool {
@@ -936,9 +1480,12 @@ auto LockManager::HasCycle(txn_id_t *txn_id) -> bool {
   }
 
   if (flag) {
+    // 批量发号之后id大不代表年轻，和增量检测一样按开始时间戳挑最年轻的；都已结束（或没注册）时退回到id大的。
     txn_id_t id = -1;
     for (txn_id_t i : txn_set) {
-      id = id > i ? id : i;
+      if (id == -1 || StartTs(i) > StartTs(id) || (StartTs(i) == StartTs(id) && i > id)) {
+        id = i;
+      }
     }
     *txn_id = id;
     return true;
@@ -970,7 +1517,10 @@ void LockManager::RunCycleDetection() {
       // ShowGraph();
       while (HasCycle(&tid)) {
         auto txn = TransactionManager::GetTransaction(tid);
-        txn->SetState(TransactionState::ABORTED);
+        if (txn != nullptr) {
+          txn->SetState(TransactionState::ABORTED);
+          profiler_.RecordDeadlockVictim();
+        }
         RemovePoint(txn, tid);  // 在图中删除这个节点，并唤醒。
         // ShowGraph();
       }
@@ -0,0 +1,265 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_profiler.cpp
+//
+// Identification: src/concurrency/lock_profiler.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/lock_profiler.h"
+
+#include <algorithm>
+
+#include "fmt/format.h"
+
+namespace bustub {
+
+namespace {
+
+/** Row lock grants this thread made since its last sampled one */
+thread_local uint32_t row_grants_since_sample = 0;
+
+}  // namespace
+
+void LockProfiler::RecordTableLock(table_oid_t oid, bool upgrade) {
+  auto &slot = TableSlot(oid);
+  slot.acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  if (upgrade) {
+    slot.upgrades_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void LockProfiler::RecordRowLock(table_oid_t oid, const RID &rid, bool upgrade) {
+  // 行锁在所在的表上单独计数，这个数是准的；具体到哪一行只抽样，免得每次都去抢rows_latch_。
+  auto &slot = TableSlot(oid);
+  slot.row_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  if (upgrade) {
+    slot.row_upgrades_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (++row_grants_since_sample < ROW_SAMPLE_INTERVAL) {
+    return;
+  }
+  row_grants_since_sample = 0;
+  std::scoped_lock lock(rows_latch_);
+  auto key = std::make_pair(oid, rid.Get());
+  auto it = rows_.find(key);
+  if (it == rows_.end()) {
+    if (rows_.size() >= PROFILED_ROWS) {
+      return;
+    }
+    it = rows_.emplace(key, RowCounters{}).first;
+  }
+  it->second.sampled_acquisitions_ += ROW_SAMPLE_INTERVAL;
+}
+
+void LockProfiler::BeginWait(Waiter waiter) {
+  std::scoped_lock lock(waiters_latch_);
+  auto [it, inserted] = waiters_.try_emplace(waiter.txn_id_, waiter);
+  if (!inserted) {
+    // 每次被叫醒后挡路的人可能换了，开始等的时间不变。
+    it->second.blockers_ = std::move(waiter.blockers_);
+  }
+}
+
+void LockProfiler::EndWait(txn_id_t txn_id) {
+  Waiter waiter;
+  {
+    std::scoped_lock lock(waiters_latch_);
+    auto it = waiters_.find(txn_id);
+    if (it == waiters_.end()) {
+      return;
+    }
+    waiter = std::move(it->second);
+    waiters_.erase(it);
+  }
+  auto wait_us = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - waiter.since_).count());
+  if (waiter.key_.has_value()) {
+    return;
+  }
+
+  auto &slot = TableSlot(waiter.oid_);
+  slot.waits_.fetch_add(1, std::memory_order_relaxed);
+  slot.wait_us_.fetch_add(wait_us, std::memory_order_relaxed);
+  slot.wait_histogram_[Bucket(wait_us)].fetch_add(1, std::memory_order_relaxed);
+
+  if (waiter.rid_.has_value()) {
+    std::scoped_lock lock(rows_latch_);
+    auto key = std::make_pair(waiter.oid_, waiter.rid_->Get());
+    auto it = rows_.find(key);
+    if (it == rows_.end()) {
+      if (rows_.size() >= PROFILED_ROWS) {
+        return;
+      }
+      it = rows_.emplace(key, RowCounters{}).first;
+    }
+    it->second.waits_++;
+    it->second.wait_us_ += wait_us;
+  }
+}
+
+void LockProfiler::RecordAbort(AbortReason reason) {
+  aborts_[static_cast<size_t>(reason)].fetch_add(1, std::memory_order_relaxed);
+}
+
+auto LockProfiler::GetTableCounters() const -> std::map<table_oid_t, TableCounters> {
+  std::map<table_oid_t, TableCounters> result;
+  for (size_t oid = 0; oid < tables_.size(); oid++) {
+    const auto &slot = tables_[oid];
+    TableCounters counters;
+    counters.acquisitions_ = slot.acquisitions_.load(std::memory_order_relaxed);
+    counters.upgrades_ = slot.upgrades_.load(std::memory_order_relaxed);
+    counters.row_acquisitions_ = slot.row_acquisitions_.load(std::memory_order_relaxed);
+    counters.row_upgrades_ = slot.row_upgrades_.load(std::memory_order_relaxed);
+    counters.waits_ = slot.waits_.load(std::memory_order_relaxed);
+    counters.wait_us_ = slot.wait_us_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < WAIT_HISTOGRAM_BUCKETS; i++) {
+      counters.wait_histogram_[i] = slot.wait_histogram_[i].load(std::memory_order_relaxed);
+    }
+    if (counters.acquisitions_ > 0 || counters.row_acquisitions_ > 0 || counters.waits_ > 0) {
+      result.emplace(oid, counters);
+    }
+  }
+  return result;
+}
+
+auto LockProfiler::GetRowCounters(size_t limit) -> std::vector<std::pair<std::pair<table_oid_t, RID>, RowCounters>> {
+  std::vector<std::pair<std::pair<table_oid_t, RID>, RowCounters>> result;
+  {
+    std::scoped_lock lock(rows_latch_);
+    for (const auto &[key, counters] : rows_) {
+      RID rid(static_cast<page_id_t>(key.second >> 32), static_cast<uint32_t>(key.second));
+      result.emplace_back(std::make_pair(key.first, rid), counters);
+    }
+  }
+  std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) {
+    if (a.second.waits_ != b.second.waits_) {
+      return a.second.waits_ > b.second.waits_;
+    }
+    return a.second.sampled_acquisitions_ > b.second.sampled_acquisitions_;
+  });
+  if (result.size() > limit) {
+    result.resize(limit);
+  }
+  return result;
+}
+
+auto LockProfiler::GetWaiters() -> std::vector<Waiter> {
+  std::vector<Waiter> result;
+  {
+    std::scoped_lock lock(waiters_latch_);
+    for (const auto &[txn_id, waiter] : waiters_) {
+      result.push_back(waiter);
+    }
+  }
+  std::sort(result.begin(), result.end(), [](const Waiter &a, const Waiter &b) { return a.since_ < b.since_; });
+  return result;
+}
+
+auto LockProfiler::ToJson() -> std::string {
+  std::vector<std::string> tables;
+  for (const auto &[oid, counters] : GetTableCounters()) {
+    std::vector<std::string> buckets;
+    for (size_t i = 0; i < WAIT_HISTOGRAM_BUCKETS; i++) {
+      if (counters.wait_histogram_[i] == 0) {
+        continue;
+      }
+      auto bound = i + 1 < WAIT_HISTOGRAM_BUCKETS ? fmt::format("{}", 1ULL << i) : std::string("\"inf\"");
+      buckets.push_back(fmt::format(R"({{"lt_us":{},"count":{}}})", bound, counters.wait_histogram_[i]));
+    }
+    auto name = oid < PROFILED_TABLES ? fmt::format("{}", oid) : std::string("\"other\"");
+    tables.push_back(fmt::format(
+        R"({{"oid":{},"acquisitions":{},"upgrades":{},"row_acquisitions":{},"row_upgrades":{},"waits":{},"wait_us":{},)"
+        R"("wait_histogram":[{}]}})",
+        name, counters.acquisitions_, counters.upgrades_, counters.row_acquisitions_, counters.row_upgrades_,
+        counters.waits_, counters.wait_us_, fmt::join(buckets, ",")));
+  }
+
+  std::vector<std::string> rows;
+  for (const auto &[row, counters] : GetRowCounters(PROFILED_ROWS)) {
+    rows.push_back(
+        fmt::format(R"({{"oid":{},"page_id":{},"slot":{},"sampled_acquisitions":{},"waits":{},"wait_us":{}}})",
+                    row.first, row.second.GetPageId(), row.second.GetSlotNum(), counters.sampled_acquisitions_,
+                    counters.waits_, counters.wait_us_));
+  }
+
+  std::vector<std::string> aborts;
+  for (size_t i = 0; i < ABORT_REASONS; i++) {
+    aborts.push_back(fmt::format(R"("{}":{})", AbortReasonName(static_cast<AbortReason>(i)),
+                                 aborts_[i].load(std::memory_order_relaxed)));
+  }
+
+  std::vector<std::string> waiters;
+  auto now = Clock::now();
+  for (const auto &waiter : GetWaiters()) {
+    auto resource = fmt::format(R"("oid":{})", waiter.oid_);
+    if (waiter.rid_.has_value()) {
+      resource += fmt::format(R"(,"page_id":{},"slot":{})", waiter.rid_->GetPageId(), waiter.rid_->GetSlotNum());
+    } else if (waiter.key_.has_value()) {
+      resource = fmt::format(R"("index_oid":{},"key":{})", waiter.oid_, *waiter.key_);
+    }
+    auto waited_us = std::chrono::duration_cast<std::chrono::microseconds>(now - waiter.since_).count();
+    waiters.push_back(fmt::format(R"({{"txn":{},{},"mode":"{}","waited_us":{},"blocked_by":[{}]}})", waiter.txn_id_,
+                                  resource, waiter.mode_, waited_us, fmt::join(waiter.blockers_, ",")));
+  }
+
+  return fmt::format(R"({{"tables":[{}],"rows":[{}],"aborts":{{{}}},"deadlock_victims":{},"waiting":[{}]}})",
+                     fmt::join(tables, ","), fmt::join(rows, ","), fmt::join(aborts, ","), GetDeadlockVictims(),
+                     fmt::join(waiters, ","));
+}
+
+void LockProfiler::Reset() {
+  for (auto &slot : tables_) {
+    slot.acquisitions_ = 0;
+    slot.upgrades_ = 0;
+    slot.row_acquisitions_ = 0;
+    slot.row_upgrades_ = 0;
+    slot.waits_ = 0;
+    slot.wait_us_ = 0;
+    for (auto &bucket : slot.wait_histogram_) {
+      bucket = 0;
+    }
+  }
+  for (auto &count : aborts_) {
+    count = 0;
+  }
+  deadlock_victims_ = 0;
+  std::scoped_lock lock(rows_latch_);
+  rows_.clear();
+}
+
+auto LockProfiler::AbortReasonName(AbortReason reason) -> const char * {
+  switch (reason) {
+    case AbortReason::LOCK_ON_SHRINKING:
+      return "LOCK_ON_SHRINKING";
+    case AbortReason::UPGRADE_CONFLICT:
+      return "UPGRADE_CONFLICT";
+    case AbortReason::LOCK_SHARED_ON_READ_UNCOMMITTED:
+      return "LOCK_SHARED_ON_READ_UNCOMMITTED";
+    case AbortReason::TABLE_LOCK_NOT_PRESENT:
+      return "TABLE_LOCK_NOT_PRESENT";
+    case AbortReason::ATTEMPTED_INTENTION_LOCK_ON_ROW:
+      return "ATTEMPTED_INTENTION_LOCK_ON_ROW";
+    case AbortReason::TABLE_UNLOCKED_BEFORE_UNLOCKING_ROWS:
+      return "TABLE_UNLOCKED_BEFORE_UNLOCKING_ROWS";
+    case AbortReason::INCOMPATIBLE_UPGRADE:
+      return "INCOMPATIBLE_UPGRADE";
+    case AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD:
+      return "ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD";
+  }
+  return "";
+}
+
+auto LockProfiler::Bucket(uint64_t wait_us) -> size_t {
+  size_t bucket = 0;
+  while (bucket + 1 < WAIT_HISTOGRAM_BUCKETS && wait_us >= (1ULL << bucket)) {
+    bucket++;
+  }
+  return bucket;
+}
+
+}  // namespace bustub
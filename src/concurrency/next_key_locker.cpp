@@ -0,0 +1,70 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// next_key_locker.cpp
+//
+// Identification: src/concurrency/next_key_locker.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/next_key_locker.h"
+
+namespace bustub {
+
+auto NextKeyLocker::TreeOf(IndexInfo *index_info) -> BPlusTreeIndexForOneIntegerColumn * {
+  const auto &key_schema = index_info->key_schema_;
+  if (key_schema.GetColumnCount() != 1 || key_schema.GetColumn(0).GetType() != TypeId::INTEGER) {
+    return nullptr;
+  }
+  return dynamic_cast<BPlusTreeIndexForOneIntegerColumn *>(index_info->index_.get());
+}
+
+auto NextKeyLocker::LowerBound(BPlusTreeIndexForOneIntegerColumn *tree, const IntegerKeyType &key,
+                               IndexInfo *index_info) -> int64_t {
+  auto iter = tree->GetBeginIterator(key);
+  return iter.IsEnd() ? LockManager::KEY_RANGE_END : KeyOf((*iter).first, index_info);
+}
+
+auto NextKeyLocker::LockInsert(IndexInfo *index_info, const Tuple &key) -> bool {
+  auto *tree = TreeOf(index_info);
+  if (tree == nullptr) {
+    return true;
+  }
+  IntegerKeyType index_key;
+  index_key.SetFromKey(key);
+  auto oid = index_info->index_oid_;
+
+  // 新键还没插进去，第一个不小于它的键就是它的后继，锁住后继就等于锁住了新键要落进去的间隙。
+  while (true) {
+    int64_t next = LowerBound(tree, index_key, index_info);
+    bool held = txn_->IsKeySharedLocked(oid, next) || txn_->IsKeyExclusiveLocked(oid, next);
+    if (!lock_mgr_->LockKey(txn_, LockManager::LockMode::EXCLUSIVE, oid, next)) {
+      return false;
+    }
+    // 等锁的时候可能有人往间隙里插了键，后继变了就重来。
+    bool moved = LowerBound(tree, index_key, index_info) != next;
+    // 只是确认没有扫描挡着，锁马上放掉，不挡同一个间隙里别的插入；本来就持有的锁留着。
+    if (!held) {
+      lock_mgr_->UnlockKey(txn_, oid, next);
+    }
+    if (!moved) {
+      break;
+    }
+  }
+  return lock_mgr_->LockKey(txn_, LockManager::LockMode::EXCLUSIVE, oid, KeyOf(index_key, index_info));
+}
+
+auto NextKeyLocker::LockDelete(IndexInfo *index_info, const Tuple &key) -> bool {
+  if (TreeOf(index_info) == nullptr) {
+    return true;
+  }
+  IntegerKeyType index_key;
+  index_key.SetFromKey(key);
+  return lock_mgr_->LockKey(txn_, LockManager::LockMode::EXCLUSIVE, index_info->index_oid_,
+                            KeyOf(index_key, index_info));
+}
+
+}  // namespace bustub
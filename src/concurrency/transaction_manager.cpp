@@ -12,77 +12,389 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
 #include <mutex>  // NOLINT
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "catalog/catalog.h"
 #include "storage/table/table_heap.h"
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
-std::shared_mutex TransactionManager::txn_map_mutex = {};
+TransactionRegistry TransactionManager::txn_registry;
+std::atomic<uint64_t> TransactionManager::next_generation = 1;
 
-auto TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) -> Transaction * {
-  // Acquire the global transaction latch in shared mode.
-  global_txn_latch_.RLock();
+namespace {
 
+/** Transaction ids a thread took from a transaction manager and has not handed out yet */
+struct TxnIdBatch {
+  uint64_t generation_{0};
+  txn_id_t next_{0};
+  txn_id_t end_{0};
+};
+
+thread_local TxnIdBatch txn_id_batch;
+
+}  // namespace
+
+auto TransactionManager::NextTxnId() -> txn_id_t {
+  // 每个线程一次拿一批id，大部分Begin不用碰共享的计数器。id因此不按开始的先后排，先后看start ts。
+  auto &batch = txn_id_batch;
+  if (batch.generation_ != generation_ || batch.next_ == batch.end_) {
+    batch.generation_ = generation_;
+    batch.next_ = next_txn_id_.fetch_add(TXN_ID_BATCH_SIZE);
+    batch.end_ = batch.next_ + TXN_ID_BATCH_SIZE;
+    // 整批算作已经发出，线程没用完就丢掉的id也不会让注册表的段一直回收不了。
+    txn_registry.Issue(batch.next_, TXN_ID_BATCH_SIZE);
+  }
+  return batch.next_++;
+}
+
+void TransactionManager::EnterGate(txn_id_t txn_id) {
+  auto &running = gate_stripes_[txn_id % GATE_STRIPES].running_;
+  while (true) {
+    running++;
+    // 先计数再看有没有检查点，检查点那边先设标记再看计数，两边总有一边看得到另一边。
+    if (!gate_blocked_.load()) {
+      return;
+    }
+    LeaveGate(txn_id);
+    std::unique_lock lock(gate_latch_);
+    gate_cv_.wait(lock, [this] { return !gate_blocked_.load(); });
+  }
+}
+
+void TransactionManager::LeaveGate(txn_id_t txn_id) {
+  gate_stripes_[txn_id % GATE_STRIPES].running_--;
+  if (gate_blocked_.load()) {
+    std::scoped_lock lock(gate_latch_);
+    gate_cv_.notify_all();
+  }
+}
+
+auto TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level, ConcurrencyControl concurrency_control,
+                               AccessMode access_mode) -> Transaction * {
   if (txn == nullptr) {
-    txn = new Transaction(next_txn_id_++, isolation_level);
+    txn = new Transaction(NextTxnId(), isolation_level, concurrency_control, access_mode);
   }
+  txn->SetStartTs(next_start_ts_.fetch_add(1));
+  // Wait out a checkpoint, then count the transaction as running.
+  EnterGate(txn->GetTransactionId());
 
-  if (enable_logging) {
+  if (txn->IsOptimistic()) {
+    std::scoped_lock lock(words_latch_);
+    optimistic_txns_++;
+  }
+
+  if (txn->ReadsSnapshot()) {
+    std::scoped_lock lock(commit_latch_);
+    txn->SetReadTs(last_commit_ts_);
+    active_snapshots_.insert(last_commit_ts_);
+  }
+
+  // 只读事务什么都不写，也就不用记日志。
+  if (enable_logging && !txn->IsReadOnly()) {
     LogRecord record = LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
     lsn_t lsn = log_manager_->AppendLogRecord(&record);
     txn->SetPrevLSN(lsn);
   }
 
-  std::unique_lock<std::shared_mutex> l(txn_map_mutex);
-  txn_map[txn->GetTransactionId()] = txn;
+  txn_registry.Insert(txn);
   return txn;
 }
 
-void TransactionManager::Commit(Transaction *txn) {
+auto TransactionManager::Commit(Transaction *txn) -> bool {
+  if (txn->IsReadOnly()) {
+    // 只读事务没写过东西，不用验证、不用打戳、也没有要真正删掉的tuple。
+    txn->SetState(TransactionState::COMMITTED);
+    if (txn->ReadsSnapshot()) {
+      std::scoped_lock lock(commit_latch_);
+      active_snapshots_.erase(active_snapshots_.find(txn->GetReadTs()));
+    }
+    ReleaseLocks(txn);
+    Finish(txn);
+    return true;
+  }
+
+  std::vector<std::pair<TableHeap *, RID>> locked_words;
+  if (txn->IsOptimistic() && !ValidateAndInstall(txn, &locked_words)) {
+    // 先放版本字再回滚：最后一个乐观事务结束时版本字会被清掉。装了一半的写还挂着这个写者，别人照样验证不过。
+    UnlockWords(locked_words);
+    Abort(txn);
+    return false;
+  }
   txn->SetState(TransactionState::COMMITTED);
 
-  // Perform all deletes before we commit.
+  // 提交记录落盘之后才算提交完成：之后才给版本打戳、让别人看到提交，真正删掉tuple，放锁。
+  // 落盘交给刷日志线程成组去做。异步提交不等，刷日志线程保证在async_commit_delay之内写下去。
+  if (enable_logging) {
+    LogRecord record = LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    lsn_t lsn = log_manager_->AppendLogRecord(&record);
+    txn->SetPrevLSN(lsn);
+    if (txn->GetCommitMode() == CommitMode::ASYNCHRONOUS) {
+      log_manager_->ScheduleFlush(lsn);
+    } else {
+      log_manager_->WaitForFlush(lsn);
+    }
+  }
+
   auto write_set = txn->GetWriteSet();
+  RememberWordTables(*write_set);
+  bool keep_versions;
+  timestamp_t oldest;
+  {
+    // 拿提交时间戳和给版本打戳要一起做完，之后开始的快照才能看到完整的提交。
+    std::scoped_lock lock(commit_latch_);
+    if (txn->ReadsSnapshot()) {
+      active_snapshots_.erase(active_snapshots_.find(txn->GetReadTs()));
+    }
+    // 没有快照在读的话，旧版本谁也用不到，链直接扔掉；删除的链要留到页上真正删掉为止。
+    keep_versions = !active_snapshots_.empty();
+    if (!write_set->empty()) {
+      auto commit_ts = last_commit_ts_ + 1;
+      for (const auto &item : *write_set) {
+        auto *versions = item.table_->GetVersionStore();
+        for (uint32_t i = 0; i < item.count_; i++) {
+          RID rid(item.rid_.GetPageId(), item.rid_.GetSlotNum() + i);
+          // 先动版本字再去掉未提交的写者，乐观事务验证时两样总能看到一样。
+          item.table_->GetVersionWords()->Bump(rid);
+          if (keep_versions || item.wtype_ == WType::DELETE) {
+            versions->Commit(txn->GetTransactionId(), rid, commit_ts);
+          } else {
+            versions->Erase(rid);
+          }
+        }
+      }
+      last_commit_ts_ = commit_ts;
+    }
+    oldest = active_snapshots_.empty() ? last_commit_ts_ : *active_snapshots_.begin();
+  }
+
+  // Perform all deletes now that the commit is logged. A delete some snapshot still reads stays marked until garbage
+  // collection. They are logged without the transaction: recovery redoes them and never undoes a committed one.
+  std::unordered_set<TableHeap *> tables;
   while (!write_set->empty()) {
     auto &item = write_set->back();
     auto *table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
+    tables.insert(table);
+    if (item.wtype_ == WType::DELETE && !keep_versions) {
       // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
+      table->ApplyDelete(item.rid_, nullptr);
     }
     write_set->pop_back();
   }
   write_set->clear();
+  for (auto *table : tables) {
+    if (table->GetVersionStore()->NeedsCollect(oldest)) {
+      CollectVersions(table, oldest);
+    }
+  }
+
+  UnlockWords(locked_words);
+  txn->GetReadSet()->clear();
+  txn->GetBufferedWriteSet()->clear();
+  txn->GetIndexWriteSet()->clear();
 
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
+  Finish(txn);
+  return true;
+}
+
+auto TransactionManager::ValidateAndInstall(Transaction *txn, std::vector<std::pair<TableHeap *, RID>> *locked_words)
+    -> bool {
+  auto writes = txn->GetBufferedWriteSet();
+  auto by_tuple = [](const std::pair<TableHeap *, RID> &a, const std::pair<TableHeap *, RID> &b) {
+    return a.first != b.first ? a.first < b.first : a.second.Get() < b.second.Get();
+  };
+
+  // 第一步：和两阶段锁的写者一样拿上表锁和行锁，同时在跑的加锁事务就不会写同一行。
+  // 这里可能要等，所以先于版本字去拿：拿着版本字睡下去的话，别的验证者会一直空转。
+  try {
+    for (const auto &write : *writes) {
+      if (!lock_manager_->LockTable(txn, LockManager::LockMode::INTENTION_EXCLUSIVE, write.table_oid_)) {
+        return false;
+      }
+      if (write.wtype_ == WType::DELETE &&
+          !lock_manager_->LockRow(txn, LockManager::LockMode::EXCLUSIVE, write.table_oid_, write.rid_)) {
+        return false;
+      }
+    }
+  } catch (TransactionAbortException &) {
+    return false;
+  }
+
+  // 第二步：按固定顺序锁上要删的tuple的版本字，两个乐观事务不会互相等成环。
+  for (const auto &write : *writes) {
+    if (write.wtype_ == WType::DELETE) {
+      locked_words->emplace_back(write.catalog_->GetTable(write.table_oid_)->table_.get(), write.rid_);
+    }
+  }
+  std::sort(locked_words->begin(), locked_words->end(), by_tuple);
+  locked_words->erase(std::unique(locked_words->begin(), locked_words->end()), locked_words->end());
+  {
+    std::scoped_lock lock(words_latch_);
+    for (const auto &[table, rid] : *locked_words) {
+      word_tables_.insert(table);
+    }
+  }
+  for (const auto &[table, rid] : *locked_words) {
+    table->GetVersionWords()->Lock(rid);
+  }
+
+  // 第三步：读过的tuple版本没动过、没被别的乐观事务锁着、也没有没提交的写者，才能提交。
+  for (const auto &read : *txn->GetReadSet()) {
+    auto word = read.table_->GetVersionWords()->Get(read.rid_);
+    if ((word & ~VersionWords::LOCK_BIT) != read.version_) {
+      return false;
+    }
+    if ((word & VersionWords::LOCK_BIT) != 0 &&
+        !std::binary_search(locked_words->begin(), locked_words->end(), std::make_pair(read.table_, read.rid_),
+                            by_tuple)) {
+      return false;
+    }
+    auto writer = read.table_->GetVersionStore()->WriterOf(read.rid_);
+    if (writer != INVALID_TXN_ID && writer != txn->GetTransactionId()) {
+      return false;
+    }
+  }
+
+  // 第四步：把缓存的写装到表和索引上。从这里开始它们都进了写集合，失败了由Abort回滚，索引的改动也要记下来。
+  for (const auto &write : *writes) {
+    auto *table_info = write.catalog_->GetTable(write.table_oid_);
+    auto indexes = write.catalog_->GetTableIndexes(table_info->name_);
+    RID rid = write.rid_;
+    if (write.wtype_ == WType::DELETE) {
+      if (!table_info->table_->MarkDelete(rid, txn)) {
+        return false;
+      }
+    } else {
+      if (!table_info->table_->InsertTuple(write.tuple_, &rid, txn)) {
+        return false;
+      }
+      try {
+        if (!lock_manager_->LockRow(txn, LockManager::LockMode::EXCLUSIVE, write.table_oid_, rid)) {
+          return false;
+        }
+      } catch (TransactionAbortException &) {
+        return false;
+      }
+    }
+    for (auto *index_info : indexes) {
+      auto key =
+          write.tuple_.KeyFromTuple(table_info->schema_, index_info->key_schema_, index_info->index_->GetKeyAttrs());
+      if (write.wtype_ == WType::DELETE) {
+        index_info->index_->DeleteEntry(key, rid, txn);
+      } else {
+        index_info->index_->InsertEntry(key, rid, txn);
+      }
+      txn->GetIndexWriteSet()->emplace_back(rid, write.table_oid_, write.wtype_, write.tuple_, index_info->index_oid_,
+                                            write.catalog_);
+    }
+  }
+  return true;
+}
+
+void TransactionManager::CollectVersions(TableHeap *table, timestamp_t oldest) {
+  Transaction purge_txn(NextTxnId());
+  txn_registry.Insert(&purge_txn);
+  if (enable_logging) {
+    LogRecord record = LogRecord(purge_txn.GetTransactionId(), purge_txn.GetPrevLSN(), LogRecordType::BEGIN);
+    purge_txn.SetPrevLSN(log_manager_->AppendLogRecord(&record));
+  }
+  table->CollectVersions(oldest, &purge_txn);
+  // 删掉的都是早就提交了的删除，提交记录不用等落盘：没落盘的话恢复时撤掉它，tuple还是标记删除的样子。
+  if (enable_logging) {
+    LogRecord record = LogRecord(purge_txn.GetTransactionId(), purge_txn.GetPrevLSN(), LogRecordType::COMMIT);
+    purge_txn.SetPrevLSN(log_manager_->AppendLogRecord(&record));
+  }
+  txn_registry.Remove(&purge_txn);
+}
+
+void TransactionManager::Finish(Transaction *txn) {
+  if (txn->IsOptimistic() || !txn->IsReadOnly()) {
+    // 没有乐观事务在跑，谁手里也没有版本字了，全部清掉，之后从0重新数。别的写事务之后再动的版本字等它自己结束时清。
+    std::scoped_lock lock(words_latch_);
+    if (txn->IsOptimistic()) {
+      optimistic_txns_--;
+    }
+    if (optimistic_txns_ == 0) {
+      for (auto *table : word_tables_) {
+        table->GetVersionWords()->Clear();
+      }
+      word_tables_.clear();
+    }
+  }
+  txn_registry.Remove(txn);
+  // No longer running as far as checkpoints are concerned.
+  LeaveGate(txn->GetTransactionId());
+}
+
+void TransactionManager::RememberWordTables(const std::deque<TableWriteRecord> &write_set) {
+  std::unordered_set<TableHeap *> tables;
+  for (const auto &item : write_set) {
+    tables.insert(item.table_);
+  }
+  std::scoped_lock lock(words_latch_);
+  word_tables_.insert(tables.begin(), tables.end());
+}
+
+void TransactionManager::UnlockWords(const std::vector<std::pair<TableHeap *, RID>> &locked_words) {
+  for (const auto &[table, rid] : locked_words) {
+    table->GetVersionWords()->Unlock(rid);
+  }
 }
 
 void TransactionManager::Abort(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
+  if (txn->ReadsSnapshot()) {
+    std::scoped_lock lock(commit_latch_);
+    active_snapshots_.erase(active_snapshots_.find(txn->GetReadTs()));
+  }
+  if (txn->IsReadOnly()) {
+    ReleaseLocks(txn);
+    Finish(txn);
+    return;
+  }
+  txn->GetReadSet()->clear();
+  txn->GetBufferedWriteSet()->clear();
   // Rollback before releasing the lock.
   auto table_write_set = txn->GetWriteSet();
+  // 回滚前先动版本字，读过这些脏数据的乐观事务一定验证不过。
+  RememberWordTables(*table_write_set);
+  for (const auto &item : *table_write_set) {
+    for (uint32_t i = 0; i < item.count_; i++) {
+      item.table_->GetVersionWords()->Bump(RID(item.rid_.GetPageId(), item.rid_.GetSlotNum() + i));
+    }
+  }
+  // 页上全部恢复之后再丢掉版本链，恢复到一半时读快照的人还是从链上读旧版本。
+  std::vector<std::pair<TableHeap *, RID>> restored;
   while (!table_write_set->empty()) {
     auto &item = table_write_set->back();
     auto *table = item.table_;
+    if (item.wtype_ != WType::INSERT) {
+      restored.emplace_back(table, item.rid_);
+    }
     if (item.wtype_ == WType::DELETE) {
       table->RollbackDelete(item.rid_, txn);
     } else if (item.wtype_ == WType::INSERT) {
       // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
+      // A bulk append records a whole page range in one entry, undo it back to front like the rest of the set.
+      for (auto i = item.count_; i > 0; i--) {
+        table->ApplyDelete(RID(item.rid_.GetPageId(), item.rid_.GetSlotNum() + i - 1), txn);
+      }
     } else if (item.wtype_ == WType::UPDATE) {
       table->UpdateTuple(item.tuple_, item.rid_, txn);
     }
     table_write_set->pop_back();
   }
   table_write_set->clear();
+  for (const auto &[table, rid] : restored) {
+    table->GetVersionStore()->Rollback(txn->GetTransactionId(), rid);
+  }
   // Rollback index updates
   auto index_write_set = txn->GetIndexWriteSet();
   while (!index_write_set->empty()) {
@@ -109,14 +421,48 @@ void TransactionManager::Abort(Transaction *txn) {
   table_write_set->clear();
   index_write_set->clear();
 
+  // 回滚本身都记过日志了，中止记录不用等落盘。
+  if (enable_logging) {
+    LogRecord record = LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&record));
+  }
+
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
+  Finish(txn);
 }
 
-void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
+auto TransactionManager::GetOldestSnapshot() -> timestamp_t {
+  std::scoped_lock lock(commit_latch_);
+  return active_snapshots_.empty() ? last_commit_ts_ : *active_snapshots_.begin();
+}
 
-void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
+auto TransactionManager::GetActiveTransactions() -> std::vector<std::pair<txn_id_t, lsn_t>> {
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+  txn_registry.ForEach([&active_txns](Transaction *txn) {
+    auto last_lsn = txn->GetPrevLSN();
+    if (last_lsn != INVALID_LSN) {
+      active_txns.emplace_back(txn->GetTransactionId(), last_lsn);
+    }
+  });
+  return active_txns;
+}
+
+void TransactionManager::BlockAllTransactions() {
+  std::unique_lock lock(gate_latch_);
+  // 同一时间只有一个检查点。
+  gate_cv_.wait(lock, [this] { return !gate_blocked_.load(); });
+  gate_blocked_ = true;
+  gate_cv_.wait(lock, [this] {
+    return std::all_of(gate_stripes_.begin(), gate_stripes_.end(),
+                       [](const GateStripe &stripe) { return stripe.running_.load() == 0; });
+  });
+}
+
+void TransactionManager::ResumeTransactions() {
+  std::scoped_lock lock(gate_latch_);
+  gate_blocked_ = false;
+  gate_cv_.notify_all();
+}
 
 }  // namespace bustub
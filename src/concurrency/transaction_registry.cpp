@@ -0,0 +1,179 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.cpp
+//
+// Identification: src/concurrency/transaction_registry.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/transaction_registry.h"
+
+#include <algorithm>
+
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+TransactionRegistry::~TransactionRegistry() {
+  for (auto &segment : directory_) {
+    delete segment.load();
+  }
+  for (auto &[epoch, segment] : retired_) {
+    delete segment;
+  }
+}
+
+void TransactionRegistry::Insert(Transaction *txn) {
+  auto id = static_cast<size_t>(txn->GetTransactionId());
+  auto dir = id >> SEGMENT_BITS;
+  auto slot = id & (SEGMENT_SIZE - 1);
+  auto epoch = EnterEpoch();
+  while (true) {
+    auto *segment = directory_[dir].load();
+    if (segment == nullptr) {
+      // 这一段还没有人用过，谁先挂上去就用谁的。
+      auto *fresh = new Segment();
+      if (!directory_[dir].compare_exchange_strong(segment, fresh)) {
+        delete fresh;
+      }
+      continue;
+    }
+    if (!Acquire(segment)) {
+      // 这一段刚被回收，帮着把它从目录里摘掉，再换一段新的。
+      directory_[dir].compare_exchange_strong(segment, nullptr);
+      continue;
+    }
+    if (segment->slots_[slot].exchange(txn) != nullptr) {
+      // 覆盖了一个没注销的旧事务，它已经算过数了。
+      Release(dir, segment);
+    }
+    break;
+  }
+  ExitEpoch(epoch);
+}
+
+void TransactionRegistry::Remove(Transaction *txn) {
+  auto id = static_cast<size_t>(txn->GetTransactionId());
+  auto dir = id >> SEGMENT_BITS;
+  auto epoch = EnterEpoch();
+  auto *segment = directory_[dir].load();
+  Transaction *expected = txn;
+  if (segment != nullptr && segment->slots_[id & (SEGMENT_SIZE - 1)].compare_exchange_strong(expected, nullptr)) {
+    Release(dir, segment);
+  }
+  ExitEpoch(epoch);
+}
+
+void TransactionRegistry::Issue(txn_id_t first, size_t count) {
+  auto id = static_cast<size_t>(first);
+  auto end = id + count;
+  auto epoch = EnterEpoch();
+  while (id < end) {
+    auto dir = id >> SEGMENT_BITS;
+    auto dir_end = std::min(end, (dir + 1) << SEGMENT_BITS);
+    auto before = issued_[dir].fetch_add(dir_end - id);
+    // 最后一批id发出时段里可能已经没有事务了，之后也就没有Release来回收它。
+    if (before < SEGMENT_SIZE && before + (dir_end - id) >= SEGMENT_SIZE) {
+      auto *segment = directory_[dir].load();
+      if (segment != nullptr) {
+        TryRetire(dir, segment);
+      }
+    }
+    id = dir_end;
+  }
+  ExitEpoch(epoch);
+}
+
+auto TransactionRegistry::Find(txn_id_t txn_id) -> Transaction * {
+  if (txn_id < 0) {
+    return nullptr;
+  }
+  auto id = static_cast<size_t>(txn_id);
+  auto epoch = EnterEpoch();
+  auto *segment = directory_[id >> SEGMENT_BITS].load();
+  auto *txn = segment == nullptr ? nullptr : segment->slots_[id & (SEGMENT_SIZE - 1)].load();
+  ExitEpoch(epoch);
+  return txn;
+}
+
+void TransactionRegistry::ForEach(const std::function<void(Transaction *)> &fn) {
+  auto epoch = EnterEpoch();
+  for (auto &entry : directory_) {
+    auto *segment = entry.load();
+    // 段没挂上或者已经回收，里面没有在跑的事务。
+    if (segment == nullptr || segment->live_.load() <= 0) {
+      continue;
+    }
+    for (auto &slot : segment->slots_) {
+      auto *txn = slot.load();
+      if (txn != nullptr) {
+        fn(txn);
+      }
+    }
+  }
+  ExitEpoch(epoch);
+}
+
+auto TransactionRegistry::Acquire(Segment *segment) -> bool {
+  auto live = segment->live_.load();
+  do {
+    if (live == RETIRED) {
+      return false;
+    }
+  } while (!segment->live_.compare_exchange_weak(live, live + 1));
+  return true;
+}
+
+void TransactionRegistry::Release(size_t dir, Segment *segment) {
+  if (segment->live_.fetch_sub(1) != 1 || issued_[dir].load() < SEGMENT_SIZE) {
+    return;
+  }
+  // 段里的id都发出去过，事务也都结束了。
+  TryRetire(dir, segment);
+}
+
+void TransactionRegistry::TryRetire(size_t dir, Segment *segment) {
+  // 只有把计数从0改成RETIRED的那个线程负责回收。
+  int64_t empty = 0;
+  if (segment->live_.compare_exchange_strong(empty, RETIRED)) {
+    directory_[dir].compare_exchange_strong(segment, nullptr);
+    Retire(segment);
+  }
+}
+
+auto TransactionRegistry::EnterEpoch() -> uint64_t {
+  while (true) {
+    auto epoch = epoch_.load();
+    readers_[epoch % 2]++;
+    // 计数之后纪元没变，回收的线程才一定看得到自己。
+    if (epoch_.load() == epoch) {
+      return epoch;
+    }
+    readers_[epoch % 2]--;
+  }
+}
+
+void TransactionRegistry::ExitEpoch(uint64_t epoch) { readers_[epoch % 2]--; }
+
+void TransactionRegistry::Retire(Segment *segment) {
+  std::scoped_lock lock(retire_latch_);
+  retired_.emplace_back(epoch_.load(), segment);
+  // 上一个纪元里已经没有访问了，就推进纪元；推进之后，两个纪元以前摘下来的段谁也不会再读到。
+  auto epoch = epoch_.load();
+  if (readers_[(epoch + 1) % 2].load() != 0) {
+    return;
+  }
+  epoch_.store(epoch + 1);
+  auto still_visible = [epoch](const std::pair<uint64_t, Segment *> &item) { return item.first >= epoch; };
+  auto reclaimable = std::partition(retired_.begin(), retired_.end(), still_visible);
+  for (auto it = reclaimable; it != retired_.end(); ++it) {
+    delete it->second;
+  }
+  retired_.erase(reclaimable, retired_.end());
+}
+
+}  // namespace bustub
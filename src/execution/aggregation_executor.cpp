@@ -11,9 +11,13 @@
 //===----------------------------------------------------------------------===//
 #include "execution/executors/aggregation_executor.h"
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
+#include "common/config.h"
+#include "common/exception.h"
+
 namespace bustub {
 
 AggregationExecutor::AggregationExecutor(ExecutorContext *exec_ctx, const AggregationPlanNode *plan,
@@ -24,19 +28,178 @@ AggregationExecutor::AggregationExecutor(ExecutorContext *exec_ctx, const Aggreg
       aht_(plan_->GetAggregates(), plan_->GetAggregateTypes()),
       aht_iterator_(aht_.Begin()) {}
 
+AggregationExecutor::~AggregationExecutor() {
+  for (auto &partition : writers_) {
+    DropPartition(&partition);
+  }
+  for (auto &partition : pending_) {
+    DropPartition(&partition);
+  }
+}
+
 void AggregationExecutor::Init() {
   child_->Init();
+  // 重复Init时，先把上一轮没读完的临时页还回去。
+  for (auto &partition : pending_) {
+    DropPartition(&partition);
+  }
+  pending_.clear();
+  aht_.Clear();
+  finished_ = false;
+
+  // 粗略估计一个分组在哈希表里占用的字节数：键值对本身、每个Value，以及哈希表节点的两个指针。
+  size_t group_bytes = sizeof(std::pair<AggregateKey, AggregateValue>) + 2 * sizeof(void *) +
+                       (plan_->GetGroupBys().size() + plan_->GetAggregates().size()) * sizeof(Value);
+  max_groups_ = std::max<size_t>(exec_ctx_->GetAggregationMemoryBudget() / group_bytes, 1);
+
   Tuple tuple;
   RID rid;
-
+  BeginPass(0);
   while (child_->Next(&tuple, &rid)) {
-    aht_.InsertCombine(MakeAggregateKey(&tuple), MakeAggregateValue(&tuple));
+    Accumulate(MakeAggregateKey(&tuple), MakeAggregateValue(&tuple));
+  }
+  EndPass();
+
+  aht_iterator_ = aht_.Begin();
+}
+
+void AggregationExecutor::Accumulate(const AggregateKey &key, const AggregateValue &val) {
+  // 已经在表里的分组总是可以原地合并，只有新分组才受内存预算限制。
+  if (aht_.Size() < max_groups_ || aht_.Contains(key)) {
+    aht_.InsertCombine(key, val);
+    return;
+  }
+  Spill(key, val);
+}
+
+void AggregationExecutor::Spill(const AggregateKey &key, const AggregateValue &val) {
+  if (spill_schema_ == nullptr) {
+    // 溢出行的格式在第一次溢出时按实际的值类型确定。
+    std::vector<Column> columns;
+    auto make_column = [](const Value &value) {
+      return value.GetTypeId() == TypeId::VARCHAR ? Column("spill", TypeId::VARCHAR, VARCHAR_DEFAULT_LENGTH)
+                                                  : Column("spill", value.GetTypeId());
+    };
+    for (const auto &value : key.group_bys_) {
+      columns.push_back(make_column(value));
+    }
+    for (const auto &value : val.aggregates_) {
+      columns.push_back(make_column(value));
+    }
+    spill_schema_ = std::make_unique<Schema>(columns);
+  }
+
+  std::vector<Value> values;
+  values.reserve(spill_schema_->GetColumnCount());
+  values.insert(values.end(), key.group_bys_.begin(), key.group_bys_.end());
+  values.insert(values.end(), val.aggregates_.begin(), val.aggregates_.end());
+  for (uint32_t i = 0; i < values.size(); i++) {
+    auto type = spill_schema_->GetColumn(i).GetType();
+    if (values[i].GetTypeId() != type) {
+      values[i] = values[i].IsNull() ? ValueFactory::GetNullValueByType(type) : values[i].CastAs(type);
+    }
+  }
+  Tuple row{values, spill_schema_.get()};
+
+  // 每一层用不同的种子，保证同一个分区在下一层能被继续打散。
+  auto hash = HashUtil::CombineHashes(HashUtil::Hash(&level_), std::hash<AggregateKey>{}(key));
+  auto &partition = writers_[hash % writers_.size()];
+  TmpTuple out{INVALID_PAGE_ID, 0};
+  if (partition.current_ != nullptr && partition.current_->Insert(row, &out)) {
+    return;
   }
 
+  auto *bpm = exec_ctx_->GetBufferPoolManager();
+  if (partition.current_ != nullptr) {
+    bpm->UnpinPage(partition.current_->GetTablePageId(), true);
+    partition.current_ = nullptr;
+  }
+  page_id_t page_id;
+  auto *page = bpm->NewPage(&page_id);
+  if (page == nullptr) {
+    throw ExecutionException("aggregation can not allocate a page to spill to");
+  }
+  partition.current_ = reinterpret_cast<TmpTuplePage *>(page);
+  partition.current_->Init(page_id, BUSTUB_PAGE_SIZE);
+  partition.pages_.push_back(page_id);
+  if (!partition.current_->Insert(row, &out)) {
+    throw ExecutionException("aggregation row is too large to spill");
+  }
+}
+
+void AggregationExecutor::BeginPass(size_t level) {
+  level_ = level;
+  writers_.clear();
+  writers_.resize(AGGREGATION_SPILL_PARTITIONS);
+  for (auto &partition : writers_) {
+    partition.level_ = level + 1;
+  }
+}
+
+void AggregationExecutor::EndPass() {
+  auto *bpm = exec_ctx_->GetBufferPoolManager();
+  for (auto &partition : writers_) {
+    if (partition.current_ != nullptr) {
+      bpm->UnpinPage(partition.current_->GetTablePageId(), true);
+      partition.current_ = nullptr;
+    }
+    if (!partition.pages_.empty()) {
+      pending_.push_back(std::move(partition));
+    }
+  }
+  writers_.clear();
+}
+
+void AggregationExecutor::LoadPartition() {
+  auto partition = std::move(pending_.front());
+  pending_.pop_front();
+  aht_.Clear();
+
+  auto *bpm = exec_ctx_->GetBufferPoolManager();
+  auto key_count = plan_->GetGroupBys().size();
+  BeginPass(partition.level_);
+  for (auto page_id : partition.pages_) {
+    auto *page = reinterpret_cast<TmpTuplePage *>(bpm->FetchPage(page_id));
+    if (page == nullptr) {
+      throw ExecutionException("aggregation can not read back a spilled page");
+    }
+    Tuple row;
+    for (uint32_t offset = page->GetFreeSpacePointer(); offset < BUSTUB_PAGE_SIZE;) {
+      offset = page->Get(offset, &row);
+      std::vector<Value> keys;
+      std::vector<Value> vals;
+      for (uint32_t i = 0; i < spill_schema_->GetColumnCount(); i++) {
+        (i < key_count ? keys : vals).emplace_back(row.GetValue(spill_schema_.get(), i));
+      }
+      Accumulate({keys}, {vals});
+    }
+    // 读完一页就把它还给缓冲池，后续的溢出可以复用这些帧。
+    bpm->UnpinPage(page_id, false);
+    bpm->DeletePage(page_id);
+  }
+  EndPass();
+
   aht_iterator_ = aht_.Begin();
 }
 
+void AggregationExecutor::DropPartition(SpillPartition *partition) {
+  auto *bpm = exec_ctx_->GetBufferPoolManager();
+  if (partition->current_ != nullptr) {
+    bpm->UnpinPage(partition->current_->GetTablePageId(), false);
+    partition->current_ = nullptr;
+  }
+  for (auto page_id : partition->pages_) {
+    bpm->DeletePage(page_id);
+  }
+  partition->pages_.clear();
+}
+
 auto AggregationExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  // 内存里的分组输出完之后，再逐个处理溢出到临时页上的分区。
+  while (aht_iterator_ == aht_.End() && !pending_.empty()) {
+    LoadPartition();
+  }
+
   if (!finished_ && aht_iterator_ == aht_.End()) {
     // Tuple由group_bys和aggregates两部分组成，
     // 如果group_bys大于0，说明由group by，这个时候全部由aggregates组成，根据这部分判断是否需要直接返回空。
@@ -14,6 +14,8 @@
 
 #include <memory>
 
+#include "concurrency/next_key_locker.h"
+
 namespace bustub {
 
 DeleteExecutor::DeleteExecutor(ExecutorContext *exec_ctx, const DeletePlanNode *plan,
@@ -24,6 +26,13 @@ void DeleteExecutor::Init() {
   child_executor_->Init();
   txn_ = exec_ctx_->GetTransaction();
   lock_mgr_ = exec_ctx_->GetLockManager();
+  if (txn_->IsReadOnly()) {
+    throw ExecutionException("read-only transaction cannot delete\n");
+  }
+  // 乐观事务执行时不加锁，提交时才拿锁。
+  if (txn_->IsOptimistic()) {
+    return;
+  }
   try {
     bool flag = lock_mgr_->LockTable(txn_, LockManager::LockMode::INTENTION_EXCLUSIVE, plan_->table_oid_);
     if (!flag) {
@@ -48,6 +57,13 @@ auto DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   int32_t delete_count = 0;
 
   while (child_executor_->Next(&delete_tuple, &delete_rid)) {
+    // 乐观事务只记下要删哪一行，提交时验证通过再删。
+    if (txn_->IsOptimistic()) {
+      txn_->GetBufferedWriteSet()->emplace_back(WType::DELETE, plan_->table_oid_, delete_rid, delete_tuple,
+                                                exec_ctx_->GetCatalog());
+      ++delete_count;
+      continue;
+    }
     try {
       bool flag = lock_mgr_->LockRow(txn_, LockManager::LockMode::EXCLUSIVE, plan_->table_oid_, delete_rid);
       if (!flag) {
@@ -58,11 +74,26 @@ auto DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
     }
 
     bool deleted = table_info->table_->MarkDelete(delete_rid, exec_ctx_->GetTransaction());
+    if (!deleted && txn_->GetState() == TransactionState::ABORTED) {
+      // 快照隔离下这一行在快照之后被别人改过了，先提交的赢。
+      throw ExecutionException("write-write conflict in delete\n");
+    }
 
     if (deleted) {
+      NextKeyLocker key_locker(lock_mgr_, txn_);
       for (auto &it : indexs) {
         Tuple key =
             delete_tuple.KeyFromTuple(child_executor_->GetOutputSchema(), it->key_schema_, it->index_->GetKeyAttrs());
+        // 被删的键要是在别人扫过的范围里，就等那个事务结束。
+        if (NextKeyLocker::Needed(txn_)) {
+          try {
+            if (!key_locker.LockDelete(it, key)) {
+              throw ExecutionException("get key lock fail in delete\n");
+            }
+          } catch (...) {
+            throw ExecutionException("get key lock fail in delete , maybe it be killed\n");
+          }
+        }
         it->index_->DeleteEntry(key, delete_rid, exec_ctx_->GetTransaction());
       }
 
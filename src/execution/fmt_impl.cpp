@@ -10,6 +10,7 @@
 #include "execution/plans/limit_plan.h"
 #include "execution/plans/projection_plan.h"
 #include "execution/plans/sort_plan.h"
+#include "execution/plans/stream_aggregation_plan.h"
 #include "execution/plans/topn_plan.h"
 
 namespace bustub {
@@ -35,6 +36,10 @@ auto AggregationPlanNode::PlanNodeToString() const -> std::string {
   return fmt::format("Agg {{ types={}, aggregates={}, group_by={} }}", agg_types_, aggregates_, group_bys_);
 }
 
+auto StreamAggregationPlanNode::PlanNodeToString() const -> std::string {
+  return fmt::format("StreamAgg {{ types={}, aggregates={}, group_by={} }}", agg_types_, aggregates_, group_bys_);
+}
+
 auto ProjectionPlanNode::PlanNodeToString() const -> std::string {
   return fmt::format("Projection {{ exprs={} }}", expressions_);
 }
@@ -12,6 +12,11 @@
 
 #include "execution/executors/hash_join_executor.h"
 
+#include "common/exception.h"
+#include "execution/executors/filter_executor.h"
+#include "execution/executors/seq_scan_executor.h"
+#include "type/value_factory.h"
+
 // Note for 2022 Fall: You don't need to implement HashJoinExecutor to pass all tests. You ONLY need to implement it
 // if you want to get faster in leaderboard tests.
 
@@ -20,15 +25,97 @@ namespace bustub {
 HashJoinExecutor::HashJoinExecutor(ExecutorContext *exec_ctx, const HashJoinPlanNode *plan,
                                    std::unique_ptr<AbstractExecutor> &&left_child,
                                    std::unique_ptr<AbstractExecutor> &&right_child)
-    : AbstractExecutor(exec_ctx) {
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      left_child_(std::move(left_child)),
+      right_child_(std::move(right_child)) {
   if (!(plan->GetJoinType() == JoinType::LEFT || plan->GetJoinType() == JoinType::INNER)) {
     // Note for 2022 Fall: You ONLY need to implement left join and inner join.
     throw bustub::NotImplementedException(fmt::format("join type {} not supported", plan->GetJoinType()));
   }
 }
 
-void HashJoinExecutor::Init() { throw NotImplementedException("HashJoinExecutor is not implemented"); }
+void HashJoinExecutor::Init() {
+  right_child_->Init();
+
+  // 右边建表，左边探测，这样输出顺序和嵌套循环连接一样。
+  hash_table_.clear();
+  Tuple right_tuple{};
+  RID right_rid{};
+  while (right_child_->Next(&right_tuple, &right_rid)) {
+    auto key = plan_->RightJoinKeyExpression().Evaluate(&right_tuple, right_child_->GetOutputSchema());
+    // null和谁都不相等，不用进表。
+    if (key.IsNull()) {
+      continue;
+    }
+    hash_table_[HashJoinKey{key}].push_back(right_tuple);
+  }
+
+  if (plan_->GetJoinType() == JoinType::INNER) {
+    bloom_filter_.Reset(hash_table_.size());
+    for (const auto &[join_key, tuples] : hash_table_) {
+      bloom_filter_.Insert(BlockedBloomFilter::HashKey(join_key.key_));
+    }
+    PushDownBloomFilter();
+  }
+  // 探测边要在新的过滤器装好以后再Init，不然扫描会先拿上一轮的过滤器把这一页筛掉一部分。
+  left_child_->Init();
+
+  if (plan_->GetJoinType() == JoinType::LEFT) {
+    std::vector<Value> values;
+    const auto &right_schema = right_child_->GetOutputSchema();
+    values.reserve(right_schema.GetColumnCount());
+    for (const auto &column : right_schema.GetColumns()) {
+      values.push_back(ValueFactory::GetNullValueByType(column.GetType()));
+    }
+    null_right_tuple_ = Tuple{values, &right_schema};
+  }
 
-auto HashJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool { return false; }
+  matches_ = nullptr;
+  cursor_ = 0;
+}
+
+void HashJoinExecutor::PushDownBloomFilter() {
+  // 过滤器按左边输出的schema算key，只能穿过不改变schema的filter。
+  auto *child = left_child_.get();
+  while (auto *filter = dynamic_cast<FilterExecutor *>(child)) {
+    child = filter->GetChildExecutor();
+  }
+  if (auto *seq_scan = dynamic_cast<SeqScanExecutor *>(child); seq_scan != nullptr) {
+    seq_scan->SetBloomFilter(&bloom_filter_, &plan_->LeftJoinKeyExpression());
+  }
+}
+
+auto HashJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  const auto &left_schema = left_child_->GetOutputSchema();
+  const auto &right_schema = right_child_->GetOutputSchema();
+
+  while (true) {
+    if (matches_ != nullptr && cursor_ < matches_->size()) {
+      *tuple = Tuple{left_tuple_, &left_schema, (*matches_)[cursor_++], &right_schema};
+      return true;
+    }
+
+    RID left_rid{};
+    if (!left_child_->Next(&left_tuple_, &left_rid)) {
+      return false;
+    }
+    matches_ = nullptr;
+    cursor_ = 0;
+
+    auto key = plan_->LeftJoinKeyExpression().Evaluate(&left_tuple_, left_schema);
+    if (!key.IsNull()) {
+      if (auto it = hash_table_.find(HashJoinKey{key}); it != hash_table_.end()) {
+        matches_ = &it->second;
+        continue;
+      }
+    }
+
+    if (plan_->GetJoinType() == JoinType::LEFT) {
+      *tuple = Tuple{left_tuple_, &left_schema, null_right_tuple_, &right_schema};
+      return true;
+    }
+  }
+}
 
 }  // namespace bustub
@@ -11,6 +11,14 @@
 //===----------------------------------------------------------------------===//
 #include "execution/executors/index_scan_executor.h"
 
+#include <algorithm>
+#include <utility>
+
+#include "common/exception.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/next_key_locker.h"
+#include "type/limits.h"
+
 namespace bustub {
 IndexScanExecutor::IndexScanExecutor(ExecutorContext *exec_ctx, const IndexScanPlanNode *plan)
     : AbstractExecutor(exec_ctx), plan_(plan) {}
@@ -25,18 +33,107 @@ void IndexScanExecutor::Init() {
   // 因为非聚簇索引，所以树上只有RID，没有数据，想获得数据，要先获得RID和table，然后朝着table要数据.
   // table_name 藏在tree上。
   table_info_ = exec_ctx_->GetCatalog()->GetTable(tree->GetMetadata()->GetTableName());
-  iter_ = tree->GetBeginIterator();
+
+  auto *txn = exec_ctx_->GetTransaction();
+  auto *lock_mgr = exec_ctx_->GetLockManager();
+  // REPEATABLE_READ要防幻读：整个索引都扫的话直接锁表，范围扫描只锁扫到的键和它们下面的间隙。
+  // 只读事务整个索引都扫的时候也直接拿表的S锁；点查和范围扫描照旧只锁键，不然一个点查就把整张表的写者都挡住了。
+  bool locking = NextKeyLocker::Needed(txn);
+  try {
+    bool key_range = plan_->IsRangeScan() && locking;
+    auto mode = key_range ? LockManager::LockMode::INTENTION_SHARED : LockManager::LockMode::SHARED;
+    bool whole_table = !plan_->IsRangeScan() && txn->LocksWholeTables();
+    if ((locking || whole_table) && !lock_mgr->LockTable(txn, mode, table_info_->oid_)) {
+      throw ExecutionException("get table lock fail in index_scan\n");
+    }
+  } catch (TransactionAbortException &e) {
+    throw ExecutionException("get table lock fail in index_scan , may be it be killed \n");
+  }
+
+  if (!plan_->IsRangeScan()) {
+    iter_ = tree->GetBeginIterator();
+    return;
+  }
+
+  range_rids_.clear();
+  range_cursor_ = 0;
+  auto lower = std::max<int64_t>(plan_->lower_key_.value_or(BUSTUB_INT32_MIN), BUSTUB_INT32_MIN);
+  auto upper = std::min<int64_t>(plan_->upper_key_.value_or(BUSTUB_INT32_MAX), BUSTUB_INT32_MAX);
+  if (lower > upper) {
+    return;
+  }
+  IntegerKeyType lower_key;
+  lower_key.SetFromKey(Tuple({Value(TypeId::INTEGER, static_cast<int32_t>(lower))}, &index_info->key_schema_));
+
+  // 范围里的每个键锁住它和下面的间隙，最后再锁住范围之后的第一个键，范围上面的间隙也就没人能插了。
+  // 迭代器钉着叶子页又不拿latch，不能拿着它去等锁：先不等锁把范围读一遍，锁上读到的键，再读一遍。
+  // 等锁的时候有人在范围里插了或删了，两遍就不一样，把新读到的键也锁上再读，直到两遍一样。
+  std::vector<int64_t> keys;
+  int64_t next = CollectRange(tree, index_info, lower_key, upper, &keys, &range_rids_);
+  if (!locking) {
+    return;
+  }
+  try {
+    while (true) {
+      for (auto key : keys) {
+        if (!lock_mgr->LockKey(txn, LockManager::LockMode::SHARED, plan_->index_oid_, key)) {
+          throw ExecutionException("get key lock fail in index_scan\n");
+        }
+      }
+      if (!lock_mgr->LockKey(txn, LockManager::LockMode::SHARED, plan_->index_oid_, next)) {
+        throw ExecutionException("get key lock fail in index_scan\n");
+      }
+      std::vector<int64_t> locked_keys;
+      std::vector<RID> locked_rids;
+      auto locked_next = CollectRange(tree, index_info, lower_key, upper, &locked_keys, &locked_rids);
+      if (locked_keys == keys && locked_rids == range_rids_ && locked_next == next) {
+        break;
+      }
+      keys = std::move(locked_keys);
+      range_rids_ = std::move(locked_rids);
+      next = locked_next;
+    }
+  } catch (TransactionAbortException &e) {
+    throw ExecutionException("get key lock fail in index_scan , may be it be killed \n");
+  }
+}
+
+auto IndexScanExecutor::CollectRange(BPlusTreeIndexForOneIntegerColumn *tree, IndexInfo *index_info,
+                                     const IntegerKeyType &lower_key, int64_t upper, std::vector<int64_t> *keys,
+                                     std::vector<RID> *rids) -> int64_t {
+  keys->clear();
+  rids->clear();
+  for (auto iter = tree->GetBeginIterator(lower_key); !iter.IsEnd(); ++iter) {
+    int64_t key = NextKeyLocker::KeyOf((*iter).first, index_info);
+    if (key > upper) {
+      return key;
+    }
+    keys->push_back(key);
+    rids->push_back((*iter).second);
+  }
+  return LockManager::KEY_RANGE_END;
 }
 
 auto IndexScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  if (iter_.IsEnd()) {
+  if (plan_->IsRangeScan()) {
+    while (range_cursor_ < range_rids_.size()) {
+      *rid = range_rids_[range_cursor_++];
+      if (table_info_->table_->GetTuple(*rid, tuple, exec_ctx_->GetTransaction())) {
+        return true;
+      }
+    }
     return false;
   }
-  *rid = (*iter_).second;
-  // 在table上gettuple通过rid。
-  table_info_->table_->GetTuple(*rid, tuple, exec_ctx_->GetTransaction());
-  ++iter_;
-  return true;
+
+  while (!iter_.IsEnd()) {
+    *rid = (*iter_).second;
+    ++iter_;
+    // 在table上gettuple通过rid。别人还没提交的插入、快照看不到的版本，这里拿不到，跳过。
+    if (table_info_->table_->GetTuple(*rid, tuple, exec_ctx_->GetTransaction())) {
+      return true;
+    }
+  }
+  return false;
 }
 
 }  // namespace bustub
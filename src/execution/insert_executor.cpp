@@ -13,8 +13,11 @@
 #include "execution/executors/insert_executor.h"
 
 #include <memory>
+#include <utility>
+#include "common/config.h"
 #include "common/exception.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/next_key_locker.h"
 
 namespace bustub {
 
@@ -29,6 +32,15 @@ void InsertExecutor::Init() {
   child_executor_->Init();
   txn_ = exec_ctx_->GetTransaction();
   lock_mgr_ = exec_ctx_->GetLockManager();
+  table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->table_oid_);
+  indexs_ = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
+  if (txn_->IsReadOnly()) {
+    throw ExecutionException("read-only transaction cannot insert\n");
+  }
+  // 乐观事务执行时不加锁，提交时才拿锁。
+  if (txn_->IsOptimistic()) {
+    return;
+  }
 
   try {
     bool flag = lock_mgr_->LockTable(txn_, LockManager::LockMode::INTENTION_EXCLUSIVE, plan_->table_oid_);
@@ -52,37 +64,24 @@ auto InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   // 如果不知道怎么做，可以打印出来schema看看。
   // Tuple和schema是密不可分的，但是却又不能封装在一个类中。
   // Tuple保存着数据，schema保存着解释Tuple的方式。
-  auto *table_info = exec_ctx_->GetCatalog()->GetTable(plan_->table_oid_);
-  std::vector<IndexInfo *> indexs = exec_ctx_->GetCatalog()->GetTableIndexes(table_info->name_);
+  // 子节点的tuple先攒起来，攒够INSERT_BATCH_SIZE字节就整页追加到表尾，省掉逐行找页和加锁存页的开销。
   Tuple insert_tuple;
   RID insert_rid;
   int32_t insert_count = 0;
+  std::vector<Tuple> batch;
+  size_t batch_bytes = 0;
 
   while (child_executor_->Next(&insert_tuple, &insert_rid)) {
-    // 在表中可以直接插入tuple。
-
-    try {
-      bool flag = lock_mgr_->LockRow(txn_, LockManager::LockMode::EXCLUSIVE, plan_->table_oid_, insert_rid);
-      if (!flag) {
-        throw ExecutionException("get row lock fail in insert\n");
-      }
-    } catch (...) {
-      throw ExecutionException("get row lock fail in insert , maybe it be killed\n");
-    }
-
-    bool inserted = table_info->table_->InsertTuple(insert_tuple, &insert_rid, exec_ctx_->GetTransaction());
-
-    if (inserted) {
-      for (auto &it : indexs) {
-        // 但是在index中不能直接插入tuple，因为index中保存的是(key, rid)对，所以要对insert_tuple用KeyFromTuple
-        // 三个参数是tuple的schema（翻译成框架比较好吧），要取出key类型的schema，和要取出key类型的列组。
-        Tuple key =
-            insert_tuple.KeyFromTuple(child_executor_->GetOutputSchema(), it->key_schema_, it->index_->GetKeyAttrs());
-        it->index_->InsertEntry(key, insert_rid, exec_ctx_->GetTransaction());
-      }
-      ++insert_count;
+    batch_bytes += insert_tuple.GetLength();
+    batch.push_back(std::move(insert_tuple));
+    if (batch_bytes >= static_cast<size_t>(INSERT_BATCH_SIZE)) {
+      insert_count += InsertBatch(batch, true);
+      batch.clear();
+      batch_bytes = 0;
     }
   }
+  // 剩下的不够一页就逐行插入，这样可以复用已有页面的空闲空间。
+  insert_count += InsertBatch(batch, batch_bytes >= static_cast<size_t>(BUSTUB_PAGE_SIZE));
 
   // 执行一个之后就可以设定为true,下次就直接返回false即可。
   finished_ = true;
@@ -96,4 +95,71 @@ auto InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   return true;
 }
 
+auto InsertExecutor::InsertBatch(const std::vector<Tuple> &tuples, bool bulk) -> int32_t {
+  if (tuples.empty()) {
+    return 0;
+  }
+
+  // 乐观事务只把要插的tuple记下来，等提交验证通过再真正插入。
+  if (txn_->IsOptimistic()) {
+    for (const auto &insert_tuple : tuples) {
+      txn_->GetBufferedWriteSet()->emplace_back(WType::INSERT, plan_->table_oid_, RID{}, insert_tuple,
+                                                exec_ctx_->GetCatalog());
+    }
+    return static_cast<int32_t>(tuples.size());
+  }
+
+  if (bulk) {
+    std::vector<RID> rids;
+    if (!table_info_->table_->AppendBatch(tuples, &rids, txn_)) {
+      throw ExecutionException("bulk append fail in insert\n");
+    }
+    for (size_t i = 0; i < tuples.size(); i++) {
+      LockAndIndex(tuples[i], rids[i]);
+    }
+    return static_cast<int32_t>(tuples.size());
+  }
+
+  int32_t insert_count = 0;
+  for (const auto &insert_tuple : tuples) {
+    RID insert_rid;
+    // 在表中可以直接插入tuple。
+    if (table_info_->table_->InsertTuple(insert_tuple, &insert_rid, txn_)) {
+      LockAndIndex(insert_tuple, insert_rid);
+      ++insert_count;
+    }
+  }
+  return insert_count;
+}
+
+void InsertExecutor::LockAndIndex(const Tuple &tuple, const RID &rid) {
+  // 锁的是新插入的行，而不是子节点给出的rid。
+  try {
+    bool flag = lock_mgr_->LockRow(txn_, LockManager::LockMode::EXCLUSIVE, plan_->table_oid_, rid);
+    if (!flag) {
+      throw ExecutionException("get row lock fail in insert\n");
+    }
+  } catch (...) {
+    throw ExecutionException("get row lock fail in insert , maybe it be killed\n");
+  }
+
+  NextKeyLocker key_locker(lock_mgr_, txn_);
+  for (auto &it : indexs_) {
+    // 但是在index中不能直接插入tuple，因为index中保存的是(key, rid)对，所以要对insert_tuple用KeyFromTuple
+    // 三个参数是tuple的schema（翻译成框架比较好吧），要取出key类型的schema，和要取出key类型的列组。
+    Tuple key = tuple.KeyFromTuple(child_executor_->GetOutputSchema(), it->key_schema_, it->index_->GetKeyAttrs());
+    // 新键落进的间隙要是被范围扫描锁着，就等扫描的事务结束，不然它再扫一遍会多出一行。
+    if (NextKeyLocker::Needed(txn_)) {
+      try {
+        if (!key_locker.LockInsert(it, key)) {
+          throw ExecutionException("get key lock fail in insert\n");
+        }
+      } catch (...) {
+        throw ExecutionException("get key lock fail in insert , maybe it be killed\n");
+      }
+    }
+    it->index_->InsertEntry(key, rid, txn_);
+  }
+}
+
 }  // namespace bustub
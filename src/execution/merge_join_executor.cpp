@@ -0,0 +1,121 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// merge_join_executor.cpp
+//
+// Identification: src/execution/merge_join_executor.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/executors/merge_join_executor.h"
+
+#include "common/exception.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+MergeJoinExecutor::MergeJoinExecutor(ExecutorContext *exec_ctx, const MergeJoinPlanNode *plan,
+                                     std::unique_ptr<AbstractExecutor> &&left_child,
+                                     std::unique_ptr<AbstractExecutor> &&right_child)
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      left_child_(std::move(left_child)),
+      right_child_(std::move(right_child)) {
+  if (!(plan->GetJoinType() == JoinType::LEFT || plan->GetJoinType() == JoinType::INNER)) {
+    throw bustub::NotImplementedException(fmt::format("join type {} not supported", plan->GetJoinType()));
+  }
+}
+
+void MergeJoinExecutor::Init() {
+  left_child_->Init();
+  right_child_->Init();
+
+  if (plan_->GetJoinType() == JoinType::LEFT) {
+    std::vector<Value> values;
+    const auto &right_schema = right_child_->GetOutputSchema();
+    values.reserve(right_schema.GetColumnCount());
+    for (const auto &column : right_schema.GetColumns()) {
+      values.push_back(ValueFactory::GetNullValueByType(column.GetType()));
+    }
+    null_right_tuple_ = Tuple{values, &right_schema};
+  }
+
+  run_.clear();
+  run_idx_ = 0;
+  left_valid_ = false;
+  AdvanceRight();
+}
+
+auto MergeJoinExecutor::AdvanceLeft() -> bool {
+  RID rid;
+  left_valid_ = left_child_->Next(&left_tuple_, &rid);
+  if (left_valid_) {
+    left_key_ = plan_->LeftJoinKeyExpression().Evaluate(&left_tuple_, left_child_->GetOutputSchema());
+  }
+  return left_valid_;
+}
+
+auto MergeJoinExecutor::AdvanceRight() -> bool {
+  RID rid;
+  right_valid_ = right_child_->Next(&right_tuple_, &rid);
+  if (right_valid_) {
+    right_key_ = plan_->RightJoinKeyExpression().Evaluate(&right_tuple_, right_child_->GetOutputSchema());
+  }
+  return right_valid_;
+}
+
+auto MergeJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  const auto &left_schema = left_child_->GetOutputSchema();
+  const auto &right_schema = right_child_->GetOutputSchema();
+
+  while (true) {
+    // 当前左tuple和run里的右tuple逐个拼接。
+    if (left_valid_ && run_idx_ < run_.size()) {
+      *tuple = Tuple{left_tuple_, &left_schema, run_[run_idx_++], &right_schema};
+      return true;
+    }
+
+    if (!AdvanceLeft()) {
+      return false;
+    }
+
+    // null不等于任何值，直接当作没匹配上。
+    bool matched = false;
+    if (!left_key_.IsNull()) {
+      // 下一个左tuple的键没变，run可以直接复用，重复键只缓存右边这一段。
+      if (!run_.empty() && left_key_.CompareEquals(run_key_) == CmpBool::CmpTrue) {
+        matched = true;
+      } else {
+        run_.clear();
+        // 右边跳过比左键小的部分（包括null）。
+        while (right_valid_ && (right_key_.IsNull() || right_key_.CompareLessThan(left_key_) == CmpBool::CmpTrue)) {
+          AdvanceRight();
+        }
+        if (right_valid_ && right_key_.CompareEquals(left_key_) == CmpBool::CmpTrue) {
+          run_key_ = right_key_;
+          while (right_valid_ && right_key_.CompareEquals(run_key_) == CmpBool::CmpTrue) {
+            run_.push_back(right_tuple_);
+            AdvanceRight();
+          }
+          matched = true;
+        }
+      }
+    }
+
+    if (matched) {
+      run_idx_ = 0;
+      continue;
+    }
+
+    run_idx_ = run_.size();
+    if (plan_->GetJoinType() == JoinType::LEFT) {
+      *tuple = Tuple{left_tuple_, &left_schema, null_right_tuple_, &right_schema};
+      return true;
+    }
+  }
+}
+
+}  // namespace bustub
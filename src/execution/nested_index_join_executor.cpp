@@ -12,6 +12,8 @@
 
 #include "execution/executors/nested_index_join_executor.h"
 
+#include <algorithm>
+
 namespace bustub {
 
 // 至于为什么把列表构造函数写成这样的狗屎我也忘了。
@@ -37,110 +39,93 @@ NestIndexJoinExecutor::NestIndexJoinExecutor(ExecutorContext *exec_ctx, const Ne
 void NestIndexJoinExecutor::Init() {
   child_executor_->Init();
   tree_ = dynamic_cast<BPlusTreeIndexForOneIntegerColumn *>(index_info_->index_.get());
-  // std::cout << child_executor_->GetOutputSchema().ToString() << "   " << plan_->InnerTableSchema().ToString()
-  //           << std::endl;
-}
-
-auto NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  // Inner型：
-  if (plan_->GetJoinType() == JoinType::INNER) {
-    std::vector<RID> tmp_rid;
-    Tuple left_tuple;
-    RID left_rid;
-
-    // 没有查找到就一直查找，因为不插入重复键，所以要么可以连接，要么直接不用管。
-    while (child_executor_->Next(&left_tuple, &left_rid)) {
-      // Tuple key = left_tuple.KeyFromTuple(child_executor_->GetOutputSchema(), index_info_->key_schema_,
-      //                                     index_info_->index_->GetKeyAttrs());
-
-      // index probe key.
-      // 这里要注意，这里和KeyFromTuple不同，需要取出需要进行寻找的那个Value，而不是Key。
-      // 因为用于equal-join，所以只需要寻找一个相同的即可。
-      // plan保存着key_predicate，取出对应的Value去index中查找。
-      Tuple key =
-          Tuple{std::vector<Value>(1, plan_->key_predicate_->Evaluate(&left_tuple, child_executor_->GetOutputSchema())),
-                &index_info_->key_schema_};
-
-      tree_->ScanKey(key, &tmp_rid, exec_ctx_->GetTransaction());
-
-      // 查找到了、
-      if (tmp_rid.size() == 1) {
-        Tuple right_tuple;
-        right_table_info_->table_->GetTuple(tmp_rid.front(), &right_tuple, exec_ctx_->GetTransaction());
-
-        std::vector<Value> values;
 
-        // 两个schema，然后进行拼接。
-        uint32_t n1 = child_executor_->GetOutputSchema().GetColumnCount();
-        uint32_t n2 = plan_->InnerTableSchema().GetColumnCount();
-
-        values.reserve(n1 + n2);
-
-        for (uint32_t k = 0; k < n1; ++k) {
-          values.push_back(left_tuple.GetValue(&child_executor_->GetOutputSchema(), k));
-        }
-
-        for (uint32_t k = 0; k < n2; ++k) {
-          values.push_back(right_tuple.GetValue(&plan_->InnerTableSchema(), k));
-        }
-
-        *tuple = Tuple{values, &GetOutputSchema()};
-        return true;
-      }
+  if (plan_->GetJoinType() == JoinType::LEFT) {
+    std::vector<Value> values;
+    values.reserve(plan_->InnerTableSchema().GetColumnCount());
+    for (const auto &column : plan_->InnerTableSchema().GetColumns()) {
+      values.push_back(ValueFactory::GetNullValueByType(column.GetType()));
     }
-
-    // 找完了
-    return false;
+    null_inner_tuple_ = Tuple{values, &plan_->InnerTableSchema()};
   }
 
-  // left_join :
-  // 和Innerjoin差不多，就是如果左边没找到需要补充空。
-  Tuple left_tuple{};
-  RID left_rid;
+  batch_.clear();
+  cursor_ = 0;
+}
 
-  // 这里不需要while循环，因为必定返回tuple。
-  if (!child_executor_->Next(&left_tuple, &left_rid)) {
+auto NestIndexJoinExecutor::NextBatch() -> bool {
+  const auto &outer_schema = child_executor_->GetOutputSchema();
+  batch_.clear();
+  cursor_ = 0;
+
+  Tuple outer_tuple;
+  RID outer_rid;
+  std::vector<Value> keys;
+  while (batch_.size() < static_cast<size_t>(NIJ_BATCH_SIZE) && child_executor_->Next(&outer_tuple, &outer_rid)) {
+    keys.push_back(plan_->key_predicate_->Evaluate(&outer_tuple, outer_schema));
+    batch_.push_back(outer_tuple);
+  }
+  inner_tuples_.assign(batch_.size(), Tuple{});
+  matched_.assign(batch_.size(), false);
+  if (batch_.empty()) {
     return false;
   }
 
-  Tuple key =
-      Tuple{std::vector<Value>(1, plan_->key_predicate_->Evaluate(&left_tuple, child_executor_->GetOutputSchema())),
-            &index_info_->key_schema_};
-  // child_executor的schema是left，plan的innerschema是right。
-  // Tuple key = left_tuple.KeyFromTuple(child_executor_->GetOutputSchema(), index_info_->key_schema_,
-  //                                     index_info_->index_->GetKeyAttrs());
-
-  // std::cout << child_executor_->GetOutputSchema().ToString() << "    " << plan_->InnerTableSchema().ToString()
-  //           << std::endl;
-  std::vector<RID> tmp_rid;
-  tree_->ScanKey(key, &tmp_rid, exec_ctx_->GetTransaction());
-  // 拼装
-  std::vector<Value> values;
-
-  uint32_t n1 = child_executor_->GetOutputSchema().GetColumnCount();
-  uint32_t n2 = plan_->InnerTableSchema().GetColumnCount();
+  // 1. 按键排序，B+树按键的顺序查找，相邻的键多半落在同一个叶子上。null不会匹配任何东西，不用查。
+  std::vector<size_t> order;
+  order.reserve(batch_.size());
+  for (size_t i = 0; i < batch_.size(); ++i) {
+    if (!keys[i].IsNull()) {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(),
+            [&keys](size_t lhs, size_t rhs) { return keys[lhs].CompareLessThan(keys[rhs]) == CmpBool::CmpTrue; });
 
-  values.reserve(n1 + n2);
+  std::vector<Tuple> key_tuples;
+  key_tuples.reserve(order.size());
+  for (auto i : order) {
+    key_tuples.emplace_back(std::vector<Value>{keys[i]}, &index_info_->key_schema_);
+  }
+  std::vector<std::pair<size_t, RID>> hits;
+  tree_->ScanKeys(key_tuples, &hits, exec_ctx_->GetTransaction());
 
-  for (uint32_t k = 0; k < n1; ++k) {
-    values.push_back(left_tuple.GetValue(&child_executor_->GetOutputSchema(), k));
+  // 2. 命中的RID按页号排序之后再去堆表取数据，同一页上的tuple只需要连续访问。
+  for (auto &[pos, rid] : hits) {
+    pos = order[pos];
+  }
+  std::sort(hits.begin(), hits.end(), [](const auto &lhs, const auto &rhs) {
+    return lhs.second.GetPageId() != rhs.second.GetPageId() ? lhs.second.GetPageId() < rhs.second.GetPageId()
+                                                            : lhs.second.GetSlotNum() < rhs.second.GetSlotNum();
+  });
+  for (const auto &[pos, rid] : hits) {
+    matched_[pos] = right_table_info_->table_->GetTuple(rid, &inner_tuples_[pos], exec_ctx_->GetTransaction());
   }
+  return true;
+}
 
-  // 没找到的情况：
-  if (tmp_rid.empty()) {
-    for (uint32_t k = 0; k < n2; ++k) {
-      // 其实这里直接填整型就好，但是为了通用性，写了GetType（）.
-      values.push_back(ValueFactory::GetNullValueByType(plan_->InnerTableSchema().GetColumn(k).GetType()));
+auto NestIndexJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  const auto &outer_schema = child_executor_->GetOutputSchema();
+  const auto &inner_schema = plan_->InnerTableSchema();
+
+  while (true) {
+    // 3. 按外表原来的顺序输出。
+    while (cursor_ < batch_.size()) {
+      size_t i = cursor_++;
+      if (matched_[i]) {
+        *tuple = Tuple{batch_[i], &outer_schema, inner_tuples_[i], &inner_schema};
+        return true;
+      }
+      if (plan_->GetJoinType() == JoinType::LEFT) {
+        *tuple = Tuple{batch_[i], &outer_schema, null_inner_tuple_, &inner_schema};
+        return true;
+      }
     }
-  } else {
-    Tuple right_tuple;
-    right_table_info_->table_->GetTuple(tmp_rid.front(), &right_tuple, exec_ctx_->GetTransaction());
-    for (uint32_t k = 0; k < n2; ++k) {
-      values.push_back(right_tuple.GetValue(&plan_->InnerTableSchema(), k));
+
+    if (!NextBatch()) {
+      return false;
     }
   }
-
-  *tuple = Tuple{values, &GetOutputSchema()};
-  return true;
 }
+
 }  // namespace bustub
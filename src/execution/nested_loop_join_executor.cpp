@@ -37,124 +37,79 @@ void NestedLoopJoinExecutor::Init() {
   RID tmp_rid{};
 
   // 因为需要每个左tuple都需要遍历一遍右tuple，所以需要保存右边得所有tuple。
+  right_tuples_.clear();
   while (right_executor_->Next(&tmp_tuple, &tmp_rid)) {
     right_tuples_.push_back(tmp_tuple);
   }
 
-  // j_保存上次停下的位置。
+  if (plan_->GetJoinType() == JoinType::LEFT) {
+    std::vector<Value> values;
+    const auto &right_schema = right_executor_->GetOutputSchema();
+    values.reserve(right_schema.GetColumnCount());
+    for (const auto &column : right_schema.GetColumns()) {
+      values.push_back(ValueFactory::GetNullValueByType(column.GetType()));
+    }
+    null_right_tuple_ = Tuple{values, &right_schema};
+  }
+
+  block_.clear();
+  matched_.clear();
   j_ = right_tuples_.size();
+  i_ = 0;
 }
 
-auto NestedLoopJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
-  if (plan_->GetJoinType() == JoinType::INNER) {
-    RID tmp_rid;
-
-    while (true) {
-      // 找到了底，返回false。
-      if (j_ == right_tuples_.size() && !left_executor_->Next(&left_tuple_, &tmp_rid)) {
-        return false;
-      }
-
-      // 有新的left tuple，重头开始。
-      if (j_ == right_tuples_.size()) {
-        j_ = 0;
-      }
-
-      while (j_ < right_tuples_.size()) {
-        // 评估可否插入、
-        auto match = plan_->Predicate().EvaluateJoin(&left_tuple_, left_executor_->GetOutputSchema(),
-                                                     &right_tuples_[j_], right_executor_->GetOutputSchema());
-
-        if (!match.IsNull() && match.GetAs<bool>()) {
-          std::vector<Value> values;
-          uint32_t n1 = left_executor_->GetOutputSchema().GetColumnCount();
-          uint32_t n2 = right_executor_->GetOutputSchema().GetColumnCount();
-          values.reserve(n1 + n2);
-
-          for (uint32_t k = 0; k < n1; ++k) {
-            values.push_back(left_tuple_.GetValue(&left_executor_->GetOutputSchema(), k));
-          }
-
-          for (uint32_t k = 0; k < n2; ++k) {
-            values.push_back(right_tuples_[j_].GetValue(&right_executor_->GetOutputSchema(), k));
-          }
-
-          *tuple = Tuple{values, &GetOutputSchema()};
-          ++j_;
-
-          return true;
-        }
-
-        ++j_;
-      }
-    }
-    return false;
+auto NestedLoopJoinExecutor::NextBlock() -> bool {
+  block_.clear();
+  Tuple left_tuple;
+  RID left_rid;
+  size_t block_bytes = 0;
+  // 按字节数攒一块左tuple，让一块左tuple加上正在比较的右tuple能留在cache里。
+  while (block_bytes < NLJ_BLOCK_SIZE && left_executor_->Next(&left_tuple, &left_rid)) {
+    block_bytes += sizeof(Tuple) + left_tuple.GetLength();
+    block_.push_back(left_tuple);
   }
+  matched_.assign(block_.size(), false);
+  j_ = 0;
+  i_ = 0;
+  return !block_.empty();
+}
 
-  // left_join :
-  RID tmp_rid;
+auto NestedLoopJoinExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  const auto &left_schema = left_executor_->GetOutputSchema();
+  const auto &right_schema = right_executor_->GetOutputSchema();
 
   while (true) {
-    if (j_ == right_tuples_.size() && !left_executor_->Next(&left_tuple_, &tmp_rid)) {
-      return false;
-    }
-
-    if (j_ == right_tuples_.size()) {
-      j_ = 0;
-    }
-
-    // std::cout << "left_tuple : " << left_tuple_.ToString(&left_executor_->GetOutputSchema())
-    //           << "  right_tuple : " << right_tuples_[j_].ToString(&right_executor_->GetOutputSchema()) << std::endl;
-
-    size_t start = j_;
-
+    // 外层是右tuple，内层是整块左tuple，每块只扫一遍右边。
     while (j_ < right_tuples_.size()) {
-      auto match = plan_->Predicate().EvaluateJoin(&left_tuple_, left_executor_->GetOutputSchema(), &right_tuples_[j_],
-                                                   right_executor_->GetOutputSchema());
-
-      if (!match.IsNull() && match.GetAs<bool>()) {
-        std::vector<Value> values;
-        uint32_t n1 = left_executor_->GetOutputSchema().GetColumnCount();
-        uint32_t n2 = right_executor_->GetOutputSchema().GetColumnCount();
-        values.reserve(n1 + n2);
-
-        for (uint32_t k = 0; k < n1; ++k) {
-          values.push_back(left_tuple_.GetValue(&left_executor_->GetOutputSchema(), k));
-        }
-
-        for (uint32_t k = 0; k < n2; ++k) {
-          values.push_back(right_tuples_[j_].GetValue(&right_executor_->GetOutputSchema(), k));
+      while (i_ < block_.size()) {
+        size_t i = i_++;
+        auto match = plan_->Predicate().EvaluateJoin(&block_[i], left_schema, &right_tuples_[j_], right_schema);
+        if (!match.IsNull() && match.GetAs<bool>()) {
+          matched_[i] = true;
+          // 直接拷贝两边的原始字节，不再逐列取Value重新序列化。
+          *tuple = Tuple{block_[i], &left_schema, right_tuples_[j_], &right_schema};
+          return true;
         }
-
-        *tuple = Tuple{values, &GetOutputSchema()};
-        ++j_;
-        return true;
       }
-
+      i_ = 0;
       ++j_;
     }
 
-    // 从头找到尾都没有找到，
-    if (start == 0 && j_ == right_tuples_.size()) {
-      std::vector<Value> values;
-      uint32_t n1 = left_executor_->GetOutputSchema().GetColumnCount();
-      uint32_t n2 = right_executor_->GetOutputSchema().GetColumnCount();
-      values.reserve(n1 + n2);
-
-      for (uint32_t k = 0; k < n1; ++k) {
-        values.push_back(left_tuple_.GetValue(&left_executor_->GetOutputSchema(), k));
-      }
-
-      for (uint32_t k = 0; k < n2; ++k) {
-        values.push_back(ValueFactory::GetNullValueByType(right_executor_->GetOutputSchema().GetColumn(k).GetType()));
+    // 这一块和右边全部比完了，left join还要补上没匹配到的左tuple。
+    if (plan_->GetJoinType() == JoinType::LEFT) {
+      while (i_ < block_.size()) {
+        size_t i = i_++;
+        if (!matched_[i]) {
+          *tuple = Tuple{block_[i], &left_schema, null_right_tuple_, &right_schema};
+          return true;
+        }
       }
+    }
 
-      *tuple = Tuple{values, &GetOutputSchema()};
-      return true;
+    if (!NextBlock()) {
+      return false;
     }
   }
-
-  return false;
 }
 
 }  // namespace bustub
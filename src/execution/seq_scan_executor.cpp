@@ -11,6 +11,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "execution/executors/seq_scan_executor.h"
+
+#include <utility>
+
 #include "common/exception.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
@@ -26,13 +29,47 @@ SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNod
 void SeqScanExecutor::Init() {
   txn_ = exec_ctx_->GetTransaction();
   lock_mgr_ = exec_ctx_->GetLockManager();
+  // 快照隔离从版本链上读快照，不加任何锁，也就不会和写的人互相挡着。乐观事务也不加锁，提交时再检查读过的版本。
+  locking_ = txn_->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED && !txn_->ReadsSnapshot() &&
+             !txn_->IsOptimistic();
 
-  if (txn_->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED) {
+  // 只读事务整张表拿一个S锁，之后每一行都不用再去锁了。
+  if (locking_ && txn_->LocksWholeTables()) {
+    locking_ = false;
+    if (!lock_mgr_->LockTable(txn_, LockManager::LockMode::SHARED, plan_->table_oid_)) {
+      throw ExecutionException("get table lock fail in seq_scan\n");
+    }
+  }
+
+  if (locking_) {
     bool flag = lock_mgr_->LockTable(txn_, LockManager::LockMode::INTENTION_SHARED, plan_->table_oid_);
     if (!flag) {
       throw ExecutionException("get line lock fail in seq_scan\n");
     }
   }
+
+  // 合并进来的过滤条件和连接推下来的bloom filter都在页里对着原始字节判断，只有通过的tuple才会被拷出来。
+  iter_ = table_info_->table_->Begin(txn_);
+  if (plan_->filter_predicate_ != nullptr || bloom_filter_ != nullptr) {
+    iter_.SetPredicate([this](const Tuple &tuple) { return Accept(tuple); });
+  }
+}
+
+auto SeqScanExecutor::Accept(const Tuple &tuple) const -> bool {
+  if (plan_->filter_predicate_ != nullptr) {
+    auto value = plan_->filter_predicate_->Evaluate(&tuple, plan_->OutputSchema());
+    if (value.IsNull() || !value.GetAs<bool>()) {
+      return false;
+    }
+  }
+  if (bloom_filter_ != nullptr) {
+    // 连接那边肯定匹配不上的tuple直接跳过，连锁都不用加。
+    auto key = bloom_key_expr_->Evaluate(&tuple, plan_->OutputSchema());
+    if (key.IsNull() || !bloom_filter_->MayContain(BlockedBloomFilter::HashKey(key))) {
+      return false;
+    }
+  }
+  return true;
 }
 
 auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
@@ -41,15 +78,16 @@ auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
     return false;
   }
 
-  if (txn_->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED) {
+  if (locking_) {
     bool flag = lock_mgr_->LockRow(txn_, LockManager::LockMode::SHARED, plan_->table_oid_, iter_->GetRid());
     if (!flag) {
       throw ExecutionException("get row lock fail in seq_scan\n");
     }
   }
 
-  *tuple = *iter_;
   *rid = iter_->GetRid();
+  // 迭代器里的tuple下一步就会被覆盖，直接拿走，不再拷一遍。
+  *tuple = std::move(*iter_.operator->());
   ++iter_;
   return true;
 }
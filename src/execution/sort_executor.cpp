@@ -28,6 +28,15 @@ void SortExecutor::Init() {
       // 然后两者Value比较，根据比较结果判断返回值。
       auto l = expr->Evaluate(&lhs, this->GetOutputSchema());
       auto r = expr->Evaluate(&rhs, this->GetOutputSchema());
+      // NULL和谁比都不是CmpTrue，当成相等的话就不是严格弱序了，排出来也不是有序的，merge join和stream agg都靠这个顺序。
+      // 把NULL当成最小的值：升序排在最前面，降序排在最后面；两边都是NULL才看下一个键。
+      if (l.IsNull() || r.IsNull()) {
+        if (l.IsNull() && r.IsNull()) {
+          continue;
+        }
+        bool null_first = l.IsNull();
+        return order_type == OrderByType::DESC ? !null_first : null_first;
+      }
       auto comp1 = l.CompareLessThan(r);
       auto comp2 = r.CompareLessThan(l);
 
@@ -65,8 +74,8 @@ void SortExecutor::Init() {
       BUSTUB_ASSERT(false, "comparion not exit");
     }
 
-    BUSTUB_ASSERT(false, "tuple eq");
-    return true;
+    // 排序键相同的行是可能的（比如按group by的列排序），std::sort要求严格弱序，相等时必须返回false。
+    return false;
   });
 
   iter_ = tuples_.begin();
@@ -0,0 +1,92 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// stream_aggregation_executor.cpp
+//
+// Identification: src/execution/stream_aggregation_executor.cpp
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+#include "execution/executors/stream_aggregation_executor.h"
+
+#include <memory>
+#include <vector>
+
+namespace bustub {
+
+StreamAggregationExecutor::StreamAggregationExecutor(ExecutorContext *exec_ctx, const StreamAggregationPlanNode *plan,
+                                                     std::unique_ptr<AbstractExecutor> &&child)
+    : AbstractExecutor(exec_ctx),
+      plan_(plan),
+      child_(std::move(child)),
+      aht_(plan_->GetAggregates(), plan_->GetAggregateTypes()) {}
+
+void StreamAggregationExecutor::Init() {
+  child_->Init();
+  has_group_ = false;
+  finished_ = false;
+  emitted_ = false;
+}
+
+auto StreamAggregationExecutor::MakeOutputTuple() -> Tuple {
+  std::vector<Value> values;
+  values.reserve(plan_->GetAggregates().size() + plan_->GetGroupBys().size());
+  values.insert(values.end(), group_key_.group_bys_.begin(), group_key_.group_bys_.end());
+  values.insert(values.end(), group_val_.aggregates_.begin(), group_val_.aggregates_.end());
+  emitted_ = true;
+  return Tuple{values, &GetOutputSchema()};
+}
+
+auto StreamAggregationExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  if (finished_) {
+    return false;
+  }
+
+  Tuple child_tuple;
+  RID child_rid;
+  while (child_->Next(&child_tuple, &child_rid)) {
+    auto key = MakeAggregateKey(&child_tuple);
+    auto val = MakeAggregateValue(&child_tuple);
+    // 键变了，说明上一组已经完整，先把它吐出去，再用这一行开新的一组。
+    if (has_group_ && !(key == group_key_)) {
+      *tuple = MakeOutputTuple();
+      group_key_ = std::move(key);
+      group_val_ = aht_.GenerateInitialAggregateValue();
+      aht_.CombineAggregateValues(&group_val_, val);
+      return true;
+    }
+    if (!has_group_) {
+      group_key_ = std::move(key);
+      group_val_ = aht_.GenerateInitialAggregateValue();
+      has_group_ = true;
+    }
+    aht_.CombineAggregateValues(&group_val_, val);
+  }
+
+  finished_ = true;
+  if (has_group_) {
+    *tuple = MakeOutputTuple();
+    return true;
+  }
+
+  // 空输入时和哈希聚合保持一致：没有group by才返回一行，count(*)为0，其余为null。
+  if (emitted_ || !plan_->GetGroupBys().empty()) {
+    return false;
+  }
+  std::vector<Value> values;
+  const auto &types = plan_->GetAggregateTypes();
+  values.reserve(types.size());
+  for (size_t i = 0, n = types.size(); i < n; ++i) {
+    if (types[i] == AggregationType::CountStarAggregate) {
+      values.push_back(ValueFactory::GetIntegerValue(0));
+    } else {
+      values.push_back(ValueFactory::GetNullValueByType(plan_->output_schema_->GetColumn(i).GetType()));
+    }
+  }
+  *tuple = Tuple{values, &GetOutputSchema()};
+  return true;
+}
+
+}  // namespace bustub
@@ -15,6 +15,8 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
@@ -87,6 +89,12 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual auto GetPoolSize() -> size_t = 0;
 
+  /**
+   * The dirty page table of a fuzzy checkpoint: every page that is dirty, or pinned and so possibly being changed.
+   * @return the id and recLSN of each such page
+   */
+  virtual auto GetDirtyPages() -> std::vector<std::pair<page_id_t, lsn_t>> = 0;
+
  protected:
   /**
    * Grading function. Do not modify!
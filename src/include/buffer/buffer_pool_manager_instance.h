@@ -16,6 +16,8 @@
 #include <mutex>  // NOLINT
 #include <shared_mutex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "buffer/lru_k_replacer.h"
@@ -55,6 +57,9 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @brief Return the size (number of frames) of the buffer pool. */
   auto GetPoolSize() -> size_t override { return pool_size_; }
 
+  /** @brief Return the id and recLSN of every page that is dirty or pinned. */
+  auto GetDirtyPages() -> std::vector<std::pair<page_id_t, lsn_t>> override;
+
   /** @brief Return the pointer to all the pages in the buffer pool. */
   // 返回缓存池中的所有页面。
   auto GetPages() -> Page * { return pages_; }
@@ -209,6 +214,40 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   auto DeletePgImp(page_id_t page_id) -> bool override;
 
   auto GetAvaibleFrame(frame_id_t *res) -> bool;
+
+  /**
+   * @brief Write a frame back to its page on disk. The caller made sure the log up to the page's LSN is on disk
+   * (write-ahead rule), see LogIsDurable.
+   * @param frame_id the frame to write
+   */
+  void WritePage(frame_id_t frame_id);
+
+  /**
+   * @return whether the log up to the LSN of the frame is on disk, so that the frame may be written back. A page that
+   * keeps no LSN in its header reads as any number, so the frame also counts as durable once all the log issued so far
+   * is on disk; otherwise the callers retrying until this holds would never stop.
+   */
+  auto LogIsDurable(frame_id_t frame_id) -> bool;
+
+  /**
+   * @brief Force the log up to the LSN of the frame without holding the latch, which is released and taken again.
+   * Whatever the caller looked up in the buffer pool may have changed when this returns.
+   */
+  void ForceLog(std::unique_lock<std::shared_mutex> *lock, frame_id_t frame_id);
+
+  /** How EvictFrame ended */
+  enum class Eviction { NONE, EVICTED, RELATCHED };
+
+  /**
+   * @brief Take a victim frame from the replacer that may be written back right away. A dirty victim whose log is
+   * not on disk yet goes back to the replacer, and the log is forced with the latch released.
+   * @return NONE if nothing can be evicted, EVICTED with the victim in frame_id, or RELATCHED after forcing the log,
+   * in which case the caller has to look at the buffer pool again
+   */
+  auto EvictFrame(std::unique_lock<std::shared_mutex> *lock, frame_id_t *frame_id) -> Eviction;
+
+  /** @return the recLSN of a page just created in the buffer pool */
+  auto NewPageRecLSN() -> lsn_t;
   /** Number of pages in the buffer pool. */
   // 缓冲池中的页面个数。
   const size_t pool_size_;
@@ -227,7 +266,7 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. Please ignore this for P1. */
   // 指向日志管理器，在p1中请忽略。
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
   /** Page table for keeping track of buffer pool pages. */
   // page table来跟踪缓冲池页面。
   ExtendibleHashTable<page_id_t, frame_id_t> *page_table_;
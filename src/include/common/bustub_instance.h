@@ -266,10 +266,26 @@ class BustubInstance {
     return variable == "1" || variable == "true" || variable == "yes";
   }
 
+  /** `SET synchronous_commit = off` makes this session's transactions commit asynchronously. */
+  auto IsAsyncCommit() -> bool {
+    auto variable = StringUtil::Lower(GetSessionVariable("synchronous_commit"));
+    return variable == "0" || variable == "false" || variable == "off" || variable == "no";
+  }
+
+  /** `SET aggregation_memory_budget = <bytes>` overrides the aggregation memory budget for this session. */
+  auto GetAggregationMemoryBudget() -> size_t {
+    auto variable = GetSessionVariable("aggregation_memory_budget");
+    if (variable.empty() || variable.find_first_not_of("0123456789") != std::string::npos) {
+      return aggregation_memory_budget;
+    }
+    return std::stoull(variable);
+  }
+
  private:
   void CmdDisplayTables(ResultWriter &writer);
   void CmdDisplayIndices(ResultWriter &writer);
   void CmdDisplayHelp(ResultWriter &writer);
+  void CmdDisplayLocks(const std::string &arg, ResultWriter &writer);
   void WriteOneCell(const std::string &cell, ResultWriter &writer);
   std::unordered_map<std::string, std::string> session_variables_;
 };
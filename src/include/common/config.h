@@ -14,6 +14,7 @@
 
 #include <atomic>
 #include <chrono>  // NOLINT
+#include <cstddef>
 #include <cstdint>
 
 namespace bustub {
@@ -27,6 +28,12 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** An asynchronously committed transaction is on disk at most ASYNC_COMMIT_DELAY after its commit returned. */
+extern std::chrono::milliseconds async_commit_delay;
+
+/** Bytes the aggregation hash table may use before new groups are spilled to temporary pages. */
+extern size_t aggregation_memory_budget;
+
 static constexpr int INVALID_PAGE_ID = -1;                                           // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                            // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                               // invalid log sequence number
@@ -35,15 +42,40 @@ static constexpr int BUSTUB_PAGE_SIZE = 4096;
 static constexpr int BUFFER_POOL_SIZE = 10;                                          // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * BUSTUB_PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                               // size of extendible hash bucket
+static constexpr int NLJ_BLOCK_SIZE = 256 * 1024;                                    // bytes per nlj outer block
+static constexpr int NIJ_BATCH_SIZE = 256;                                           // outer tuples per nij batch
+static constexpr int INSERT_BATCH_SIZE = 16 * BUSTUB_PAGE_SIZE;                      // bytes per bulk insert batch
 static constexpr int LRUK_REPLACER_K = 10;  // lookback window for lru-k replacer
 
+/** Threads recovery replays the log with: redo workers that each own the pages mapping to them, then undo workers. */
+static constexpr size_t RECOVERY_WORKERS = 4;
+
+/** Unflushed log bytes with a commit waiting on them that make the flush thread force the log without waiting. */
+static constexpr int GROUP_COMMIT_SIZE = 4 * BUSTUB_PAGE_SIZE;
+
+/** Row locks a transaction may hold on one table before the lock manager escalates them to a table lock. */
+static constexpr size_t LOCK_ESCALATION_THRESHOLD = 1024;
+
+/** Version chains a table keeps before a committing writer runs garbage collection over them. */
+static constexpr size_t VERSION_GC_INTERVAL = 1024;
+
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
 using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
+using timestamp_t = int64_t;   // commit timestamp type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
 
+/**
+ * Transaction ids a thread takes from the transaction manager at once, so Begin rarely touches the shared counter.
+ * Ids therefore do not follow the order transactions began in; Transaction::GetStartTs does.
+ */
+static constexpr txn_id_t TXN_ID_BATCH_SIZE = 16;
+
 static constexpr int VARCHAR_DEFAULT_LENGTH = 128;  // default length for varchar when constructing the column
 
+/** Number of partitions a spilling aggregation splits its overflow groups into. */
+static constexpr int AGGREGATION_SPILL_PARTITIONS = 8;
+
 }  // namespace bustub
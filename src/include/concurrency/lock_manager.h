@@ -13,8 +13,11 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <condition_variable>  // NOLINT
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
@@ -28,6 +31,7 @@
 
 #include "common/config.h"
 #include "common/rid.h"
+#include "concurrency/lock_profiler.h"
 #include "concurrency/transaction.h"
 
 namespace bustub {
@@ -41,6 +45,22 @@ class LockManager {
  public:
   enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
 
+  /**
+   * How the lock manager deals with deadlocks. The policies below DETECTION order transactions by their start
+   * timestamps (Transaction::GetStartTs), not by their ids: threads take ids in batches, so a larger id may belong to
+   * an older transaction.
+   */
+  enum class DeadlockPolicy {
+    /** A background thread rebuilds the waits-for graph every cycle_detection_interval and breaks its cycles */
+    DETECTION,
+    /** Blocking requests update the waits-for graph and check whether they close a cycle before they wait */
+    INCREMENTAL_DETECTION,
+    /** An older requester aborts the younger transactions it waits for, a younger requester waits */
+    WOUND_WAIT,
+    /** An older requester waits, a younger requester aborts itself */
+    WAIT_DIE,
+  };
+
   /**
    * Structure to hold a lock request.
    * This could be a lock request on a table OR a row.
@@ -72,13 +92,119 @@ class LockManager {
     /** Whether the lock has been granted or not */
     // 是否已授予锁定
     bool granted_{false};
+    /** Intrusive links of the queue the request sits in, or of the free list of its pool while unused */
+    LockRequest *prev_{nullptr};
+    LockRequest *next_{nullptr};
+  };
+
+  /**
+   * LockRequestList is an intrusive doubly linked list of lock requests: the links live in the requests themselves,
+   * so queueing and dequeueing a request never allocates.
+   */
+  class LockRequestList {
+   public:
+    class Iterator {
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = LockRequest *;
+      using difference_type = std::ptrdiff_t;
+      using pointer = LockRequest **;
+      using reference = LockRequest *;
+
+      explicit Iterator(LockRequest *request = nullptr) : request_(request) {}
+      auto operator*() const -> LockRequest * { return request_; }
+      auto operator++() -> Iterator & {
+        request_ = request_->next_;
+        return *this;
+      }
+      auto operator++(int) -> Iterator {
+        Iterator tmp = *this;
+        request_ = request_->next_;
+        return tmp;
+      }
+      auto operator==(const Iterator &other) const -> bool { return request_ == other.request_; }
+      auto operator!=(const Iterator &other) const -> bool { return request_ != other.request_; }
+
+     private:
+      LockRequest *request_;
+    };
+
+    auto begin() const -> Iterator { return Iterator(head_); }  // NOLINT
+    auto end() const -> Iterator { return Iterator(nullptr); }  // NOLINT
+    auto Empty() const -> bool { return head_ == nullptr; }
+
+    void PushBack(LockRequest *request) {
+      request->prev_ = tail_;
+      request->next_ = nullptr;
+      (tail_ == nullptr ? head_ : tail_->next_) = request;
+      tail_ = request;
+    }
+
+    /** Unlink the request; it is not freed. @return the iterator following it */
+    auto Erase(Iterator iter) -> Iterator {
+      LockRequest *request = *iter;
+      LockRequest *next = request->next_;
+      (request->prev_ == nullptr ? head_ : request->prev_->next_) = next;
+      (next == nullptr ? tail_ : next->prev_) = request->prev_;
+      request->prev_ = request->next_ = nullptr;
+      return Iterator(next);
+    }
+
+   private:
+    LockRequest *head_{nullptr};
+    LockRequest *tail_{nullptr};
   };
 
   class LockRequestQueue {
    public:
+    LockRequestQueue() = default;
+    LockRequestQueue(const LockRequestQueue &) = delete;
+    auto operator=(const LockRequestQueue &) -> LockRequestQueue & = delete;
+    ~LockRequestQueue() {
+      while (!request_queue_.Empty()) {
+        delete *request_queue_.Erase(request_queue_.begin());
+      }
+      while (free_requests_ != nullptr) {
+        delete std::exchange(free_requests_, free_requests_->next_);
+      }
+    }
+
+    /**
+     * Take a request out of the pool of this queue, allocating only when the pool is empty.
+     * Must be called with latch_ held.
+     */
+    auto NewRequest(txn_id_t txn_id, LockMode lock_mode, table_oid_t oid, RID rid = RID()) -> LockRequest * {
+      if (free_requests_ == nullptr) {
+        return new LockRequest(txn_id, lock_mode, oid, rid);
+      }
+      LockRequest *request = std::exchange(free_requests_, free_requests_->next_);
+      *request = LockRequest(txn_id, lock_mode, oid, rid);
+      return request;
+    }
+
+    /** Unlink a request from the queue and return it to the pool. Must be called with latch_ held. */
+    auto FreeRequest(LockRequestList::Iterator iter) -> LockRequestList::Iterator {
+      LockRequest *request = *iter;
+      auto next = request_queue_.Erase(iter);
+      request->next_ = free_requests_;
+      free_requests_ = request;
+      return next;
+    }
+
+    /** Wake the waiters, skipping the condition variable when nobody waits. Must be called with latch_ held. */
+    void NotifyWaiters() {
+      if (waiters_ > 0) {
+        cv_.notify_all();
+      }
+    }
+
     /** List of lock requests for the same resource (table or row) */
     // 对于相同资源的锁请求。
-    std::list<std::shared_ptr<LockRequest>> request_queue_;
+    LockRequestList request_queue_;
+    /** Requests that left the queue, reused by the next lock on this resource */
+    LockRequest *free_requests_{nullptr};
+    /** Number of threads blocked on cv_ */
+    size_t waiters_{0};
     /** For notifying blocked transactions on this rid */
     // 用于通知此 rid 上的被阻止交易。是一个条件变量。
     std::condition_variable cv_;
@@ -93,20 +219,31 @@ class LockManager {
   };
 
   /**
-   * Creates a new lock manager configured for the deadlock detection policy.
+   * Creates a new lock manager configured for the given deadlock policy. Only DETECTION runs a background thread.
    * 创建为死锁检测策略配置的新锁管理器
+   * @param policy how deadlocks are detected or prevented
    */
-  LockManager() {
-    enable_cycle_detection_ = true;
-    cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+  explicit LockManager(DeadlockPolicy policy = DeadlockPolicy::DETECTION) : policy_(policy) {
+    enable_cycle_detection_ = policy_ == DeadlockPolicy::DETECTION;
+    if (enable_cycle_detection_) {
+      cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
+    }
   }
 
   ~LockManager() {
     enable_cycle_detection_ = false;
-    cycle_detection_thread_->join();
-    delete cycle_detection_thread_;
+    if (cycle_detection_thread_ != nullptr) {
+      cycle_detection_thread_->join();
+      delete cycle_detection_thread_;
+    }
   }
 
+  /** @return the deadlock policy of the lock manager */
+  auto GetDeadlockPolicy() const -> DeadlockPolicy { return policy_; }
+
+  /** @return the counters of lock grants, waits and aborts */
+  auto GetProfiler() -> LockProfiler * { return &profiler_; }
+
   /**
    * [LOCK_NOTE]
    *
@@ -201,15 +338,16 @@ class LockManager {
    *
    * LOCK UPGRADE:
    *    Calling Lock() on a resource that is already locked should have the following behaviour:
-   *    - If requested lock mode is the same as that of the lock presently held,
-   *      Lock() should return true since it already has the lock.
-   *    - If requested lock mode is different, Lock() should upgrade the lock held by the transaction.
+   *    - If requested lock mode is the same as that of the lock presently held, or weaker than it,
+   *      Lock() should return true since it already has the lock. This is answered from the lock sets of the
+   *      transaction without touching the lock table.
+   *    - If requested lock mode is stronger, Lock() should upgrade the lock held by the transaction.
    *
    * 锁升级：
    *    在已锁定的资源上调用 Lock（） 应具有以下行为：
-   *    - 如果请求的锁定模式与当前持有的锁定模式相同，
-   *    Lock（） 应该返回 true，因为它已经有锁了。
-   *    - 如果请求的锁定模式不同，Lock（） 应该升级事务持有的锁。
+   *    - 如果请求的锁定模式与当前持有的锁定模式相同，或者比它弱，
+   *    Lock（） 应该返回 true，因为它已经有锁了。这一步只查事务自己的锁集合，不碰锁表。
+   *    - 如果请求的锁定模式更强，Lock（） 应该升级事务持有的锁。
    *
    *    A lock request being upgraded should be prioritised over other waiting lock requests on the same resource.
    *    正在升级的锁定请求应优先于同一资源上的其他等待锁定请求。
@@ -238,6 +376,33 @@ class LockManager {
    *    lock sets appropriately (check transaction.h)
    * 簿记：
    *    如果向事务授予了锁，锁管理器应适当地更新其锁集（检查 transaction.h）
+   *
+   * LOCK ESCALATION:
+   *    Once a transaction holds Transaction::GetLockEscalationThreshold() row locks of one mode on a table,
+   *    LockRow() tries to trade them for a table lock: S rows turn IS into S and IX into SIX, X rows turn IX and
+   *    SIX into X. The table lock is only upgraded if that can be granted right away; otherwise the row locks are
+   *    kept and escalation is retried after another threshold worth of rows. After escalating, the row locks of
+   *    that table are released without changing the transaction state, and row locks covered by the table lock
+   *    are granted without being queued.
+   *
+   * 锁升级到表：
+   *    事务在一张表上持有的某种行锁达到阈值后，LockRow（）尝试把它们换成表锁：S行锁把IS升级成S、IX升级成SIX，
+   *    X行锁把IX和SIX升级成X。只有表锁能立即授予时才升级，否则保留行锁，再攒够一个阈值的行后重试。
+   *    升级之后释放这张表上的行锁，不改变事务状态；之后被表锁覆盖的行锁直接授予，不进队列。
+   *
+   * NEXT-KEY LOCKING:
+   *    LockKey() locks a key of an index together with the gap between it and the next smaller key, KEY_RANGE_END
+   *    standing for the gap after the largest key. A range scan locks every key it returns plus the first key past
+   *    the range in S, so no key can be inserted into or deleted from the range until it ends. An insert first takes
+   *    X on the key following the new one and releases it right away, which waits out the scans covering that gap,
+   *    then holds X on the new key; a delete holds X on the deleted key. Key locks only come in S and X, are not
+   *    allowed in the SHRINKING state, and unlocking them never changes the transaction state.
+   *
+   * 键范围锁：
+   *    LockKey（）锁住索引上的一个键以及它和前一个更小的键之间的间隙，KEY_RANGE_END表示最大键之后的间隙。
+   *    范围扫描用S锁住返回的每个键和范围之后的第一个键，这样结束之前没人能往范围里插入或者删除键。
+   *    插入先用X锁一下新键的后一个键马上放掉，等覆盖这个间隙的扫描结束，再用X锁住新键直到结束；删除用X锁住删掉的键。
+   *    键锁只有S和X，SHRINKING状态下不能申请，解锁不改变事务状态。
    */
 
   /**
@@ -374,6 +539,30 @@ class LockManager {
    */
   auto UnlockRow(Transaction *txn, const table_oid_t &oid, const RID &rid) -> bool;
 
+  /** The key above every key of an index; locking it locks the gap after the largest key */
+  static constexpr int64_t KEY_RANGE_END = std::numeric_limits<int64_t>::max();
+
+  /**
+   * Acquire a next-key lock on a key of an index in the given lock_mode, upgrading S to X if needed.
+   * See [LOCK_NOTE] in header file.
+   *
+   * @param txn the transaction requesting the lock
+   * @param lock_mode SHARED or EXCLUSIVE
+   * @param index_oid the index the key belongs to
+   * @param key the key, KEY_RANGE_END for the gap after the largest key
+   * @return true if the lock is granted, false if the transaction was aborted
+   */
+  auto LockKey(Transaction *txn, LockMode lock_mode, index_oid_t index_oid, int64_t key) -> bool;
+
+  /**
+   * Release a next-key lock held by the transaction, without changing its state.
+   * @param txn the transaction releasing the lock
+   * @param index_oid the index the key belongs to
+   * @param key the locked key
+   * @return true if the unlock is successful
+   */
+  auto UnlockKey(Transaction *txn, index_oid_t index_oid, int64_t key) -> bool;
+
   /*** Graph API ***/
 
   /**
@@ -418,14 +607,60 @@ class LockManager {
   void ThrowException(txn_id_t id, AbortReason reason, int line);
   void RowLockAllocate(Transaction *txn, LockMode lock_mode, table_oid_t oid, const RID &rid);
   void TableLockAllocate(Transaction *txn, LockMode lock_mode, table_oid_t oid);
+  void KeyLockAllocate(Transaction *txn, LockMode lock_mode, index_oid_t index_oid, int64_t key);
+  void KeyLockRemove(Transaction *txn, LockMode lock_mode, index_oid_t index_oid, int64_t key);
   void SetState(Transaction *txn, IsolationLevel ioslevel, LockMode lock_mode);
   // 检查两者是否兼容。
   auto CheckLock(LockMode lock_mode_, LockMode lock_mode) -> bool;
+  // 事务是否已经持有同样或更强的表锁。
+  auto HoldsTableLock(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool;
+  // 表锁是否已经覆盖了这种模式的行锁。
+  auto TableLockCovers(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool;
+  // 一张表上的行锁太多时，升级成表锁并放掉这些行锁。
+  void EscalateRowLocks(Transaction *txn, LockMode lock_mode, table_oid_t oid);
+  // 不等待地把事务在表上的锁换成更强的模式，不能立即授予就返回false。
+  auto TryUpgradeTableLock(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool;
+  // 从队列里撤掉一个行锁，不改变事务状态。
+  void DropRowLock(Transaction *txn, const RID &rid);
+
+  /** What a blocked request does next */
+  enum class WaitDecision { WAIT, RETRY, DIE };
+  // 找出挡住这个请求的事务。
+  auto CollectBlockers(LockRequestQueue *que, LockRequest *lr) -> std::vector<txn_id_t>;
+  // 等待之前按死锁策略决定是等、重试还是自己退出。可能会临时放掉队列的锁。
+  auto PrepareToWait(LockRequestQueue *que, std::unique_lock<std::mutex> *lock, Transaction *txn, LockRequest *lr)
+      -> WaitDecision;
+  // 不再等待了，把出边和等待的队列都删掉。
+  void StopWaiting(txn_id_t tid);
+  // 从tid出发沿等待边找回到tid的环，跳过已经被杀死的事务。
+  auto FindCycle(txn_id_t tid, std::vector<txn_id_t> *cycle) -> bool;
+  // 杀死一个事务，它要是在等锁就把它叫醒。调用时不能持有任何队列的锁。
+  void Wound(txn_id_t tid);
+  auto IsAborted(txn_id_t tid) -> bool;
+  // 事务的start ts，死锁策略按它判断新老；已经结束的事务算最年轻。
+  static auto StartTs(txn_id_t tid) -> timestamp_t;
 
   // auto GrantLock(std::shared_ptr<LockRequestQueue> &que, LockMode lock_mode, LockRequest *lr, table_oid_t id) ->
   // bool;
-  auto GrantLock(std::shared_ptr<LockRequestQueue> &que, LockMode lock_mode, std::shared_ptr<LockRequest> &lr,
-                 txn_id_t id) -> bool;
+  auto GrantLock(LockRequestQueue *que, LockMode lock_mode, LockRequest *lr, txn_id_t id) -> bool;
+
+  /** log2 of the number of partitions of the row lock table */
+  static constexpr size_t ROW_LOCK_SHARD_BITS = 6;
+  static constexpr size_t ROW_LOCK_SHARD_COUNT = 1 << ROW_LOCK_SHARD_BITS;
+
+  /** One partition of the row lock table, with its own latch */
+  struct RowLockShard {
+    /** Structure that holds lock requests for the RIDs of this shard */
+    std::unordered_map<RID, LockRequestQueue> lock_map_;
+    /** Coordination */
+    std::mutex latch_;
+  };
+
+  /** @return the shard a row lock lives in */
+  auto GetRowLockShard(const RID &rid) -> RowLockShard & {
+    // 斐波那契散列，取高位，同一页上相邻的槽也会分到不同的分片。
+    return row_lock_shards_[(std::hash<RID>()(rid) * 0x9E3779B97F4A7C15ULL) >> (64 - ROW_LOCK_SHARD_BITS)];
+  }
 
   /** Fall 2022 */
   /** Structure that holds lock requests for a given table oid */
@@ -433,18 +668,26 @@ class LockManager {
   /** Coordination */
   std::mutex table_lock_map_latch_;
 
-  /** Structure that holds lock requests for a given RID */
-  std::unordered_map<RID, std::shared_ptr<LockRequestQueue>> row_lock_map_;
+  /** Row lock table, partitioned by RID so that row locks on different shards never contend on a latch */
+  std::array<RowLockShard, ROW_LOCK_SHARD_COUNT> row_lock_shards_;
+
+  /** Next-key lock table, keyed by (index oid, key) */
+  std::map<std::pair<index_oid_t, int64_t>, LockRequestQueue> key_lock_map_;
   /** Coordination */
-  std::mutex row_lock_map_latch_;
+  std::mutex key_lock_map_latch_;
 
+  DeadlockPolicy policy_;
   std::atomic<bool> enable_cycle_detection_;
-  std::thread *cycle_detection_thread_;
+  std::thread *cycle_detection_thread_{nullptr};
 
   /** Waits-for graph representation. */
   // std::unordered_map<txn_id_t, int> tid_count_map_;
   std::map<txn_id_t, std::set<txn_id_t>> waits_for_;
+  /** The queue each blocked transaction waits on, unused under DETECTION */
+  std::unordered_map<txn_id_t, LockRequestQueue *> waiting_on_;
   std::mutex waits_for_latch_;
+
+  LockProfiler profiler_;
 };
 
 }  // namespace bustub
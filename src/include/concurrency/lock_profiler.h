@@ -0,0 +1,170 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_profiler.h
+//
+// Identification: src/include/concurrency/lock_profiler.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <map>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/**
+ * LockProfiler counts what happens in the lock manager, so that hot tables and rows and the transactions blocking
+ * each other can be found while the system runs.
+ *
+ * Per table it counts granted lock requests and upgrades on the table, the same for the rows of the table, waits and
+ * how long the waits took, in a histogram with power-of-two microsecond buckets. Waits on rows count as waits on
+ * their table. Table counters live in a fixed array indexed by oid and are plain relaxed
+ * atomics, so a grant costs no latch; tables past PROFILED_TABLES share one slot. Rows are sampled: one grant in
+ * ROW_SAMPLE_INTERVAL is counted, while every wait on a row is, since waiting is already the slow path. At most
+ * PROFILED_ROWS rows are tracked. It also counts aborts by AbortReason and deadlock victims, and keeps the requests
+ * that are waiting right now together with the transactions blocking them. Next-key locks only show up there and in
+ * the abort and victim counts.
+ */
+class LockProfiler {
+ public:
+  /** Tables with a counter slot of their own */
+  static constexpr size_t PROFILED_TABLES = 256;
+  /** Rows tracked at most */
+  static constexpr size_t PROFILED_ROWS = 4096;
+  /** One row lock grant in this many is counted */
+  static constexpr uint32_t ROW_SAMPLE_INTERVAL = 64;
+  /** Bucket i counts waits shorter than 2^i microseconds, the last bucket all the longer ones */
+  static constexpr size_t WAIT_HISTOGRAM_BUCKETS = 20;
+
+  using Clock = std::chrono::steady_clock;
+
+  /** Counters of one table */
+  struct TableCounters {
+    uint64_t acquisitions_{0};
+    uint64_t upgrades_{0};
+    uint64_t row_acquisitions_{0};
+    uint64_t row_upgrades_{0};
+    uint64_t waits_{0};
+    uint64_t wait_us_{0};
+    std::array<uint64_t, WAIT_HISTOGRAM_BUCKETS> wait_histogram_{};
+  };
+
+  /** Counters of one row; acquisitions are sampled */
+  struct RowCounters {
+    uint64_t sampled_acquisitions_{0};
+    uint64_t waits_{0};
+    uint64_t wait_us_{0};
+  };
+
+  /** A lock request blocked right now */
+  struct Waiter {
+    txn_id_t txn_id_{INVALID_TXN_ID};
+    table_oid_t oid_{0};
+    /** The row waited for, none for a table or key lock */
+    std::optional<RID> rid_;
+    /** The key waited for, in which case oid_ is the oid of the index */
+    std::optional<int64_t> key_;
+    std::string mode_;
+    /** The transactions holding or queued ahead with an incompatible lock */
+    std::vector<txn_id_t> blockers_;
+    Clock::time_point since_;
+  };
+
+  /** Count a granted table lock request */
+  void RecordTableLock(table_oid_t oid, bool upgrade);
+
+  /** Count a granted row lock request on its table; only sampled grants reach the row counters */
+  void RecordRowLock(table_oid_t oid, const RID &rid, bool upgrade);
+
+  /**
+   * Note that a request started or keeps waiting, and who blocks it now.
+   * @param waiter the waiting request; since_ is kept from the first call for the same transaction
+   */
+  void BeginWait(Waiter waiter);
+
+  /** Note that the transaction stopped waiting, granted or not, and count the wait. */
+  void EndWait(txn_id_t txn_id);
+
+  /** Count an abort thrown by the lock manager */
+  void RecordAbort(AbortReason reason);
+
+  /** Count a transaction aborted to break or prevent a deadlock */
+  void RecordDeadlockVictim() { deadlock_victims_.fetch_add(1, std::memory_order_relaxed); }
+
+  /** @return the counters of every table that saw a lock, by oid; PROFILED_TABLES stands for the other tables */
+  auto GetTableCounters() const -> std::map<table_oid_t, TableCounters>;
+
+  /** @return the tracked rows, hottest first: most waits, then most sampled grants */
+  auto GetRowCounters(size_t limit) -> std::vector<std::pair<std::pair<table_oid_t, RID>, RowCounters>>;
+
+  /** @return the number of aborts for the reason */
+  auto GetAborts(AbortReason reason) const -> uint64_t {
+    return aborts_[static_cast<size_t>(reason)].load(std::memory_order_relaxed);
+  }
+
+  /** @return the number of deadlock victims */
+  auto GetDeadlockVictims() const -> uint64_t { return deadlock_victims_.load(std::memory_order_relaxed); }
+
+  /** @return the requests waiting right now, oldest first */
+  auto GetWaiters() -> std::vector<Waiter>;
+
+  /** @return all counters and the current waiters as one JSON object */
+  auto ToJson() -> std::string;
+
+  /** Zero all counters; waits in progress are still tracked */
+  void Reset();
+
+  /** @return the name of an abort reason */
+  static auto AbortReasonName(AbortReason reason) -> const char *;
+
+ private:
+  static constexpr size_t ABORT_REASONS = static_cast<size_t>(AbortReason::ATTEMPTED_UNLOCK_BUT_NO_LOCK_HELD) + 1;
+
+  struct AtomicTableCounters {
+    std::atomic<uint64_t> acquisitions_{0};
+    std::atomic<uint64_t> upgrades_{0};
+    std::atomic<uint64_t> row_acquisitions_{0};
+    std::atomic<uint64_t> row_upgrades_{0};
+    std::atomic<uint64_t> waits_{0};
+    std::atomic<uint64_t> wait_us_{0};
+    std::array<std::atomic<uint64_t>, WAIT_HISTOGRAM_BUCKETS> wait_histogram_{};
+  };
+
+  auto TableSlot(table_oid_t oid) -> AtomicTableCounters & {
+    return tables_[oid < PROFILED_TABLES ? oid : PROFILED_TABLES];
+  }
+
+  /** @return the bucket of a wait of that many microseconds */
+  static auto Bucket(uint64_t wait_us) -> size_t;
+
+  std::array<AtomicTableCounters, PROFILED_TABLES + 1> tables_{};
+  std::array<std::atomic<uint64_t>, ABORT_REASONS> aborts_{};
+  std::atomic<uint64_t> deadlock_victims_{0};
+
+  /** Protects rows_ */
+  std::mutex rows_latch_;
+  std::map<std::pair<table_oid_t, int64_t>, RowCounters> rows_;
+
+  /** Protects waiters_ */
+  std::mutex waiters_latch_;
+  std::map<txn_id_t, Waiter> waiters_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,67 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// next_key_locker.h
+//
+// Identification: src/include/concurrency/next_key_locker.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <optional>
+
+#include "catalog/catalog.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction.h"
+#include "storage/index/b_plus_tree_index.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * NextKeyLocker takes the next-key locks that keep a REPEATABLE_READ transaction free of phantoms when it writes
+ * the keys of an index on one integer column. See [LOCK_NOTE] in lock_manager.h for the protocol.
+ */
+class NextKeyLocker {
+ public:
+  NextKeyLocker(LockManager *lock_mgr, Transaction *txn) : lock_mgr_(lock_mgr), txn_(txn) {}
+
+  /** @return whether the transaction needs key locks: REPEATABLE_READ under two-phase locking */
+  static auto Needed(Transaction *txn) -> bool {
+    return txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ && !txn->IsOptimistic();
+  }
+
+  /** @return the key of a B+ tree entry of an index on one integer column */
+  static auto KeyOf(const IntegerKeyType &key, IndexInfo *index_info) -> int64_t {
+    return key.ToValue(&index_info->key_schema_, 0).GetAs<int32_t>();
+  }
+
+  /**
+   * Lock the gap a new key goes into, waiting for the scans that cover it, then the new key itself.
+   * @return false if the transaction was aborted while waiting
+   */
+  auto LockInsert(IndexInfo *index_info, const Tuple &key) -> bool;
+
+  /**
+   * Lock a key about to be deleted.
+   * @return false if the transaction was aborted while waiting
+   */
+  auto LockDelete(IndexInfo *index_info, const Tuple &key) -> bool;
+
+ private:
+  /** @return the tree of an index on one integer column, nullptr for any other index */
+  static auto TreeOf(IndexInfo *index_info) -> BPlusTreeIndexForOneIntegerColumn *;
+
+  /** @return the smallest key of the tree not less than key, KEY_RANGE_END if there is none */
+  static auto LowerBound(BPlusTreeIndexForOneIntegerColumn *tree, const IntegerKeyType &key, IndexInfo *index_info)
+      -> int64_t;
+
+  LockManager *lock_mgr_;
+  Transaction *txn_;
+};
+
+}  // namespace bustub
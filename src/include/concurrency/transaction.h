@@ -46,8 +46,46 @@ enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
  * Transaction isolation level.
+ *
+ * SNAPSHOT_ISOLATION reads the tables as of the commit timestamp the transaction began at, through the version
+ * store of each table, and takes no lock to read. Its writes still take exclusive locks, and a write to a tuple
+ * committed after its snapshot aborts the transaction (first committer wins).
+ */
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT_ISOLATION };
+
+/**
+ * How a transaction is kept apart from the others.
+ *
+ * TWO_PHASE_LOCKING goes through the LockManager as its isolation level asks. OPTIMISTIC takes no lock while it runs:
+ * it records the version word of every tuple it reads, buffers its writes, and at commit validates that none of the
+ * tuples it read changed before it installs the writes (Silo-style). The isolation level of an optimistic
+ * transaction is ignored. Its statements do not see its own buffered writes, and, like scans under locking, it is
+ * not protected from phantoms.
+ */
+enum class ConcurrencyControl { TWO_PHASE_LOCKING, OPTIMISTIC };
+
+/**
+ * Whether a transaction may write.
+ *
+ * A READ_ONLY transaction allocates no write sets and commits without walking any. It never validates: under
+ * SNAPSHOT_ISOLATION it reads its snapshot without locks, and under READ_UNCOMMITTED it takes no lock at all. Under
+ * READ_COMMITTED and REPEATABLE_READ a scan over the whole table, sequential or through the full index, takes one
+ * SHARED lock on the table instead of an intention lock and a lock per row. Index point and range reads lock as they
+ * would in a read-write transaction: under REPEATABLE_READ, INTENTION_SHARED on the table plus the keys they read. Its
+ * statements may not write.
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class AccessMode { READ_WRITE, READ_ONLY };
+
+/**
+ * When Commit returns, with logging enabled.
+ *
+ * A SYNCHRONOUS commit returns once its commit record is on disk. An ASYNCHRONOUS commit returns as soon as the record
+ * is in the log buffer; the flush thread writes it within async_commit_delay, so a crash loses at most that window of
+ * commits. The log stays a prefix of what happened either way, so recovery never sees a later commit without the
+ * earlier ones. Either way other transactions see the writes only after the commit record is in the log, on disk for a
+ * SYNCHRONOUS commit.
+ */
+enum class CommitMode { SYNCHRONOUS, ASYNCHRONOUS };
 
 /**
  * Type of write operation.
@@ -64,8 +102,8 @@ using index_oid_t = uint32_t;
  */
 class TableWriteRecord {
  public:
-  TableWriteRecord(RID rid, WType wtype, const Tuple &tuple, TableHeap *table)
-      : rid_(rid), wtype_(wtype), tuple_(tuple), table_(table) {}
+  TableWriteRecord(RID rid, WType wtype, const Tuple &tuple, TableHeap *table, uint32_t count = 1)
+      : rid_(rid), wtype_(wtype), tuple_(tuple), table_(table), count_(count) {}
 
   RID rid_;
   WType wtype_;
@@ -73,6 +111,8 @@ class TableWriteRecord {
   Tuple tuple_;
   /** The table heap specifies which table this write record is for. */
   TableHeap *table_;
+  /** For an insert, the number of tuples inserted into consecutive slots of the page, starting at rid_. */
+  uint32_t count_;
 };
 
 /**
@@ -100,6 +140,38 @@ class IndexWriteRecord {
   Catalog *catalog_;
 };
 
+/**
+ * ReadRecord tracks a tuple read by an optimistic transaction.
+ */
+class ReadRecord {
+ public:
+  ReadRecord(RID rid, TableHeap *table, uint64_t version) : rid_(rid), table_(table), version_(version) {}
+
+  RID rid_;
+  TableHeap *table_;
+  /** The version word of the tuple when it was read, without the lock bit. */
+  uint64_t version_;
+};
+
+/**
+ * BufferedWriteRecord tracks a write an optimistic transaction installs only once it validated at commit.
+ */
+class BufferedWriteRecord {
+ public:
+  BufferedWriteRecord(WType wtype, table_oid_t table_oid, RID rid, const Tuple &tuple, Catalog *catalog)
+      : wtype_(wtype), table_oid_(table_oid), rid_(rid), tuple_(tuple), catalog_(catalog) {}
+
+  /** Insert or delete. */
+  WType wtype_;
+  table_oid_t table_oid_;
+  /** The tuple to delete, unused for an insert. */
+  RID rid_;
+  /** The tuple to insert, or the deleted tuple, which its index keys are built from. */
+  Tuple tuple_;
+  /** The catalog contains metadata required to locate the table and its indexes. */
+  Catalog *catalog_;
+};
+
 /**
  * Reason to a transaction abortion
  */
@@ -158,8 +230,12 @@ class TransactionAbortException : public std::exception {
  */
 class Transaction {
  public:
-  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
+  explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+                       ConcurrencyControl concurrency_control = ConcurrencyControl::TWO_PHASE_LOCKING,
+                       AccessMode access_mode = AccessMode::READ_WRITE)
       : isolation_level_(isolation_level),
+        concurrency_control_(concurrency_control),
+        access_mode_(access_mode),
         thread_id_(std::this_thread::get_id()),
         txn_id_(txn_id),
         prev_lsn_(INVALID_LSN),
@@ -171,10 +247,16 @@ class Transaction {
         ix_table_lock_set_{new std::unordered_set<table_oid_t>},
         six_table_lock_set_{new std::unordered_set<table_oid_t>},
         s_row_lock_set_{new std::unordered_map<table_oid_t, std::unordered_set<RID>>},
-        x_row_lock_set_{new std::unordered_map<table_oid_t, std::unordered_set<RID>>} {
-    // Initialize the sets that will be tracked.
-    table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
-    index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
+        x_row_lock_set_{new std::unordered_map<table_oid_t, std::unordered_set<RID>>},
+        s_key_lock_set_{new std::unordered_map<index_oid_t, std::unordered_set<int64_t>>},
+        x_key_lock_set_{new std::unordered_map<index_oid_t, std::unordered_set<int64_t>>} {
+    // Initialize the sets that will be tracked. A read-only transaction has nothing to undo, validate or install.
+    if (!IsReadOnly()) {
+      table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
+      index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
+      read_set_ = std::make_shared<std::deque<ReadRecord>>();
+      buffered_write_set_ = std::make_shared<std::deque<BufferedWriteRecord>>();
+    }
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
   }
@@ -192,12 +274,52 @@ class Transaction {
   /** @return the isolation level of this transaction */
   inline auto GetIsolationLevel() const -> IsolationLevel { return isolation_level_; }
 
-  /** @return the list of table write records of this transaction */
+  /** @return how this transaction is kept apart from the others */
+  inline auto GetConcurrencyControl() const -> ConcurrencyControl { return concurrency_control_; }
+
+  /** @return whether this transaction may write */
+  inline auto GetAccessMode() const -> AccessMode { return access_mode_; }
+
+  /** @return whether Commit waits for the commit record to reach disk */
+  inline auto GetCommitMode() const -> CommitMode { return commit_mode_; }
+
+  /** @param commit_mode whether Commit should wait for the commit record to reach disk */
+  inline void SetCommitMode(CommitMode commit_mode) { commit_mode_ = commit_mode; }
+
+  /** @return whether this transaction was declared read-only */
+  inline auto IsReadOnly() const -> bool { return access_mode_ == AccessMode::READ_ONLY; }
+
+  /** @return whether this transaction runs optimistically, without locks; a read-only one never does */
+  inline auto IsOptimistic() const -> bool {
+    return concurrency_control_ == ConcurrencyControl::OPTIMISTIC && !IsReadOnly();
+  }
+
+  /**
+   * @return whether this read-only transaction locks the whole table in SHARED mode for a full scan instead of rows and
+   * keys; index range and point reads still take the intention lock and lock only what they read
+   */
+  inline auto LocksWholeTables() const -> bool {
+    return IsReadOnly() &&
+           (isolation_level_ == IsolationLevel::READ_COMMITTED || isolation_level_ == IsolationLevel::REPEATABLE_READ);
+  }
+
+  /** @return whether this transaction reads its snapshot through the version store */
+  inline auto ReadsSnapshot() const -> bool {
+    return isolation_level_ == IsolationLevel::SNAPSHOT_ISOLATION && !IsOptimistic();
+  }
+
+  /** @return the list of table write records of this transaction, nullptr if it is read-only */
   inline auto GetWriteSet() -> std::shared_ptr<std::deque<TableWriteRecord>> { return table_write_set_; }
 
-  /** @return the list of index write records of this transaction */
+  /** @return the list of index write records of this transaction, nullptr if it is read-only */
   inline auto GetIndexWriteSet() -> std::shared_ptr<std::deque<IndexWriteRecord>> { return index_write_set_; }
 
+  /** @return the tuples an optimistic transaction read, validated at commit */
+  inline auto GetReadSet() -> std::shared_ptr<std::deque<ReadRecord>> { return read_set_; }
+
+  /** @return the writes an optimistic transaction installs at commit */
+  inline auto GetBufferedWriteSet() -> std::shared_ptr<std::deque<BufferedWriteRecord>> { return buffered_write_set_; }
+
   /** @return the page set */
   inline auto GetPageSet() -> std::shared_ptr<std::deque<Page *>> { return page_set_; }
 
@@ -301,6 +423,35 @@ class Transaction {
     return six_table_lock_set_->find(oid) != six_table_lock_set_->end();
   }
 
+  /** @return the index keys under a shared next-key lock */
+  inline auto GetSharedKeyLockSet() -> std::shared_ptr<std::unordered_map<index_oid_t, std::unordered_set<int64_t>>> {
+    return s_key_lock_set_;
+  }
+
+  /** @return the index keys under an exclusive next-key lock */
+  inline auto GetExclusiveKeyLockSet()
+      -> std::shared_ptr<std::unordered_map<index_oid_t, std::unordered_set<int64_t>>> {
+    return x_key_lock_set_;
+  }
+
+  /** @return true if the key (and the gap below it) of index index_oid is shared locked by this transaction */
+  auto IsKeySharedLocked(index_oid_t index_oid, int64_t key) -> bool {
+    auto key_lock_set = s_key_lock_set_->find(index_oid);
+    return key_lock_set != s_key_lock_set_->end() && key_lock_set->second.count(key) > 0;
+  }
+
+  /** @return true if the key (and the gap below it) of index index_oid is exclusive locked by this transaction */
+  auto IsKeyExclusiveLocked(index_oid_t index_oid, int64_t key) -> bool {
+    auto key_lock_set = x_key_lock_set_->find(index_oid);
+    return key_lock_set != x_key_lock_set_->end() && key_lock_set->second.count(key) > 0;
+  }
+
+  /** @return true if the row locks of the table have been escalated to a table lock */
+  auto IsTableEscalated(const table_oid_t &oid) -> bool { return escalated_table_set_.count(oid) > 0; }
+
+  /** @return the tables whose row locks have been escalated to a table lock */
+  inline auto GetEscalatedTableSet() -> std::unordered_set<table_oid_t> * { return &escalated_table_set_; }
+
   /** @return the current state of the transaction */
   inline auto GetState() -> TransactionState { return state_; }
 
@@ -323,11 +474,38 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return the number of row locks the transaction may hold on one table before they are escalated */
+  inline auto GetLockEscalationThreshold() const -> size_t { return lock_escalation_threshold_; }
+
+  /**
+   * Set the lock escalation threshold of the transaction.
+   * @param threshold row locks per table before escalating to a table lock, 0 to never escalate
+   */
+  inline void SetLockEscalationThreshold(size_t threshold) { lock_escalation_threshold_ = threshold; }
+
+  /** @return the snapshot of a SNAPSHOT_ISOLATION transaction: it sees what was committed at or before it */
+  inline auto GetReadTs() const -> timestamp_t { return read_ts_; }
+
+  /** @param read_ts the snapshot of the transaction */
+  inline void SetReadTs(timestamp_t read_ts) { read_ts_ = read_ts; }
+
+  /** @return when the transaction began: a smaller start timestamp is an older transaction */
+  inline auto GetStartTs() const -> timestamp_t { return start_ts_; }
+
+  /** @param start_ts the position of the transaction in the order transactions began */
+  inline void SetStartTs(timestamp_t start_ts) { start_ts_ = start_ts; }
+
  private:
   /** The current transaction state. */
   TransactionState state_{TransactionState::GROWING};
   /** The isolation level of the transaction. */
   IsolationLevel isolation_level_;
+  /** Locking or optimistic. */
+  ConcurrencyControl concurrency_control_;
+  /** Read-write or read-only. */
+  AccessMode access_mode_;
+  /** Whether Commit waits for the log. */
+  CommitMode commit_mode_{CommitMode::SYNCHRONOUS};
   /** The thread ID, used in single-threaded transactions. */
   std::thread::id thread_id_;
   /** The ID of this transaction. */
@@ -337,8 +515,18 @@ class Transaction {
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
   /** The undo set of indexes. */
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
-  /** The LSN of the last record written by the transaction. */
-  lsn_t prev_lsn_;
+  /** Optimistic concurrency control: the tuples read. */
+  std::shared_ptr<std::deque<ReadRecord>> read_set_;
+  /** Optimistic concurrency control: the writes not installed yet. */
+  std::shared_ptr<std::deque<BufferedWriteRecord>> buffered_write_set_;
+  /** The LSN of the last record written by the transaction. Checkpoints read it while the transaction runs. */
+  std::atomic<lsn_t> prev_lsn_;
+  /** Row locks per table after which the lock manager escalates to a table lock. */
+  size_t lock_escalation_threshold_{LOCK_ESCALATION_THRESHOLD};
+  /** Commit timestamp of the snapshot the transaction reads. */
+  timestamp_t read_ts_{0};
+  /** Order of the transaction among the ones begun by its transaction manager, set by TransactionManager::Begin. */
+  timestamp_t start_ts_{0};
 
   std::mutex latch_;
 
@@ -362,6 +550,11 @@ class Transaction {
   /** LockManager: the set of row locks held by this transaction. */
   std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> s_row_lock_set_;
   std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> x_row_lock_set_;
+  /** LockManager: the set of next-key locks held by this transaction, per index. */
+  std::shared_ptr<std::unordered_map<index_oid_t, std::unordered_set<int64_t>>> s_key_lock_set_;
+  std::shared_ptr<std::unordered_map<index_oid_t, std::unordered_set<int64_t>>> x_key_lock_set_;
+  /** Tables whose row locks were escalated to a table lock. */
+  std::unordered_set<table_oid_t> escalated_table_set_;
 };
 
 }  // namespace bustub
@@ -12,14 +12,22 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <set>
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/transaction_registry.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
@@ -27,6 +35,10 @@ class LockManager;
 
 /**
  * TransactionManager keeps track of all the transactions running in the system.
+ *
+ * It also hands out commit timestamps. A SNAPSHOT_ISOLATION transaction reads as of the last commit timestamp when it
+ * began; while it runs, committing writers keep the versions it may still need in the version store of each table,
+ * and a committing writer garbage collects the versions older than the oldest active snapshot.
  */
 class TransactionManager {
  public:
@@ -39,16 +51,22 @@ class TransactionManager {
    * Begins a new transaction.
    * @param txn an optional transaction object to be initialized, otherwise a new transaction is created.
    * @param isolation_level an optional isolation level of the transaction.
+   * @param concurrency_control whether the transaction locks or runs optimistically
+   * @param access_mode whether the transaction may write
    * @return an initialized transaction
    */
-  auto Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
-      -> Transaction *;
+  auto Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ,
+             ConcurrencyControl concurrency_control = ConcurrencyControl::TWO_PHASE_LOCKING,
+             AccessMode access_mode = AccessMode::READ_WRITE) -> Transaction *;
 
   /**
-   * Commits a transaction.
+   * Commits a transaction. An optimistic transaction is validated first, and only installs its buffered writes if
+   * none of the tuples it read changed; otherwise it is aborted instead. A read-only transaction only gives up its
+   * snapshot and its locks.
    * @param txn the transaction to commit
+   * @return false if the transaction failed validation and was aborted
    */
-  void Commit(Transaction *txn);
+  auto Commit(Transaction *txn) -> bool;
 
   /**
    * Aborts a transaction
@@ -60,37 +78,60 @@ class TransactionManager {
    * Global list of running transactions
    */
 
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
-  static std::shared_mutex txn_map_mutex;
+  /** The transaction registry maps the id of every running transaction in the system to the transaction. */
+  static TransactionRegistry txn_registry;
 
   /**
    * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
-   * @return the transaction with the given transaction id
+   * @param txn_id the id of the transaction to be found
+   * @return the transaction with the given transaction id, nullptr if it already committed or aborted
    */
-  static auto GetTransaction(txn_id_t txn_id) -> Transaction * {
-    std::shared_lock<std::shared_mutex> l(TransactionManager::txn_map_mutex);
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    return res;
-  }
+  static auto GetTransaction(txn_id_t txn_id) -> Transaction * { return txn_registry.Find(txn_id); }
+
+  /** @return the read timestamp of the oldest active snapshot, or the last commit timestamp if there is none */
+  auto GetOldestSnapshot() -> timestamp_t;
 
-  /** Prevents all transactions from performing operations, used for checkpointing. */
+  /**
+   * Garbage collect the versions of a table. The deletes left marked for older snapshots are applied and logged
+   * under a system transaction of their own, which recovery treats like any other transaction.
+   * @param table the table to collect
+   * @param oldest the read timestamp of the oldest active snapshot
+   */
+  void CollectVersions(TableHeap *table, timestamp_t oldest);
+
+  /**
+   * The active transaction table of a fuzzy checkpoint.
+   * @return the id and last LSN of every running transaction that wrote to the log
+   */
+  static auto GetActiveTransactions() -> std::vector<std::pair<txn_id_t, lsn_t>>;
+
+  /** Prevents all transactions from performing operations, for a checkpoint that has to be consistent. */
   void BlockAllTransactions();
 
-  /** Resumes all transactions, used for checkpointing. */
+  /** Resumes all transactions blocked by BlockAllTransactions(). */
   void ResumeTransactions();
 
+  /** Number of counters running transactions are spread over, see EnterGate() */
+  static constexpr size_t GATE_STRIPES = 16;
+
  private:
   /**
    * Releases all the locks held by the given transaction.
    * @param txn the transaction whose locks should be released
    */
   void ReleaseLocks(Transaction *txn) {
-    /** Drop all row locks */
+    /** Drop all next-key locks */
     txn->LockTxn();
+    std::vector<std::pair<index_oid_t, int64_t>> key_lock_set;
+    for (const auto &key_locks : {txn->GetSharedKeyLockSet(), txn->GetExclusiveKeyLockSet()}) {
+      for (const auto &[index_oid, keys] : *key_locks) {
+        for (auto key : keys) {
+          key_lock_set.emplace_back(index_oid, key);
+        }
+      }
+    }
+
+    /** Drop all row locks */
     std::unordered_map<table_oid_t, std::unordered_set<RID>> row_lock_set;
     for (const auto &s_row_lock_set : *txn->GetSharedRowLockSet()) {
       for (auto rid : s_row_lock_set.second) {
@@ -122,6 +163,10 @@ class TransactionManager {
     }
     txn->UnlockTxn();
 
+    for (const auto &[index_oid, key] : key_lock_set) {
+      lock_manager_->UnlockKey(txn, index_oid, key);
+    }
+
     for (const auto &locked_table_row_set : row_lock_set) {
       table_oid_t oid = locked_table_row_set.first;
       for (auto rid : locked_table_row_set.second) {
@@ -134,12 +179,67 @@ class TransactionManager {
     }
   }
 
+  /**
+   * Commit phase of an optimistic transaction: take the locks a locking writer would hold, lock the version words of
+   * the tuples it deletes, check that the tuples it read did not change, and install its buffered writes. The installed
+   * table and index writes go to the write sets, so an abort undoes them.
+   * @param txn the optimistic transaction
+   * @param[out] locked_words the version words locked, to be released once the commit or the abort is done
+   * @return false if the transaction has to abort
+   */
+  auto ValidateAndInstall(Transaction *txn, std::vector<std::pair<TableHeap *, RID>> *locked_words) -> bool;
+
+  /** Stop registering the transaction as running, once it committed or aborted */
+  void Finish(Transaction *txn);
+
+  /** Release the version words an optimistic transaction locked */
+  void UnlockWords(const std::vector<std::pair<TableHeap *, RID>> &locked_words);
+
+  /** Note the tables a write set is about to bump version words in, so the words can be cleared later */
+  void RememberWordTables(const std::deque<TableWriteRecord> &write_set);
+
+  /** Wait until no checkpoint blocks transactions, then count the transaction as running. */
+  void EnterGate(txn_id_t txn_id);
+
+  /** Stop counting the transaction as running. */
+  void LeaveGate(txn_id_t txn_id);
+
+  /** Hands out the next transaction id, see TXN_ID_BATCH_SIZE */
+  auto NextTxnId() -> txn_id_t;
+
   std::atomic<txn_id_t> next_txn_id_{0};
+  /** Start timestamp of the next transaction. Ids are taken in batches, so only this follows the order of Begin. */
+  std::atomic<timestamp_t> next_start_ts_{0};
+  /** Tells this transaction manager apart from the ones before it in the id batches cached by threads */
+  const uint64_t generation_{next_generation.fetch_add(1)};
+  static std::atomic<uint64_t> next_generation;
   LockManager *lock_manager_ __attribute__((__unused__));
   LogManager *log_manager_ __attribute__((__unused__));
 
-  /** The global transaction latch is used for checkpointing. */
-  ReaderWriterLatch global_txn_latch_;
+  /** Running transactions, counted on the stripe of their id so that Begin and Commit do not share a cache line */
+  struct alignas(64) GateStripe {
+    std::atomic<int64_t> running_{0};
+  };
+  std::array<GateStripe, GATE_STRIPES> gate_stripes_{};
+  /** Set while a checkpoint blocks transactions */
+  std::atomic<bool> gate_blocked_{false};
+  /** Protects the waits on the gate */
+  std::mutex gate_latch_;
+  std::condition_variable gate_cv_;
+
+  /** Guards the two below */
+  std::mutex words_latch_;
+  /** Running optimistic transactions; the version words are cleared whenever a writer finishes while there is none */
+  int64_t optimistic_txns_{0};
+  /** Tables that may hold version words */
+  std::unordered_set<TableHeap *> word_tables_;
+
+  /** Serializes handing out commit timestamps with taking snapshots */
+  std::mutex commit_latch_;
+  /** The timestamp of the last commit */
+  timestamp_t last_commit_ts_{0};
+  /** Read timestamps of the active SNAPSHOT_ISOLATION transactions */
+  std::multiset<timestamp_t> active_snapshots_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,111 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.h
+//
+// Identification: src/include/concurrency/transaction_registry.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+class Transaction;
+
+/**
+ * TransactionRegistry maps the id of every running transaction to the transaction, without a global latch.
+ *
+ * Transaction ids are dense, so the registry is a directory of fixed-size segments indexed by the id, and every slot
+ * is an atomic pointer: registering, unregistering and looking up a transaction are a few atomic operations on the
+ * slot of its id. A segment is allocated when the first id in it is registered, and retired once every id in it has
+ * been issued and every transaction in it has finished. Ids are counted when they are issued rather than when they
+ * are registered, so ids a thread took but never used do not keep a segment alive.
+ *
+ * Lookups may still be reading a segment while it is being retired, so retired segments are reclaimed by epochs: every
+ * access runs inside an epoch, and a segment is only freed after every access that started before it was retired has
+ * left its epoch.
+ */
+class TransactionRegistry {
+ public:
+  TransactionRegistry() = default;
+  ~TransactionRegistry();
+
+  DISALLOW_COPY_AND_MOVE(TransactionRegistry);
+
+  /** Register a transaction under its id, replacing whatever a finished transaction left there. */
+  void Insert(Transaction *txn);
+
+  /** Unregister a transaction. Does nothing if another transaction took its id since. */
+  void Remove(Transaction *txn);
+
+  /** Count the ids [first, first + count) as handed out; they are registered later, or never. */
+  void Issue(txn_id_t first, size_t count);
+
+  /** @return the running transaction with the given id, nullptr if there is none */
+  auto Find(txn_id_t txn_id) -> Transaction *;
+
+  /** Call fn on every registered transaction. Transactions registered or unregistered meanwhile may be missed. */
+  void ForEach(const std::function<void(Transaction *)> &fn);
+
+ private:
+  static constexpr size_t SEGMENT_BITS = 14;
+  static constexpr size_t SEGMENT_SIZE = 1UL << SEGMENT_BITS;
+  static constexpr size_t DIRECTORY_SIZE = (1UL << 31) >> SEGMENT_BITS;
+  /** Value of Segment::live_ once the segment is retired; it takes no more transactions */
+  static constexpr int64_t RETIRED = -1;
+
+  struct Segment {
+    std::array<std::atomic<Transaction *>, SEGMENT_SIZE> slots_{};
+    /** Transactions registered in the segment, or RETIRED */
+    std::atomic<int64_t> live_{0};
+  };
+
+  /** Count one more transaction in the segment. @return false if the segment is retired */
+  static auto Acquire(Segment *segment) -> bool;
+
+  /** Count one transaction less in the segment, and retire it if all its ids were issued and it is empty. */
+  void Release(size_t dir, Segment *segment);
+
+  /** Retire the segment in the directory entry if no transaction is registered in it. */
+  void TryRetire(size_t dir, Segment *segment);
+
+  /** @return the epoch the caller entered */
+  auto EnterEpoch() -> uint64_t;
+  void ExitEpoch(uint64_t epoch);
+
+  /** Hand a segment no longer reachable from the directory over to epoch reclamation. */
+  void Retire(Segment *segment);
+
+  std::array<std::atomic<Segment *>, DIRECTORY_SIZE> directory_{};
+  /**
+   * Ids issued in the range of every directory entry. Kept outside the segments, so that a segment allocated again
+   * for an id issued before its range was retired is still known to be complete.
+   */
+  std::array<std::atomic<size_t>, DIRECTORY_SIZE> issued_{};
+
+  /** The current epoch */
+  std::atomic<uint64_t> epoch_{0};
+  /** Accesses in progress, by the parity of the epoch they entered */
+  std::array<std::atomic<int64_t>, 2> readers_{};
+  /** Protects retired_ */
+  std::mutex retire_latch_;
+  /** Retired segments, with the epoch they were retired in */
+  std::vector<std::pair<uint64_t, Segment *>> retired_;
+};
+
+}  // namespace bustub
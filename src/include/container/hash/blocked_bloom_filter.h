@@ -0,0 +1,124 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// blocked_bloom_filter.h
+//
+// Identification: src/include/container/hash/blocked_bloom_filter.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "common/util/hash_util.h"
+#include "type/value.h"
+
+namespace bustub {
+
+/**
+ * BlockedBloomFilter is a register-blocked Bloom filter: every key maps to a single 64-bit word and sets
+ * PROBES_PER_KEY bits inside it, so an insert or a probe touches exactly one word. It trades a slightly higher false
+ * positive rate for one memory access per probe. There are no false negatives.
+ */
+class BlockedBloomFilter {
+ public:
+  /** Filter bits reserved per expected key */
+  static constexpr size_t BITS_PER_KEY = 16;
+  /** Bits set inside the word of each key */
+  static constexpr size_t PROBES_PER_KEY = 4;
+
+  /**
+   * Construct an empty filter.
+   * @param expected_keys the number of keys that will be inserted, used to size the filter
+   */
+  explicit BlockedBloomFilter(size_t expected_keys = 0) { Reset(expected_keys); }
+
+  /**
+   * Clear the filter and resize it for a new set of keys.
+   * @param expected_keys the number of keys that will be inserted
+   */
+  void Reset(size_t expected_keys) {
+    size_t words = 1;
+    while (words * 64 < expected_keys * BITS_PER_KEY) {
+      words <<= 1;
+    }
+    words_.assign(words, 0);
+  }
+
+  /**
+   * Hash a key for the filter. HashUtil::HashValue folds integers into far fewer distinct hashes than there are
+   * keys, which would show up directly as false positives, so numeric keys are hashed from their value instead.
+   * Keys that CompareEquals treats as equal must hash alike, so integer types of any width and decimals holding a
+   * whole number all hash as the same integer.
+   * @return the hash of the key
+   */
+  static auto HashKey(const Value &key) -> hash_t {
+    switch (key.GetTypeId()) {
+      case TypeId::TINYINT:
+        return Mix(static_cast<uint64_t>(key.GetAs<int8_t>()));
+      case TypeId::SMALLINT:
+        return Mix(static_cast<uint64_t>(key.GetAs<int16_t>()));
+      case TypeId::INTEGER:
+        return Mix(static_cast<uint64_t>(key.GetAs<int32_t>()));
+      case TypeId::BIGINT:
+        return Mix(static_cast<uint64_t>(key.GetAs<int64_t>()));
+      case TypeId::DECIMAL: {
+        auto d = key.GetAs<double>();
+        // 2^63能精确表示成double，这个范围检查本身不会舍入。
+        if (d == std::trunc(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0) {
+          return Mix(static_cast<uint64_t>(static_cast<int64_t>(d)));
+        }
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return Mix(bits);
+      }
+      default:
+        return Mix(HashUtil::HashValue(&key));
+    }
+  }
+
+  /** Add a key, given by its HashKey, to the filter */
+  void Insert(hash_t hash) { words_[WordIndex(hash)] |= WordMask(hash); }
+
+  /** @return `false` if the key, given by its HashKey, was definitely never inserted, `true` if it may have been */
+  auto MayContain(hash_t hash) const -> bool {
+    auto mask = WordMask(hash);
+    return (words_[WordIndex(hash)] & mask) == mask;
+  }
+
+  /** @return the size of the filter in bytes */
+  auto SizeInBytes() const -> size_t { return words_.size() * sizeof(uint64_t); }
+
+ private:
+  /** murmur3 fmix64 finalizer */
+  static auto Mix(uint64_t h) -> uint64_t {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  /** The word is picked by the high half of the hash, the bits inside it by the low half */
+  auto WordIndex(uint64_t h) const -> size_t { return (h >> 32) & (words_.size() - 1); }
+
+  static auto WordMask(uint64_t h) -> uint64_t {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < PROBES_PER_KEY; i++) {
+      mask |= uint64_t{1} << ((h >> (i * 6)) & 63);
+    }
+    return mask;
+  }
+
+  std::vector<uint64_t> words_;
+};
+
+}  // namespace bustub
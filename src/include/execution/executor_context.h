@@ -17,6 +17,7 @@
 #include <vector>
 
 #include "catalog/catalog.h"
+#include "common/config.h"
 #include "concurrency/transaction.h"
 #include "storage/page/tmp_tuple_page.h"
 
@@ -60,6 +61,12 @@ class ExecutorContext {
   /** @return the transaction manager */
   auto GetTransactionManager() -> TransactionManager * { return txn_mgr_; }
 
+  /** @return the bytes an aggregation may use for its hash table before it spills */
+  auto GetAggregationMemoryBudget() const -> size_t { return aggregation_memory_budget_; }
+
+  /** Set the memory budget of the aggregations run in this context. */
+  void SetAggregationMemoryBudget(size_t budget) { aggregation_memory_budget_ = budget; }
+
  private:
   /** The transaction context associated with this executor context */
   Transaction *transaction_;
@@ -71,6 +78,8 @@ class ExecutorContext {
   TransactionManager *txn_mgr_;
   /** The lock manager associated with this executor context */
   LockManager *lock_mgr_;
+  /** The memory budget of the aggregations, aggregation_memory_budget unless the session lowered it */
+  size_t aggregation_memory_budget_{aggregation_memory_budget};
 };
 
 }  // namespace bustub
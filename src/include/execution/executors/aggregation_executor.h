@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <utility>
@@ -23,6 +24,7 @@
 #include "execution/executors/abstract_executor.h"
 #include "execution/expressions/abstract_expression.h"
 #include "execution/plans/aggregation_plan.h"
+#include "storage/page/tmp_tuple_page.h"
 #include "storage/table/tuple.h"
 #include "type/value_factory.h"
 
@@ -144,6 +146,12 @@ class SimpleAggregationHashTable {
    */
   void Clear() { ht_.clear(); }
 
+  /** @return The number of groups currently held in the hash table */
+  auto Size() const -> size_t { return ht_.size(); }
+
+  /** @return `true` if the group identified by agg_key is already in the hash table */
+  auto Contains(const AggregateKey &agg_key) const -> bool { return ht_.count(agg_key) != 0; }
+
   /** An iterator over the aggregation hash table */
   class Iterator {
    public:
@@ -203,6 +211,9 @@ class AggregationExecutor : public AbstractExecutor {
   AggregationExecutor(ExecutorContext *exec_ctx, const AggregationPlanNode *plan,
                       std::unique_ptr<AbstractExecutor> &&child);
 
+  /** Release the temporary pages of partitions that were never read back. */
+  ~AggregationExecutor() override;
+
   /** Initialize the aggregation */
   void Init() override;
 
@@ -239,6 +250,34 @@ class AggregationExecutor : public AbstractExecutor {
     return {vals};
   }
 
+  /** A run of temporary pages holding the raw input of groups that did not fit in memory. */
+  struct SpillPartition {
+    /** Pages written so far, in order */
+    std::vector<page_id_t> pages_;
+    /** The page currently being written, still pinned (nullptr if none) */
+    TmpTuplePage *current_{nullptr};
+    /** Recursion depth the partition was produced at, used to re-hash it differently */
+    size_t level_{0};
+  };
+
+  /** Combine one input row into the hash table, spilling it when the budget is exhausted. */
+  void Accumulate(const AggregateKey &key, const AggregateValue &val);
+
+  /** Append one input row to the partition selected by the hash of its key. */
+  void Spill(const AggregateKey &key, const AggregateValue &val);
+
+  /** Start a pass over the input at the given recursion level. */
+  void BeginPass(size_t level);
+
+  /** Finish the current pass: unpin written pages and queue the non-empty partitions. */
+  void EndPass();
+
+  /** Rebuild the hash table from the next pending partition. */
+  void LoadPartition();
+
+  /** Unpin and delete every page owned by the given partition. */
+  void DropPartition(SpillPartition *partition);
+
  private:
   /** The aggregation plan node */
   const AggregationPlanNode *plan_;
@@ -249,5 +288,15 @@ class AggregationExecutor : public AbstractExecutor {
   /** Simple aggregation hash table iterator */
   SimpleAggregationHashTable::Iterator aht_iterator_;
   bool finished_{false};
+  /** Groups the hash table may hold before new groups are spilled */
+  size_t max_groups_{0};
+  /** Recursion level of the pass being built */
+  size_t level_{0};
+  /** Partitions being written by the current pass */
+  std::vector<SpillPartition> writers_;
+  /** Partitions waiting to be aggregated */
+  std::deque<SpillPartition> pending_;
+  /** Layout of a spilled row: group-by values followed by aggregate inputs */
+  std::unique_ptr<Schema> spill_schema_;
 };
 }  // namespace bustub
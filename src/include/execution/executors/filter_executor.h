@@ -51,6 +51,9 @@ class FilterExecutor : public AbstractExecutor {
   /** @return The output schema for the filter plan */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); }
 
+  /** @return The child executor from which tuples are obtained */
+  auto GetChildExecutor() const -> AbstractExecutor * { return child_executor_.get(); }
+
  private:
   /** The filter plan node to be executed */
   const FilterPlanNode *plan_;
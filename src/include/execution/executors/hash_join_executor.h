@@ -13,8 +13,11 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "container/hash/blocked_bloom_filter.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/hash_join_plan.h"
@@ -22,8 +25,40 @@
 
 namespace bustub {
 
+/** HashJoinKey represents a join key in the hash table of a hash join */
+struct HashJoinKey {
+  /** The join key value */
+  Value key_;
+
+  /**
+   * Compares two join keys for equality.
+   * @param other the other join key to be compared with
+   * @return `true` if both join keys are equal, `false` otherwise
+   */
+  auto operator==(const HashJoinKey &other) const -> bool { return key_.CompareEquals(other.key_) == CmpBool::CmpTrue; }
+};
+
+}  // namespace bustub
+
+namespace std {
+
+/** Implements std::hash on HashJoinKey */
+template <>
+struct hash<bustub::HashJoinKey> {
+  auto operator()(const bustub::HashJoinKey &join_key) const -> std::size_t {
+    return bustub::BlockedBloomFilter::HashKey(join_key.key_);
+  }
+};
+
+}  // namespace std
+
+namespace bustub {
+
 /**
- * HashJoinExecutor executes a nested-loop JOIN on two tables.
+ * HashJoinExecutor executes a hash JOIN on two tables. The right side is the build side and the left side probes it,
+ * so the output keeps the order a nested loop join would produce. For an inner join, a Bloom filter over the build
+ * keys is pushed down into the sequential scan feeding the probe side, which then drops tuples that cannot match
+ * before they travel up the pipeline.
  */
 class HashJoinExecutor : public AbstractExecutor {
  public:
@@ -52,8 +87,27 @@ class HashJoinExecutor : public AbstractExecutor {
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
 
  private:
-  /** The NestedLoopJoin plan node to be executed. */
+  /** Hand the Bloom filter to the sequential scan under the probe side, if there is one */
+  void PushDownBloomFilter();
+
+  /** The HashJoin plan node to be executed. */
   const HashJoinPlanNode *plan_;
+  /** The probe side */
+  std::unique_ptr<AbstractExecutor> left_child_;
+  /** The build side */
+  std::unique_ptr<AbstractExecutor> right_child_;
+  /** Build tuples grouped by join key, in build order */
+  std::unordered_map<HashJoinKey, std::vector<Tuple>> hash_table_;
+  /** Bloom filter over the build keys */
+  BlockedBloomFilter bloom_filter_;
+  /** The probe tuple being joined */
+  Tuple left_tuple_;
+  /** Build tuples matching left_tuple_, nullptr if there are none */
+  const std::vector<Tuple> *matches_{nullptr};
+  /** Next position in matches_ */
+  size_t cursor_{0};
+  /** All-null right side, padded onto unmatched left tuples of a left join */
+  Tuple null_right_tuple_;
 };
 
 }  // namespace bustub
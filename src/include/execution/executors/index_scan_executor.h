@@ -42,9 +42,22 @@ class IndexScanExecutor : public AbstractExecutor {
   auto Next(Tuple *tuple, RID *rid) -> bool override;
 
  private:
+  /**
+   * Read the entries of a range scan, without waiting for any lock.
+   * @param[out] keys the keys in the range, in order
+   * @param[out] rids the rids of those keys
+   * @return the first key above the range, KEY_RANGE_END if there is none
+   */
+  static auto CollectRange(BPlusTreeIndexForOneIntegerColumn *tree, IndexInfo *index_info,
+                           const IntegerKeyType &lower_key, int64_t upper, std::vector<int64_t> *keys,
+                           std::vector<RID> *rids) -> int64_t;
+
   /** The index scan plan node to be executed. */
   const IndexScanPlanNode *plan_;
   BPlusTreeIndexIteratorForOneIntegerColumn iter_;
   TableInfo *table_info_{nullptr};
+  /** A range scan collects its rids up front, so neither a delete above it nor a lock wait moves an iterator */
+  std::vector<RID> range_rids_;
+  size_t range_cursor_{0};
 };
 }  // namespace bustub
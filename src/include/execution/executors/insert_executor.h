@@ -14,11 +14,13 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
+#include "catalog/catalog.h"
 #include "execution/plans/insert_plan.h"
 #include "storage/table/tuple.h"
 
@@ -60,12 +62,25 @@ class InsertExecutor : public AbstractExecutor {
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
 
  private:
+  /**
+   * Insert the buffered tuples, lock the new rows and add their index entries.
+   * @param tuples the buffered tuples
+   * @param bulk `true` to append whole pages through TableHeap::AppendBatch, `false` to insert row by row
+   * @return the number of rows inserted
+   */
+  auto InsertBatch(const std::vector<Tuple> &tuples, bool bulk) -> int32_t;
+
+  /** Take the exclusive lock on a freshly inserted row and add its index entries */
+  void LockAndIndex(const Tuple &tuple, const RID &rid);
+
   /** The insert plan node to be executed*/
   const InsertPlanNode *plan_;
   std::unique_ptr<AbstractExecutor> child_executor_;
   bool finished_{false};
   Transaction *txn_{nullptr};
   LockManager *lock_mgr_{nullptr};
+  TableInfo *table_info_{nullptr};
+  std::vector<IndexInfo *> indexs_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,86 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// merge_join_executor.h
+//
+// Identification: src/include/execution/executors/merge_join_executor.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "execution/executor_context.h"
+#include "execution/executors/abstract_executor.h"
+#include "execution/plans/merge_join_plan.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * MergeJoinExecutor executes a sort-merge JOIN on two children ordered ascending on their join keys.
+ * Only the run of right tuples sharing the current key is buffered.
+ */
+class MergeJoinExecutor : public AbstractExecutor {
+ public:
+  /**
+   * Construct a new MergeJoinExecutor instance.
+   * @param exec_ctx The executor context
+   * @param plan The merge join plan to be executed
+   * @param left_child The child executor that produces tuples for the left side of join
+   * @param right_child The child executor that produces tuples for the right side of join
+   */
+  MergeJoinExecutor(ExecutorContext *exec_ctx, const MergeJoinPlanNode *plan,
+                    std::unique_ptr<AbstractExecutor> &&left_child, std::unique_ptr<AbstractExecutor> &&right_child);
+
+  /** Initialize the join */
+  void Init() override;
+
+  /**
+   * Yield the next tuple from the join.
+   * @param[out] tuple The next tuple produced by the join.
+   * @param[out] rid The next tuple RID, not used by merge join.
+   * @return `true` if a tuple was produced, `false` if there are no more tuples.
+   */
+  auto Next(Tuple *tuple, RID *rid) -> bool override;
+
+  /** @return The output schema for the join */
+  auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
+
+ private:
+  /** Advance the left side. @return `false` if it is exhausted */
+  auto AdvanceLeft() -> bool;
+
+  /** Advance the right side. @return `false` if it is exhausted */
+  auto AdvanceRight() -> bool;
+
+  /** The merge join plan node to be executed. */
+  const MergeJoinPlanNode *plan_;
+  std::unique_ptr<AbstractExecutor> left_child_;
+  std::unique_ptr<AbstractExecutor> right_child_;
+
+  /** Current left tuple and its key */
+  Tuple left_tuple_;
+  Value left_key_;
+  bool left_valid_{false};
+  /** Next right tuple not yet moved into the run, and its key */
+  Tuple right_tuple_;
+  Value right_key_;
+  bool right_valid_{false};
+
+  /** Right tuples whose key equals run_key_ */
+  std::vector<Tuple> run_;
+  Value run_key_;
+  /** Next position in run_ to join with the current left tuple, run_.size() if it is not joining */
+  size_t run_idx_{0};
+  /** All-null right side, padded onto unmatched left tuples of a left join */
+  Tuple null_right_tuple_;
+};
+
+}  // namespace bustub
@@ -29,7 +29,9 @@
 namespace bustub {
 
 /**
- * IndexJoinExecutor executes index join operations.
+ * IndexJoinExecutor executes index join operations. Outer tuples are processed in batches of NIJ_BATCH_SIZE: the
+ * batch is probed against the index in key order, the matching heap tuples are fetched in page order, and the
+ * results are emitted in the original outer order.
  */
 class NestIndexJoinExecutor : public AbstractExecutor {
  public:
@@ -56,5 +58,19 @@ class NestIndexJoinExecutor : public AbstractExecutor {
   IndexInfo *index_info_;
   TableInfo *right_table_info_;
   BPlusTreeIndexForOneIntegerColumn *tree_{nullptr};
+
+  /** Read the next batch of outer tuples and look up their inner tuples. @return `false` if the outer side is done */
+  auto NextBatch() -> bool;
+
+  /** The current batch of outer tuples */
+  std::vector<Tuple> batch_;
+  /** The inner tuple matched by each outer tuple of the batch */
+  std::vector<Tuple> inner_tuples_;
+  /** Whether each outer tuple of the batch has a match */
+  std::vector<bool> matched_;
+  /** Next position in the batch to emit */
+  size_t cursor_{0};
+  /** All-null inner side, padded onto unmatched outer tuples of a left join */
+  Tuple null_inner_tuple_;
 };
 }  // namespace bustub
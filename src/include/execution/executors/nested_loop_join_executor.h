@@ -25,7 +25,9 @@
 namespace bustub {
 
 /**
- * NestedLoopJoinExecutor executes a nested-loop JOIN on two tables.
+ * NestedLoopJoinExecutor executes a block nested-loop JOIN on two tables. The right side is materialized once, the
+ * left side is buffered in blocks of about NLJ_BLOCK_SIZE bytes, and each right tuple is probed against the whole
+ * block before moving on, so the right side is scanned once per block instead of once per left tuple.
  */
 class NestedLoopJoinExecutor : public AbstractExecutor {
  public:
@@ -59,9 +61,20 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
   const NestedLoopJoinPlanNode *plan_;
   std::unique_ptr<AbstractExecutor> left_executor_;
   std::unique_ptr<AbstractExecutor> right_executor_;
+  /** Fill the next block from the left side. @return `false` if the left side is exhausted */
+  auto NextBlock() -> bool;
+
   std::vector<Tuple> right_tuples_;
-  Tuple left_tuple_;
-  size_t j_;
+  /** The current block of left tuples */
+  std::vector<Tuple> block_;
+  /** Whether each tuple in the block has matched anything, for left join */
+  std::vector<bool> matched_;
+  /** Right tuple being probed against the block */
+  size_t j_{0};
+  /** Next position in the block to probe, or to check for a null-padded left join output */
+  size_t i_{0};
+  /** All-null right side, padded onto unmatched left tuples of a left join */
+  Tuple null_right_tuple_;
 };
 
 }  // namespace bustub
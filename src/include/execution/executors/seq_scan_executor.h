@@ -16,6 +16,7 @@
 
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "container/hash/blocked_bloom_filter.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/seq_scan_plan.h"
@@ -54,12 +55,32 @@ class SeqScanExecutor : public AbstractExecutor {
   /** @return The output schema for the sequential scan */
   auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); }
 
+  /**
+   * Install a Bloom filter built by a join above this scan. Tuples whose join key is definitely not in the filter
+   * are skipped while they are still in the page, before they are copied, locked or returned. The filter takes
+   * effect at the next Init, so the join must install it before initializing the scan.
+   * @param bloom_filter The filter over the build side keys, owned by the join
+   * @param key_expr The expression computing the join key from a scanned tuple
+   */
+  void SetBloomFilter(const BlockedBloomFilter *bloom_filter, const AbstractExpression *key_expr) {
+    bloom_filter_ = bloom_filter;
+    bloom_key_expr_ = key_expr;
+  }
+
  private:
+  /** @return `false` if the filter predicate or the Bloom filter rules the tuple out, checked on a page view */
+  auto Accept(const Tuple &tuple) const -> bool;
+
   /** The sequential scan plan node to be executed */
   const SeqScanPlanNode *plan_;
   TableInfo *table_info_;
   TableIterator iter_;
   Transaction *txn_{nullptr};
   LockManager *lock_mgr_{nullptr};
+  /** Whether the scan takes table and row locks, snapshot reads take none */
+  bool locking_{true};
+  /** Bloom filter pushed down from a join, nullptr if there is none */
+  const BlockedBloomFilter *bloom_filter_{nullptr};
+  const AbstractExpression *bloom_key_expr_{nullptr};
 };
 }  // namespace bustub
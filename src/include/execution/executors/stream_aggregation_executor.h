@@ -0,0 +1,95 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// stream_aggregation_executor.h
+//
+// Identification: src/include/execution/executors/stream_aggregation_executor.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "execution/executor_context.h"
+#include "execution/executors/abstract_executor.h"
+#include "execution/executors/aggregation_executor.h"
+#include "execution/plans/stream_aggregation_plan.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * StreamAggregationExecutor aggregates a child whose rows arrive grouped by the GROUP BY keys.
+ * Only the group currently being built is kept in memory, and it is emitted as soon as the key changes.
+ */
+class StreamAggregationExecutor : public AbstractExecutor {
+ public:
+  /**
+   * Construct a new StreamAggregationExecutor instance.
+   * @param exec_ctx The executor context
+   * @param plan The stream aggregation plan to be executed
+   * @param child The child executor, ordered on the group by keys
+   */
+  StreamAggregationExecutor(ExecutorContext *exec_ctx, const StreamAggregationPlanNode *plan,
+                            std::unique_ptr<AbstractExecutor> &&child);
+
+  /** Initialize the aggregation */
+  void Init() override;
+
+  /**
+   * Yield the next group from the aggregation.
+   * @param[out] tuple The next tuple produced by the aggregation
+   * @param[out] rid The next tuple RID produced by the aggregation
+   * @return `true` if a tuple was produced, `false` if there are no more tuples
+   */
+  auto Next(Tuple *tuple, RID *rid) -> bool override;
+
+  /** @return The output schema for the aggregation */
+  auto GetOutputSchema() const -> const Schema & override { return plan_->OutputSchema(); };
+
+ private:
+  /** @return The tuple as an AggregateKey */
+  auto MakeAggregateKey(const Tuple *tuple) -> AggregateKey {
+    std::vector<Value> keys;
+    for (const auto &expr : plan_->GetGroupBys()) {
+      keys.emplace_back(expr->Evaluate(tuple, child_->GetOutputSchema()));
+    }
+    return {keys};
+  }
+
+  /** @return The tuple as an AggregateValue */
+  auto MakeAggregateValue(const Tuple *tuple) -> AggregateValue {
+    std::vector<Value> vals;
+    for (const auto &expr : plan_->GetAggregates()) {
+      vals.emplace_back(expr->Evaluate(tuple, child_->GetOutputSchema()));
+    }
+    return {vals};
+  }
+
+  /** @return The current group as an output tuple */
+  auto MakeOutputTuple() -> Tuple;
+
+  /** The stream aggregation plan node */
+  const StreamAggregationPlanNode *plan_;
+  /** The child executor that produces tuples ordered on the group by keys */
+  std::unique_ptr<AbstractExecutor> child_;
+  /** Only used for its initial value and combine logic, never holds any group */
+  SimpleAggregationHashTable aht_;
+  /** Key of the group being built */
+  AggregateKey group_key_;
+  /** Running aggregates of the group being built */
+  AggregateValue group_val_;
+  /** Whether group_key_ / group_val_ hold a group */
+  bool has_group_{false};
+  /** Whether the child has been exhausted */
+  bool finished_{false};
+  /** Whether any tuple has been produced */
+  bool emitted_{false};
+};
+
+}  // namespace bustub
@@ -38,10 +38,12 @@ enum class PlanType {
   Update,
   Delete,
   Aggregation,
+  StreamAggregation,
   Limit,
   NestedLoopJoin,
   NestedIndexJoin,
   HashJoin,
+  MergeJoin,
   Filter,
   Values,
   Projection,
@@ -100,10 +100,17 @@ struct AggregateKey {
   /**
    * Compares two aggregate keys for equality.
    * @param other the other aggregate key to be compared with
-   * @return `true` if both aggregate keys have equivalent group-by expressions, `false` otherwise
+   * @return `true` if both aggregate keys have equivalent group-by expressions, `false` otherwise. Two NULLs fall
+   * into the same group.
    */
   auto operator==(const AggregateKey &other) const -> bool {
     for (uint32_t i = 0; i < other.group_bys_.size(); i++) {
+      if (group_bys_[i].IsNull() || other.group_bys_[i].IsNull()) {
+        if (group_bys_[i].IsNull() != other.group_bys_[i].IsNull()) {
+          return false;
+        }
+        continue;
+      }
       if (group_bys_[i].CompareEquals(other.group_bys_[i]) != CmpBool::CmpTrue) {
         return false;
       }
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -29,24 +30,41 @@ class IndexScanPlanNode : public AbstractPlanNode {
    * Creates a new index scan plan node.
    * @param output the output format of this scan plan node
    * @param table_oid the identifier of table to be scanned
+   * @param lower_key the smallest key to scan, nullopt to start at the first key
+   * @param upper_key the largest key to scan, nullopt to run to the last key
    */
-  IndexScanPlanNode(SchemaRef output, index_oid_t index_oid)
-      : AbstractPlanNode(std::move(output), {}), index_oid_(index_oid) {}
+  IndexScanPlanNode(SchemaRef output, index_oid_t index_oid, std::optional<int64_t> lower_key = std::nullopt,
+                    std::optional<int64_t> upper_key = std::nullopt)
+      : AbstractPlanNode(std::move(output), {}),
+        index_oid_(index_oid),
+        lower_key_(lower_key),
+        upper_key_(upper_key) {}
 
   auto GetType() const -> PlanType override { return PlanType::IndexScan; }
 
   /** @return the identifier of the table that should be scanned */
   auto GetIndexOid() const -> index_oid_t { return index_oid_; }
 
+  /** @return whether only a range of keys is scanned */
+  auto IsRangeScan() const -> bool { return lower_key_.has_value() || upper_key_.has_value(); }
+
   BUSTUB_PLAN_NODE_CLONE_WITH_CHILDREN(IndexScanPlanNode);
 
   /** The table whose tuples should be scanned. */
   index_oid_t index_oid_;
 
   // Add anything you want here for index lookup
+  /** Inclusive bounds of the keys to scan, for an index on one integer column. */
+  std::optional<int64_t> lower_key_;
+  std::optional<int64_t> upper_key_;
 
  protected:
   auto PlanNodeToString() const -> std::string override {
+    if (IsRangeScan()) {
+      return fmt::format("IndexScan {{ index_oid={}, range=[{}, {}] }}", index_oid_,
+                         lower_key_ ? std::to_string(*lower_key_) : "-inf",
+                         upper_key_ ? std::to_string(*upper_key_) : "+inf");
+    }
     return fmt::format("IndexScan {{ index_oid={} }}", index_oid_);
   }
 };
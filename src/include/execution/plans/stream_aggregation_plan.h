@@ -0,0 +1,52 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// stream_aggregation_plan.h
+//
+// Identification: src/include/execution/plans/stream_aggregation_plan.h
+//
+// Copyright (c) 2015-2022, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "execution/plans/aggregation_plan.h"
+
+namespace bustub {
+
+/**
+ * StreamAggregationPlanNode is an aggregation whose child already produces the rows of each group
+ * contiguously (e.g. ordered on the GROUP BY keys), so groups can be emitted as soon as the key changes.
+ */
+class StreamAggregationPlanNode : public AggregationPlanNode {
+ public:
+  /**
+   * Construct a new StreamAggregationPlanNode.
+   * @param output_schema The output format of this plan node
+   * @param child The child plan to aggregate data over, ordered on the group by keys
+   * @param group_bys The group by clause of the aggregation
+   * @param aggregates The expressions that we are aggregating
+   * @param agg_types The types that we are aggregating
+   */
+  StreamAggregationPlanNode(SchemaRef output_schema, AbstractPlanNodeRef child,
+                            std::vector<AbstractExpressionRef> group_bys,
+                            std::vector<AbstractExpressionRef> aggregates, std::vector<AggregationType> agg_types)
+      : AggregationPlanNode(std::move(output_schema), std::move(child), std::move(group_bys), std::move(aggregates),
+                            std::move(agg_types)) {}
+
+  /** @return The type of the plan node */
+  auto GetType() const -> PlanType override { return PlanType::StreamAggregation; }
+
+  BUSTUB_PLAN_NODE_CLONE_WITH_CHILDREN(StreamAggregationPlanNode);
+
+ protected:
+  auto PlanNodeToString() const -> std::string override;
+};
+
+}  // namespace bustub
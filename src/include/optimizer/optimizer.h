@@ -1,12 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "binder/bound_order_by.h"
 #include "catalog/catalog.h"
 #include "concurrency/transaction.h"
 #include "execution/expressions/abstract_expression.h"
@@ -55,6 +57,19 @@ class Optimizer {
    */
   auto OptimizeNLJAsIndexJoin(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
 
+  /**
+   * @brief optimize nested loop join into merge join.
+   * Applies to a single equal condition when both sides are ordered on their join column or can be (an index on the
+   * column), or when sorting the unordered sides is estimated to be cheaper than the nested loop join.
+   */
+  auto OptimizeNLJAsMergeJoin(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /** @brief get a plan equivalent to `plan` whose output is ordered on col_idx, or nullptr if there is none */
+  auto OrderedOnColumn(const AbstractPlanNodeRef &plan, uint32_t col_idx) -> AbstractPlanNodeRef;
+
+  /** @brief estimate the output cardinality of a plan from the cardinalities of the tables it reads */
+  auto EstimatedPlanCardinality(const AbstractPlanNodeRef &plan) -> std::optional<size_t>;
+
   /**
    * @brief eliminate always true filter
    */
@@ -85,10 +100,27 @@ class Optimizer {
    */
   auto OptimizeOrderByAsIndexScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
 
+  /**
+   * @brief optimize a seq scan filtered on bounds of an indexed integer column as a range scan of that index, so a
+   * locking reader locks only the scanned key range instead of the whole table
+   */
+  auto OptimizeSeqScanAsIndexScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
   /** @brief check if the index can be matched */
   auto MatchIndex(const std::string &table_name, uint32_t index_key_idx)
       -> std::optional<std::tuple<index_oid_t, std::string>>;
 
+  /**
+   * @brief optimize aggregation as stream aggregation if the child is already ordered on the group by columns
+   */
+  auto OptimizeAggregationAsStreamAggregation(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef;
+
+  /**
+   * @brief get the columns the output of a plan is known to be ordered on, outermost first, each with the direction it
+   * is ordered in
+   */
+  auto OutputOrderColumns(const AbstractPlanNodeRef &plan) -> std::vector<std::pair<OrderByType, uint32_t>>;
+
   /**
    * @brief optimize sort + limit as top N
    */
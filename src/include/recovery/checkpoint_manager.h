@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <thread>  // NOLINT
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,7 +21,12 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager creates fuzzy checkpoints, without blocking other transactions.
+ *
+ * A checkpoint logs a CHECKPOINT record holding the running transactions with their last LSN, and the dirty pages
+ * of the buffer pool with their recLSN. Recovery then only has to redo from the smallest of those recLSNs, or from
+ * where the checkpoint began if that is older. The dirty pages are written back in the background afterwards, so that
+ * the next checkpoint can start redo further on.
  */
 class CheckpointManager {
  public:
@@ -29,15 +36,20 @@ class CheckpointManager {
         log_manager_(log_manager),
         buffer_pool_manager_(buffer_pool_manager) {}
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager();
 
+  /** Log a checkpoint record and start writing back the dirty pages it lists in the background. */
   void BeginCheckpoint();
+
+  /** Wait for the dirty pages of the checkpoint to be written back, and for the log to be flushed. */
   void EndCheckpoint();
 
  private:
   TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  /** Writes back the dirty pages of the last checkpoint */
+  std::thread writer_;
 };
 
 }  // namespace bustub
@@ -13,9 +13,12 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
@@ -25,16 +28,28 @@ namespace bustub {
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * Appending does not take a latch. The next LSN and the write offset into log_buffer_ share one 64-bit word, so a
+ * single fetch-add hands a writer both its LSN and a private region of the buffer, and LSN order matches the order of
+ * the records in the log. Writers serialize into their regions in parallel and publish completion by adding their
+ * size to a byte counter. The first writer whose record does not fit seals the buffer: once every earlier region is
+ * complete it swaps log_buffer_ with flush_buffer_ and appends continue into the fresh buffer while the flush thread
+ * writes the sealed one to disk.
+ *
+ * Commits use group commit: a committing transaction waits in WaitForFlush for its commit record, and the flush thread
+ * forces the log once for every waiter of the group. The force happens once GROUP_COMMIT_SIZE bytes are waiting, once
+ * the group has waited for the adaptive group window, or when the buffer fills up. The window follows the time a log
+ * write takes while groups have more than one member and drops to zero for a lone committer, bounded by log_timeout.
  */
 class LogManager {
  public:
-  explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+  explicit LogManager(DiskManager *disk_manager) : disk_manager_(disk_manager) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
     flush_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
   ~LogManager() {
+    StopFlushThread();
     delete[] log_buffer_;
     delete[] flush_buffer_;
     log_buffer_ = nullptr;
@@ -46,29 +61,106 @@ class LogManager {
 
   auto AppendLogRecord(LogRecord *log_record) -> lsn_t;
 
-  inline auto GetNextLSN() -> lsn_t { return next_lsn_; }
+  /**
+   * Block until every log record up to and including lsn is on disk, sealing the log buffer early if needed. This is
+   * what the buffer pool calls, with its latch released, before writing out a page whose LSN is not yet persistent.
+   * @param lsn the LSN that must become persistent; it is clamped to the last LSN handed out
+   */
+  void Flush(lsn_t lsn);
+
+  /**
+   * Group commit: block until lsn is on disk, letting the flush thread batch this force with other committers.
+   * @param lsn the LSN of the caller's commit record
+   */
+  void WaitForFlush(lsn_t lsn);
+
+  /**
+   * Asynchronous commit: return at once, but have the flush thread make lsn durable within async_commit_delay.
+   * @param lsn the LSN of the caller's commit record
+   */
+  void ScheduleFlush(lsn_t lsn);
+
+  inline auto GetNextLSN() -> lsn_t { return Lsn(state_.load()); }
   inline auto GetPersistentLSN() -> lsn_t { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
   inline auto GetLogBuffer() -> char * { return log_buffer_; }
 
  private:
-  // TODO(students): you may add your own member variables
-
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  using Clock = std::chrono::steady_clock;
+
+  /** Adding this to state_ hands out one LSN */
+  static constexpr uint64_t LSN_ONE = uint64_t{1} << 32;
+  static constexpr uint64_t OFFSET_MASK = LSN_ONE - 1;
+
+  static inline auto Lsn(uint64_t state) -> lsn_t { return static_cast<lsn_t>(state >> 32); }
+  static inline auto Offset(uint64_t state) -> uint64_t { return state & OFFSET_MASK; }
+
+  /** Write the record in the on-disk format described in log_record.h to dst. */
+  static void SerializeLogRecord(const LogRecord &log_record, char *dst);
+
+  /**
+   * Called by the one reservation that crossed the end of log_buffer_. Waits for the regions before it to complete,
+   * then hands the buffer to the flush thread (or writes it directly when there is none).
+   * @param state the value of state_ the crossing reservation observed
+   * @param is_flusher whether the caller is the flush thread itself
+   */
+  void SealBuffer(uint64_t state, bool is_flusher);
+
+  /**
+   * Seal log_buffer_ at its current fill level.
+   * @return false if another reservation is already sealing it, in which case nothing was done
+   */
+  auto SealCurrentBuffer(bool is_flusher) -> bool;
+
+  /** Write flush_buffer_ to disk and advance persistent_lsn_. The latch is released during the write. */
+  void WriteFlushBuffer(std::unique_lock<std::mutex> *lock);
+
+  /** Body of the flush thread */
+  void FlushLoop();
+
+  /** The next LSN in the upper 32 bits and the reserved bytes of log_buffer_ in the lower 32 bits. */
+  std::atomic<uint64_t> state_{0};
+  /** Bytes of log_buffer_ whose writers have finished serializing. */
+  std::atomic<uint64_t> completed_{0};
+  /** Bumped every time log_buffer_ is swapped out, so writers that found it full know when to retry. */
+  std::atomic<uint64_t> generation_{0};
   /** The log records before and including the persistent lsn have been written to disk. */
-  std::atomic<lsn_t> persistent_lsn_;
+  std::atomic<lsn_t> persistent_lsn_{INVALID_LSN};
 
   char *log_buffer_;
   char *flush_buffer_;
 
+  /** Protects everything below, and the swap of the two buffers. */
   std::mutex latch_;
-
-  std::thread *flush_thread_ __attribute__((__unused__));
-
+  /** flush_buffer_ holds a sealed buffer that has not reached disk yet. */
+  bool flush_pending_{false};
+  /** Bytes of flush_buffer_ to write, and the last LSN they cover. */
+  uint64_t flush_size_{0};
+  lsn_t flush_lsn_{INVALID_LSN};
+  /** Someone is waiting in Flush() for a partially filled buffer. */
+  bool flush_requested_{false};
+  /** Highest commit LSN anyone waits for in WaitForFlush, when the oldest unflushed one started waiting, and how many
+   * commits have joined the group since the last force. */
+  lsn_t commit_lsn_{INVALID_LSN};
+  Clock::time_point group_since_;
+  size_t group_size_{0};
+  /** Highest asynchronously committed LSN, and when the oldest one not yet on disk committed. */
+  lsn_t async_lsn_{INVALID_LSN};
+  Clock::time_point async_since_;
+  /** How long a group waits for more members, and the smoothed time one log write takes. */
+  std::chrono::microseconds group_window_{0};
+  std::chrono::microseconds write_time_{0};
+  /** The flush thread is in FlushLoop; when it is not, sealers write their buffer themselves. */
+  bool running_{false};
+  bool stop_{false};
+
+  std::thread *flush_thread_{nullptr};
+
+  /** Writers, sealers and committers wait on cv_; only the flush thread waits on flusher_cv_. */
   std::condition_variable cv_;
+  std::condition_variable flusher_cv_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
@@ -14,6 +14,8 @@
 
 #include <cassert>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,6 +34,10 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Filling a new page of the table heap with a batch of tuples, see TableHeap::AppendBatch. */
+  INSERTPAGE,
+  /** A fuzzy checkpoint, see CheckpointManager. */
+  CHECKPOINT,
 };
 
 /**
@@ -57,6 +63,14 @@ enum class LogRecordType {
  *--------------------------
  * | HEADER | prev_page_id |
  *--------------------------
+ * For insert page type log record, the tuples go into slots 0 .. tuple_count - 1 of the page
+ *---------------------------------------------------------------------------------------
+ * | HEADER | page_id | tuple_count | tuple_size | tuple_data | ... | tuple_size | tuple_data |
+ *---------------------------------------------------------------------------------------
+ * For checkpoint type log record, the active transactions with their last LSN and the dirty pages with their recLSN
+ *------------------------------------------------------------------------------------------------------
+ * | HEADER | begin_lsn | txn_count | txn_id | last_lsn | ... | page_count | page_id | rec_lsn | ... |
+ *------------------------------------------------------------------------------------------------------
  */
 class LogRecord {
   friend class LogManager;
@@ -110,6 +124,33 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for INSERTPAGE type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t page_id,
+            std::vector<Tuple> tuples)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        page_id_(page_id),
+        page_tuples_(std::move(tuples)) {
+    // calculate log record size
+    size_ = HEADER_SIZE + sizeof(page_id_t) + sizeof(int32_t);
+    for (const auto &tuple : page_tuples_) {
+      size_ += sizeof(int32_t) + tuple.GetLength();
+    }
+  }
+
+  // constructor for CHECKPOINT type
+  LogRecord(lsn_t begin_lsn, std::vector<std::pair<txn_id_t, lsn_t>> active_txns,
+            std::vector<std::pair<page_id_t, lsn_t>> dirty_pages)
+      : log_record_type_(LogRecordType::CHECKPOINT),
+        begin_lsn_(begin_lsn),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    // calculate log record size
+    size_ = HEADER_SIZE + sizeof(lsn_t) + 2 * sizeof(int32_t) +
+            (active_txns_.size() + dirty_pages_.size()) * (sizeof(int32_t) + sizeof(lsn_t));
+  }
+
   ~LogRecord() = default;
 
   inline auto GetDeleteTuple() -> Tuple & { return delete_tuple_; }
@@ -128,6 +169,16 @@ class LogRecord {
 
   inline auto GetNewPageRecord() -> page_id_t { return prev_page_id_; }
 
+  inline auto GetPageTuples() -> std::vector<Tuple> & { return page_tuples_; }
+
+  inline auto GetPageId() -> page_id_t { return page_id_; }
+
+  inline auto GetCheckpointBeginLSN() -> lsn_t { return begin_lsn_; }
+
+  inline auto GetActiveTxns() -> std::vector<std::pair<txn_id_t, lsn_t>> & { return active_txns_; }
+
+  inline auto GetDirtyPages() -> std::vector<std::pair<page_id_t, lsn_t>> & { return dirty_pages_; }
+
   inline auto GetSize() -> int32_t { return size_; }
 
   inline auto GetLSN() -> lsn_t { return lsn_; }
@@ -176,6 +227,14 @@ class LogRecord {
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
+
+  // case5: for insert page operation, page_id_ is the page
+  std::vector<Tuple> page_tuples_;
+
+  // case6: for checkpoint, the next LSN when the checkpoint began
+  lsn_t begin_lsn_{INVALID_LSN};
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
   static const int HEADER_SIZE = 20;
 };  // namespace bustub
 
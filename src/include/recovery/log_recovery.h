@@ -13,8 +13,13 @@
 #pragma once
 
 #include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
@@ -24,6 +29,13 @@ namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo first reads the headers of the whole log to find the loser transactions and the last checkpoint, then replays
+ * the log from the redo point of that checkpoint: the oldest change that may be missing from the pages on disk. The
+ * replay is a pipeline: the calling thread reads and parses the log and hands every page change to one of
+ * RECOVERY_WORKERS redo workers, chosen by page id. Each worker replays its pages in log order, so per-page order is
+ * kept while different pages are replayed in parallel. Undo then rolls the loser transactions back in parallel, one
+ * transaction per worker at a time; their changes touch different tuples because they held exclusive locks on them.
  */
 class LogRecovery {
  public:
@@ -42,15 +54,68 @@ class LogRecovery {
   auto DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool;
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /**
+   * A page change handed to a redo worker. A NEWPAGE record is handed out twice: once to initialize the new page, and
+   * once, with link_ set, to the worker owning the previous page to point that page at the new one.
+   */
+  struct RedoTask {
+    LogRecord record_;
+    bool link_{false};
+  };
+
+  /** The batches of tasks one redo worker replays, in log order. */
+  struct RedoQueue {
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::deque<std::vector<RedoTask>> batches_;
+    bool closed_{false};
+  };
+
+  /**
+   * Read the log file from the given offset to its end, one record at a time.
+   * @param offset offset in the log file of the first record
+   * @param header_only only parse the header of the records, except for checkpoints
+   * @param visit called with every record and its offset in the log file
+   */
+  void ScanLog(int offset, bool header_only, const std::function<void(LogRecord *, int)> &visit);
+
+  /** Parse the header of a log record. @return false if there is no record there, i.e. the log ended */
+  auto DeserializeLogHeader(const char *data, LogRecord *log_record) -> bool;
+
+  /** Parse the body of a log record whose header has been parsed. */
+  void DeserializeLogBody(const char *data, LogRecord *log_record);
+
+  /** Body of a redo worker: replay batches until the queue is closed and drained. */
+  void RunRedoWorker(RedoQueue *queue);
+
+  /** Apply one page change unless the page already has it (its LSN is not older than the record's). */
+  void RedoPage(RedoTask *task);
+
+  /** Roll back the changes of one loser transaction, newest first, starting from its last LSN. */
+  void UndoTransaction(lsn_t last_lsn, char *buffer);
+
+  /**
+   * Undo one page change.
+   * @param log_record the change
+   * @param lost_slots tuples of the transaction whose slot another transaction took; their earlier changes are skipped
+   */
+  void UndoPage(LogRecord *log_record, std::unordered_set<RID> *lost_slots);
+
+  /** Read the record with the given LSN from the log file into buffer and parse it. */
+  auto ReadLogRecord(lsn_t lsn, char *buffer, LogRecord *log_record) -> bool;
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
   /** Mapping the log sequence number to log file offset for undos. */
   std::unordered_map<lsn_t, int> lsn_mapping_;
+  /** Undo workers share the log file stream. */
+  std::mutex log_latch_;
 
-  int offset_ __attribute__((__unused__));  // NOLINT
+  /** Offset in the log file of the first byte in log_buffer_ */
+  int offset_;
   char *log_buffer_;
 };
 
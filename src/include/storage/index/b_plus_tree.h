@@ -67,6 +67,11 @@ class BPlusTree {
   // return the value associated with a given key
   auto GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr) -> bool;
 
+  // look up keys sorted in ascending order, staying on the current leaf while the keys fall into it; every hit is
+  // reported as (position in keys, value)
+  void GetValues(const std::vector<KeyType> &keys, std::vector<std::pair<size_t, ValueType>> *result,
+                 Transaction *transaction = nullptr);
+
   // return the page id of the root node
   auto GetRootPageId() -> page_id_t;
 
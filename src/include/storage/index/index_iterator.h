@@ -34,17 +34,28 @@ class IndexIterator {
     }
   }
 
-  ~IndexIterator() {
-    // buffer可能在iterator之前析构。所以按照effective cpp所说，吞下异常。
-    if (leaf_page_ != nullptr) {
-      try {
-        buffer_pool_manager_->UnpinPage(leaf_page_->GetPageId(), false);
-      } catch (...) {
-        printf("buffer_pool_manager destructs before iterator\n");
-      }
+  // iterator独占对leaf_page的pin，只能移动不能拷贝；否则临时对象析构时会把pin还掉，叶子可能被换出。
+  IndexIterator(const IndexIterator &) = delete;
+  auto operator=(const IndexIterator &) -> IndexIterator & = delete;
+
+  IndexIterator(IndexIterator &&other) noexcept
+      : index_(other.index_), buffer_pool_manager_(other.buffer_pool_manager_), leaf_page_(other.leaf_page_) {
+    other.leaf_page_ = nullptr;
+  }
+
+  auto operator=(IndexIterator &&other) noexcept -> IndexIterator & {
+    if (this != &other) {
+      Release();
+      index_ = other.index_;
+      buffer_pool_manager_ = other.buffer_pool_manager_;
+      leaf_page_ = other.leaf_page_;
+      other.leaf_page_ = nullptr;
     }
+    return *this;
   }
 
+  ~IndexIterator() { Release(); }
+
   auto IsEnd() -> bool;
 
   auto operator*() -> const MappingType &;
@@ -60,10 +71,22 @@ class IndexIterator {
  private:
   using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
 
+  void Release() noexcept {
+    // buffer可能在iterator之前析构。所以按照effective cpp所说，吞下异常。
+    if (leaf_page_ != nullptr) {
+      try {
+        buffer_pool_manager_->UnpinPage(leaf_page_->GetPageId(), false);
+      } catch (...) {
+        printf("buffer_pool_manager destructs before iterator\n");
+      }
+      leaf_page_ = nullptr;
+    }
+  }
+
   // buffer_pool_manager标识树，leafpage标识叶子，index表示下标。
-  int index_;
-  BufferPoolManager *buffer_pool_manager_;
-  LeafPage *leaf_page_;
+  int index_{0};
+  BufferPoolManager *buffer_pool_manager_{nullptr};
+  LeafPage *leaf_page_{nullptr};
   // add your own private member variables here
 };
 
@@ -66,6 +66,9 @@ class Page {
   /** Sets the page LSN. */
   inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
 
+  /** @return the recLSN of this page: no change older than it is missing from the page on disk */
+  inline auto GetRecLSN() -> lsn_t { return rec_lsn_; }
+
  protected:
   static_assert(sizeof(page_id_t) == 4);
   static_assert(sizeof(lsn_t) == 4);
@@ -86,6 +89,8 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /** The recLSN of this page, kept by the buffer pool manager whenever the page is read or written. */
+  lsn_t rec_lsn_ = 0;
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
 };
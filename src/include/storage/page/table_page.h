@@ -13,6 +13,7 @@
 #pragma once
 
 #include <cstring>
+#include <vector>
 
 #include "common/rid.h"
 #include "concurrency/lock_manager.h"
@@ -84,6 +85,16 @@ class TablePage : public Page {
   auto InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager)
       -> bool;
 
+  /**
+   * Append tuples after the last slot, as many as fit, without looking for free slots in between. Meant for filling
+   * a freshly allocated page in one go; nothing is logged here.
+   * @param tuples the tuples to append
+   * @param begin index of the first tuple in `tuples` to append
+   * @param[out] rids the rids of the appended tuples are pushed here
+   * @return the number of tuples appended
+   */
+  auto AppendTuples(const std::vector<Tuple> &tuples, size_t begin, std::vector<RID> *rids) -> size_t;
+
   /**
    * Mark a tuple as deleted. This does not actually delete the tuple.
    * @param rid rid of the tuple to mark as deleted
@@ -113,6 +124,15 @@ class TablePage : public Page {
   /** To be called on abort. Rollback a delete, i.e. this reverses a MarkDelete. */
   void RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
 
+  /**
+   * To be called on recovery, to undo an ApplyDelete. Put the tuple back into the slot it was deleted from, marked as
+   * deleted, so that undoing the earlier changes to it finds it there. Not logged.
+   * @param rid rid the tuple had
+   * @param tuple the deleted tuple
+   * @return false if another tuple took the slot since, or the page has no room for the tuple
+   */
+  auto RestoreTuple(const RID &rid, const Tuple &tuple) -> bool;
+
   /**
    * Read a tuple from a table.
    * @param rid rid of the tuple to read
@@ -123,6 +143,25 @@ class TablePage : public Page {
    */
   auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager) -> bool;
 
+  /**
+   * Point a tuple at the bytes of the tuple with the given RID in this page, without copying them. The view is only
+   * valid while the page stays pinned and read-latched, so copy (GetTuple) whatever has to outlive the latch.
+   * @param rid rid of the tuple to view
+   * @param[out] tuple the view, it does not own its data
+   * @return true if the view succeeded
+   */
+  auto GetTupleView(const RID &rid, Tuple *tuple) -> bool;
+
+  /**
+   * Copy out the tuple with the given RID even if it is marked deleted. A marked tuple keeps its bytes until the
+   * delete is applied, and a snapshot that began before the delete still reads them.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the copy
+   * @param[out] marked whether the tuple carries the delete mark
+   * @return false if the slot is empty
+   */
+  auto GetTupleWithMark(const RID &rid, Tuple *tuple, bool *marked) -> bool;
+
   /** @return the rid of the first tuple in this page */
 
   /**
@@ -138,6 +177,17 @@ class TablePage : public Page {
    */
   auto GetNextTupleRid(const RID &cur_rid, RID *next_rid) -> bool;
 
+  /** @return the free bytes left in this page */
+  auto GetFreeSpaceRemaining() -> uint32_t {
+    return GetFreeSpacePointer() - SIZE_TABLE_PAGE_HEADER - SIZE_TUPLE * GetTupleCount();
+  }
+
+  /** @return the free bytes a page needs to be sure it can take a tuple of the given size, slot included */
+  static auto SpaceForTuple(uint32_t tuple_size) -> uint32_t { return tuple_size + SIZE_TUPLE; }
+
+  /** @return the number of slots in this page, some of them may be empty or hold a tuple marked deleted */
+  auto GetSlotCount() -> uint32_t { return GetTupleCount(); }
+
  private:
   static_assert(sizeof(page_id_t) == 4);
 
@@ -167,10 +217,6 @@ class TablePage : public Page {
   /** Set the number of tuples in this page. */
   void SetTupleCount(uint32_t tuple_count) { memcpy(GetData() + OFFSET_TUPLE_COUNT, &tuple_count, sizeof(uint32_t)); }
 
-  auto GetFreeSpaceRemaining() -> uint32_t {
-    return GetFreeSpacePointer() - SIZE_TABLE_PAGE_HEADER - SIZE_TUPLE * GetTupleCount();
-  }
-
   /** @return tuple offset at slot slot_num */
   auto GetTupleOffsetAtSlot(uint32_t slot_num) -> uint32_t {
     return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_TUPLE_OFFSET + SIZE_TUPLE * slot_num);
@@ -0,0 +1,77 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// free_space_map.h
+//
+// Identification: src/include/storage/table/free_space_map.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * FreeSpaceMap tracks how much free space each page of a TableHeap has, so an insert can find a page with room
+ * without walking the page chain.
+ *
+ * Free space is recorded at a granularity of CATEGORY_SIZE bytes: a page with `n` free bytes is in category
+ * `n / CATEGORY_SIZE`, which is a lower bound on its free space. Pages are bucketed by category, and a bitmap of the
+ * non-empty buckets makes finding a page constant time: at most CATEGORY_COUNT bits are checked, however many pages
+ * the table has.
+ *
+ * The map is a hint. A page it returns may have been filled concurrently, so callers still have to check, and should
+ * report the space they actually saw with Update().
+ */
+class FreeSpaceMap {
+ public:
+  /** Number of free space categories */
+  static constexpr uint32_t CATEGORY_COUNT = 256;
+  /** Bytes of free space per category */
+  static constexpr uint32_t CATEGORY_SIZE = BUSTUB_PAGE_SIZE / CATEGORY_COUNT;
+
+  /**
+   * Record the free space of a page, adding the page to the map if it is not there yet.
+   * @param page_id the table page
+   * @param free_bytes free bytes left in the page
+   */
+  void Update(page_id_t page_id, uint32_t free_bytes);
+
+  /**
+   * Find a page that has at least `bytes` free bytes. Among the pages that qualify, one with the least free space is
+   * picked, which keeps the roomier pages for larger tuples.
+   * @param bytes the space needed
+   * @return a page id, or INVALID_PAGE_ID if no page is known to have enough space
+   */
+  auto FindPage(uint32_t bytes) -> page_id_t;
+
+  /** @return the number of pages in the map */
+  auto Size() -> size_t;
+
+ private:
+  static auto CategoryOf(uint32_t free_bytes) -> uint32_t {
+    return std::min(free_bytes / CATEGORY_SIZE, CATEGORY_COUNT - 1);
+  }
+
+  std::mutex latch_;
+  /** Category of every page */
+  std::unordered_map<page_id_t, uint32_t> categories_;
+  /** Pages in every category */
+  std::array<std::unordered_set<page_id_t>, CATEGORY_COUNT> pages_;
+  /** Which categories have any page */
+  std::bitset<CATEGORY_COUNT> non_empty_;
+};
+
+}  // namespace bustub
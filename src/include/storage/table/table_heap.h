@@ -12,17 +12,34 @@
 
 #pragma once
 
+#include <mutex>  // NOLINT
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
+#include "storage/table/free_space_map.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "storage/table/version_store.h"
+#include "storage/table/version_words.h"
 
 namespace bustub {
 
 /**
  * TableHeap represents a physical table on disk.
  * This is just a doubly-linked list of pages.
+ *
+ * Inserts do not walk the list. They first try the page the last insert went to, then ask the free space map for a
+ * page with enough room, and only then append a new page at the end of the list. The free space map lives in memory;
+ * a heap opened from an existing first page rebuilds it with one pass over the pages on its first insert.
+ *
+ * Every write is also recorded in the heap's VersionStore, which SNAPSHOT_ISOLATION transactions read through:
+ * their iterators and GetTuple return the version committed as of their snapshot, including tuples whose delete
+ * another transaction has marked or committed since.
+ *
+ * Every tuple that was ever written also has a version word (see VersionWords). Reads by an optimistic transaction
+ * go into its read set together with the word they saw.
  */
 class TableHeap {
   friend class TableIterator;
@@ -59,6 +76,17 @@ class TableHeap {
    */
   auto InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> bool;
 
+  /**
+   * Append a batch of tuples on freshly allocated pages at the end of the table. Each page is filled directly under
+   * a single latch, logged as one INSERTPAGE record when logging is enabled, and recorded as one write set entry
+   * covering its slot range. Meant for bulk loads; a small batch still takes a page of its own.
+   * @param tuples tuples to append
+   * @param[out] rids the rids of the appended tuples, in the order of `tuples`
+   * @param txn the transaction performing the insert
+   * @return true iff all tuples were appended
+   */
+  auto AppendBatch(const std::vector<Tuple> &tuples, std::vector<RID> *rids, Transaction *txn) -> bool;
+
   /**
    * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called.
    * @param rid resource id of the tuple of delete
@@ -108,11 +136,60 @@ class TableHeap {
   /** @return the id of the first page of this table */
   inline auto GetFirstPageId() const -> page_id_t { return first_page_id_; }
 
+  /** @return the older versions of the tuples of this table */
+  inline auto GetVersionStore() -> VersionStore * { return &version_store_; }
+
+  /** @return the version words of the tuples of this table */
+  inline auto GetVersionWords() -> VersionWords * { return &version_words_; }
+
+  /**
+   * Garbage collect the versions no snapshot can see any more, and apply the deletes that were left marked for
+   * older snapshots.
+   * @param oldest the read timestamp of the oldest active snapshot
+   * @param txn the system transaction the deletes are applied and logged under
+   */
+  void CollectVersions(timestamp_t oldest, Transaction *txn);
+
  private:
+  /** Build the free space map and find the last page, if this heap was opened from an existing first page */
+  void LoadFreeSpaceMap();
+
+  /**
+   * Try to insert into the given page, and record the space left in it in the free space map.
+   * @return true if the tuple went into the page
+   */
+  auto InsertIntoPage(page_id_t page_id, const Tuple &tuple, RID *rid, Transaction *txn) -> bool;
+
+  /**
+   * Insert into the last page, appending a new page to the list if it is full.
+   * @return false if no new page could be allocated
+   */
+  auto InsertAtEnd(const Tuple &tuple, RID *rid, Transaction *txn) -> bool;
+
+  /**
+   * Read the version of a tuple a SNAPSHOT_ISOLATION transaction sees. The page must be latched.
+   * @return false if the transaction sees no version of the tuple
+   */
+  auto ReadVersion(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn) -> bool;
+
+  /** Add a tuple an optimistic transaction read to its read set, with its version word. The page must be latched. */
+  void RecordRead(Transaction *txn, const RID &rid);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+
+  /** Protects the fields below, and serializes appending pages */
+  std::mutex latch_;
+  /** The last page in the list */
+  page_id_t last_page_id_{INVALID_PAGE_ID};
+  /** The page the last insert went to, tried first by the next insert */
+  page_id_t append_target_{INVALID_PAGE_ID};
+  bool free_space_map_loaded_{false};
+  FreeSpaceMap free_space_map_;
+  VersionStore version_store_;
+  VersionWords version_words_;
 };
 
 }  // namespace bustub
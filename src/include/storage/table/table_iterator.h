@@ -13,6 +13,9 @@
 #pragma once
 
 #include <cassert>
+#include <functional>
+#include <utility>
+#include <vector>
 
 #include "common/rid.h"
 #include "concurrency/transaction.h"
@@ -24,15 +27,36 @@ class TableHeap;
 
 /**
  * TableIterator enables the sequential scan of a TableHeap.
+ *
+ * The iterator works a page at a time: when it reaches a page it pins and read-latches it once, copies out the
+ * batch of tuples still ahead of it on that page, and releases the page again. Advancing within the batch does not
+ * touch the buffer pool. The batch is a snapshot of the page taken when the iterator got there.
+ *
+ * The iterator can carry a predicate. While a page is loaded, each tuple is looked at through a view into the page
+ * (see TablePage::GetTupleView), and only the tuples that pass the predicate are copied out. Views never outlive the
+ * latch, so nothing handed out by the iterator points into the buffer pool.
+ *
+ * For a SNAPSHOT_ISOLATION transaction every slot of the page, marked deleted or not, is resolved to the version the
+ * snapshot sees (see VersionStore), and the predicate is checked on that version.
  */
 class TableIterator {
   friend class Cursor;
 
  public:
+  /** Decides on a view of a tuple whether the tuple should be returned by the iterator */
+  using Predicate = std::function<bool(const Tuple &)>;
+
   TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
 
   TableIterator(const TableIterator &other)
-      : table_heap_(other.table_heap_), tuple_(new Tuple(*other.tuple_)), txn_(other.txn_) {}
+      : table_heap_(other.table_heap_),
+        tuple_(new Tuple(*other.tuple_)),
+        txn_(other.txn_),
+        snapshot_(other.snapshot_),
+        predicate_(other.predicate_),
+        batch_(other.batch_),
+        next_in_batch_(other.next_in_batch_),
+        next_page_id_(other.next_page_id_) {}
 
   ~TableIterator() { delete tuple_; }
 
@@ -54,13 +78,36 @@ class TableIterator {
     table_heap_ = other.table_heap_;
     *tuple_ = *other.tuple_;
     txn_ = other.txn_;
+    snapshot_ = other.snapshot_;
+    predicate_ = other.predicate_;
+    batch_ = other.batch_;
+    next_in_batch_ = other.next_in_batch_;
+    next_page_id_ = other.next_page_id_;
     return *this;
   }
 
+  /**
+   * Only return tuples passing the predicate from now on. If the current tuple does not pass, the iterator advances
+   * right away.
+   */
+  void SetPredicate(Predicate predicate);
+
  private:
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  /** Whether the iterator reads the snapshot of a SNAPSHOT_ISOLATION transaction through the version store */
+  bool snapshot_;
+  Predicate predicate_;
+
+  /** Copy the tuples of a page, starting at `from`, into the batch. The page is pinned and latched only inside. */
+  void LoadPage(RID from);
+
+  /** Tuples of the current page still ahead of the iterator */
+  std::vector<Tuple> batch_;
+  size_t next_in_batch_{0};
+  /** The page after the current one */
+  page_id_t next_page_id_{INVALID_PAGE_ID};
 };
 
 }  // namespace bustub
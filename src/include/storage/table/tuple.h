@@ -42,12 +42,22 @@ class Tuple {
   // constructor for creating a new tuple based on input value
   Tuple(std::vector<Value> values, const Schema *schema);
 
+  // constructor for creating a new tuple whose columns are those of left followed by those of right (e.g. a join
+  // output), built by copying raw bytes instead of going through Values
+  Tuple(const Tuple &left, const Schema *left_schema, const Tuple &right, const Schema *right_schema);
+
   // copy constructor, deep copy
   Tuple(const Tuple &other);
 
   // assign operator, deep copy
   auto operator=(const Tuple &other) -> Tuple &;
 
+  // move constructor, takes over the data of other without copying
+  Tuple(Tuple &&other) noexcept;
+
+  // move assign operator, takes over the data of other without copying
+  auto operator=(Tuple &&other) noexcept -> Tuple &;
+
   ~Tuple() {
     if (allocated_) {
       delete[] data_;
@@ -75,7 +85,8 @@ class Tuple {
   auto GetValue(const Schema *schema, uint32_t column_idx) const -> Value;
 
   // Generates a key tuple given schemas and attributes
-  auto KeyFromTuple(const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs) -> Tuple;
+  auto KeyFromTuple(const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs) const
+      -> Tuple;
 
   // Is the column value null ?
   inline auto IsNull(const Schema *schema, uint32_t column_idx) const -> bool {
@@ -84,6 +95,9 @@ class Tuple {
   }
   inline auto IsAllocated() -> bool { return allocated_; }
 
+  // Is this a view of bytes owned by someone else (e.g. a pinned page), see TablePage::GetTupleView ?
+  inline auto IsView() const -> bool { return !allocated_ && data_ != nullptr; }
+
   auto ToString(const Schema *schema) const -> std::string;
 
  private:
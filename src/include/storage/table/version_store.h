@@ -0,0 +1,127 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/storage/table/version_store.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * VersionStore keeps the older versions of the tuples of one TableHeap, so a SNAPSHOT_ISOLATION transaction can
+ * read the table as of its snapshot without taking any lock.
+ *
+ * The table page always holds the newest version of a tuple. A tuple that has been written since the oldest active
+ * snapshot has a version chain here: who wrote the page version (while uncommitted), its commit timestamp, and an
+ * undo list of the versions it replaced, each with the commit timestamp it became visible at. A tuple without a
+ * chain is visible to everyone exactly as the page has it.
+ *
+ * Writers record their writes under the page write latch, and readers resolve a tuple under the page read latch, so
+ * a reader never sees a page version without the chain that explains it. Deletes committed while some snapshot still
+ * needs the tuple are left marked in the page; Collect() hands them back once no snapshot can see them.
+ */
+class VersionStore {
+ public:
+  /** Which version of a tuple a snapshot sees */
+  enum class ReadResult { INVISIBLE, CURRENT, UNDO };
+
+  /**
+   * Check a write against first-committer-wins: a SNAPSHOT_ISOLATION transaction may not overwrite a version
+   * committed after its snapshot.
+   * @return true if the transaction has to abort instead of writing the tuple
+   */
+  auto HasConflict(Transaction *txn, const RID &rid) -> bool;
+
+  /**
+   * Record a write of the tuple by an uncommitted transaction. Called under the page write latch, with the page
+   * already changed.
+   * @param txn the writing transaction
+   * @param rid the written tuple
+   * @param before the tuple before the write, nullptr if the slot was empty (an insert)
+   * @param deleting whether the write marks the tuple deleted
+   */
+  void RecordWrite(Transaction *txn, const RID &rid, const Tuple *before, bool deleting);
+
+  /** Stamp the version written by the transaction with its commit timestamp */
+  void Commit(txn_id_t txn_id, const RID &rid, timestamp_t commit_ts);
+
+  /** Throw away the version written by the transaction, once the page has its old version back */
+  void Rollback(txn_id_t txn_id, const RID &rid);
+
+  /** @return the uncommitted writer of the tuple, INVALID_TXN_ID if there is none */
+  auto WriterOf(const RID &rid) -> txn_id_t;
+
+  /** Drop the chain of the tuple, e.g. because its slot is being emptied */
+  void Erase(const RID &rid);
+
+  /**
+   * Decide which version of a tuple the transaction sees. Called under the page read latch.
+   * @param txn the reading transaction
+   * @param rid the tuple
+   * @param marked whether the page version carries the delete mark
+   * @param[out] old_version the version to read when the result is UNDO
+   */
+  auto Read(Transaction *txn, const RID &rid, bool marked, Tuple *old_version) -> ReadResult;
+
+  /**
+   * Drop every version no snapshot at or after `oldest` can see.
+   * @param oldest the read timestamp of the oldest active snapshot
+   * @return the tuples whose delete is now visible to everyone; their delete should be applied to the page
+   */
+  auto Collect(timestamp_t oldest) -> std::vector<RID>;
+
+  /** @return whether enough chains piled up since the last collection, and `oldest` moved since then */
+  auto NeedsCollect(timestamp_t oldest) -> bool;
+
+  /** @return the number of version chains */
+  auto Size() -> size_t { return chain_count_.load(); }
+
+ private:
+  /** A version replaced by a later write */
+  struct Version {
+    /** Commit timestamp the version became visible at, 0 if it is older than any snapshot */
+    timestamp_t ts_;
+    /** Whether the version is a delete, i.e. there was no tuple */
+    bool deleted_;
+    Tuple tuple_;
+  };
+
+  struct VersionChain {
+    /** The uncommitted writer of the page version, INVALID_TXN_ID once it committed */
+    txn_id_t writer_{INVALID_TXN_ID};
+    /** Commit timestamp of the page version */
+    timestamp_t ts_{0};
+    /** Whether the page version is a delete */
+    bool deleted_{false};
+    /** Replaced versions, newest at the back */
+    std::vector<Version> undo_;
+  };
+
+  std::shared_mutex latch_;
+  std::unordered_map<RID, VersionChain> chains_;
+  /** Mirrors chains_.size(), lets readers of an untouched table skip the latch */
+  std::atomic<size_t> chain_count_{0};
+  /** Collect again once there are this many chains */
+  size_t collect_at_{VERSION_GC_INTERVAL};
+  /** The oldest snapshot the last collection ran for */
+  timestamp_t collected_for_{0};
+};
+
+}  // namespace bustub
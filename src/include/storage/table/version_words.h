@@ -0,0 +1,65 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_words.h
+//
+// Identification: src/include/storage/table/version_words.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "common/rid.h"
+
+namespace bustub {
+
+/**
+ * VersionWords keeps a Silo-style version word for every tuple of one TableHeap that was ever written. Optimistic
+ * transactions record the word of each tuple they read and check at commit that it did not move.
+ *
+ * The low bits of a word count the writes to the tuple that committed or rolled back; a tuple never written has
+ * version 0. The top bit is a lock an optimistic transaction holds on the tuples it is about to write while it
+ * validates and installs. Words are not dropped while optimistic transactions run, not even when the slot is
+ * emptied, so a version never repeats for a RID within the life of a transaction that validates against it, and a
+ * slot that was deleted and reused cannot fool validation. Once no optimistic transaction runs, nobody holds a word
+ * any more and the transaction manager clears them all.
+ */
+class VersionWords {
+ public:
+  static constexpr uint64_t LOCK_BIT = uint64_t{1} << 63;
+
+  /** @return the version word of the tuple, lock bit included */
+  auto Get(const RID &rid) -> uint64_t;
+
+  /** A write to the tuple committed or rolled back, move its version on */
+  void Bump(const RID &rid);
+
+  /** Take the lock bit of the tuple, spinning while another transaction holds it */
+  void Lock(const RID &rid);
+
+  /** Release the lock bit of the tuple */
+  void Unlock(const RID &rid);
+
+  /** Drop every word, once no optimistic transaction can have read one */
+  void Clear();
+
+  /** @return the number of tuples with a word */
+  auto Size() -> size_t;
+
+ private:
+  /** @return the word of the tuple, created at version 0 if the tuple has none */
+  auto Word(const RID &rid) -> std::atomic<uint64_t> &;
+
+  std::shared_mutex latch_;
+  /** Nodes of the map never move, so a word can be used after the latch is released, until Clear() */
+  std::unordered_map<RID, std::atomic<uint64_t>> words_;
+};
+
+}  // namespace bustub
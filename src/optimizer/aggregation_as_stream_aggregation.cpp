@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "execution/expressions/column_value_expression.h"
+#include "execution/plans/aggregation_plan.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/merge_join_plan.h"
+#include "execution/plans/projection_plan.h"
+#include "execution/plans/sort_plan.h"
+#include "execution/plans/stream_aggregation_plan.h"
+#include "optimizer/optimizer.h"
+
+namespace bustub {
+
+auto Optimizer::OutputOrderColumns(const AbstractPlanNodeRef &plan) -> std::vector<std::pair<OrderByType, uint32_t>> {
+  std::vector<std::pair<OrderByType, uint32_t>> columns;
+  switch (plan->GetType()) {
+    case PlanType::Sort: {
+      // 只认列引用，遇到表达式就截断，前缀部分的有序性仍然成立。
+      for (const auto &[order_type, expr] : dynamic_cast<const SortPlanNode &>(*plan).GetOrderBy()) {
+        const auto *column_value_expr = dynamic_cast<const ColumnValueExpression *>(expr.get());
+        if (column_value_expr == nullptr) {
+          break;
+        }
+        columns.emplace_back(order_type, column_value_expr->GetColIdx());
+      }
+      break;
+    }
+    case PlanType::IndexScan: {
+      // 索引扫描按索引键升序输出，输出格式就是表的格式。
+      const auto *index_info = catalog_.GetIndex(dynamic_cast<const IndexScanPlanNode &>(*plan).GetIndexOid());
+      if (index_info != Catalog::NULL_INDEX_INFO) {
+        for (auto key_attr : index_info->index_->GetKeyAttrs()) {
+          columns.emplace_back(OrderByType::ASC, key_attr);
+        }
+      }
+      break;
+    }
+    case PlanType::MergeJoin: {
+      // merge join按左边的连接键升序输出，左边的列排在输出的最前面。
+      const auto &merge_join = dynamic_cast<const MergeJoinPlanNode &>(*plan);
+      const auto *column_value_expr = dynamic_cast<const ColumnValueExpression *>(&merge_join.LeftJoinKeyExpression());
+      if (column_value_expr != nullptr) {
+        columns.emplace_back(OrderByType::ASC, column_value_expr->GetColIdx());
+      }
+      break;
+    }
+    case PlanType::HashJoin:
+      // hash join拿左边探测，保持左边的顺序，左边的列也排在输出的最前面。
+      columns = OutputOrderColumns(plan->GetChildAt(0));
+      break;
+    case PlanType::Filter:
+      // filter不改变顺序和输出格式。
+      columns = OutputOrderColumns(plan->GetChildAt(0));
+      break;
+    case PlanType::Projection: {
+      // 把孩子的有序列换成它在投影输出里的位置；投影里找不到的列就截断。
+      const auto &exprs = dynamic_cast<const ProjectionPlanNode &>(*plan).GetExpressions();
+      for (const auto &order_column : OutputOrderColumns(plan->GetChildAt(0))) {
+        auto it = std::find_if(exprs.begin(), exprs.end(), [&order_column](const AbstractExpressionRef &expr) {
+          const auto *column_value_expr = dynamic_cast<const ColumnValueExpression *>(expr.get());
+          return column_value_expr != nullptr && column_value_expr->GetColIdx() == order_column.second;
+        });
+        if (it == exprs.end()) {
+          break;
+        }
+        columns.emplace_back(order_column.first, static_cast<uint32_t>(it - exprs.begin()));
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return columns;
+}
+
+auto Optimizer::OptimizeAggregationAsStreamAggregation(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(OptimizeAggregationAsStreamAggregation(child));
+  }
+  auto optimized_plan = plan->CloneWithChildren(std::move(children));
+
+  if (optimized_plan->GetType() != PlanType::Aggregation) {
+    return optimized_plan;
+  }
+  const auto &agg_plan = dynamic_cast<const AggregationPlanNode &>(*optimized_plan);
+  if (agg_plan.GetGroupBys().empty()) {
+    return optimized_plan;
+  }
+
+  // group by必须全是列引用。
+  std::set<uint32_t> group_columns;
+  for (const auto &expr : agg_plan.GetGroupBys()) {
+    const auto *column_value_expr = dynamic_cast<const ColumnValueExpression *>(expr.get());
+    if (column_value_expr == nullptr) {
+      return optimized_plan;
+    }
+    group_columns.insert(column_value_expr->GetColIdx());
+  }
+
+  // 孩子按 (c1, c2, ...) 升序时，只要group by的列恰好是某个前缀，同一组的行就一定是连续的。
+  auto order_columns = OutputOrderColumns(agg_plan.GetChildPlan());
+  if (order_columns.size() < group_columns.size()) {
+    return optimized_plan;
+  }
+  std::set<uint32_t> prefix;
+  for (size_t i = 0; i < group_columns.size(); i++) {
+    auto [order_type, column] = order_columns[i];
+    if (order_type != OrderByType::ASC && order_type != OrderByType::DEFAULT) {
+      return optimized_plan;
+    }
+    prefix.insert(column);
+  }
+  if (prefix != group_columns) {
+    return optimized_plan;
+  }
+
+  return std::make_shared<StreamAggregationPlanNode>(agg_plan.output_schema_, agg_plan.GetChildPlan(),
+                                                     agg_plan.GetGroupBys(), agg_plan.GetAggregates(),
+                                                     agg_plan.GetAggregateTypes());
+}
+
+}  // namespace bustub
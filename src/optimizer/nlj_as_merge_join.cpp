@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "binder/bound_order_by.h"
+#include "common/macros.h"
+#include "execution/expressions/column_value_expression.h"
+#include "execution/expressions/comparison_expression.h"
+#include "execution/plans/abstract_plan.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/merge_join_plan.h"
+#include "execution/plans/mock_scan_plan.h"
+#include "execution/plans/nested_loop_join_plan.h"
+#include "execution/plans/seq_scan_plan.h"
+#include "execution/plans/sort_plan.h"
+#include "optimizer/optimizer.h"
+
+namespace bustub {
+
+auto Optimizer::EstimatedPlanCardinality(const AbstractPlanNodeRef &plan) -> std::optional<size_t> {
+  switch (plan->GetType()) {
+    case PlanType::SeqScan:
+      return EstimatedCardinality(dynamic_cast<const SeqScanPlanNode &>(*plan).table_name_);
+    case PlanType::MockScan:
+      return EstimatedCardinality(dynamic_cast<const MockScanPlanNode &>(*plan).GetTable());
+    case PlanType::IndexScan: {
+      const auto *index_info = catalog_.GetIndex(dynamic_cast<const IndexScanPlanNode &>(*plan).GetIndexOid());
+      if (index_info == Catalog::NULL_INDEX_INFO) {
+        return std::nullopt;
+      }
+      return EstimatedCardinality(index_info->table_name_);
+    }
+    case PlanType::Filter:
+    case PlanType::Projection:
+    case PlanType::Sort:
+      // 只当作上界来用。
+      return EstimatedPlanCardinality(plan->GetChildAt(0));
+    case PlanType::NestedLoopJoin:
+    case PlanType::MergeJoin:
+    case PlanType::HashJoin: {
+      // 没有统计信息，按外键等值连接估计成较大的一边。
+      auto left = EstimatedPlanCardinality(plan->GetChildAt(0));
+      auto right = EstimatedPlanCardinality(plan->GetChildAt(1));
+      if (left == std::nullopt || right == std::nullopt) {
+        return std::nullopt;
+      }
+      return std::max(*left, *right);
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+auto Optimizer::OrderedOnColumn(const AbstractPlanNodeRef &plan, uint32_t col_idx) -> AbstractPlanNodeRef {
+  // merge join按升序推进两边的游标，降序的输入不算有序，交给调用方在上面补一个升序的sort。
+  auto order_columns = OutputOrderColumns(plan);
+  if (!order_columns.empty() && order_columns[0].second == col_idx &&
+      (order_columns[0].first == OrderByType::ASC || order_columns[0].first == OrderByType::DEFAULT)) {
+    return plan;
+  }
+  // 没带过滤条件的表扫描，如果这一列上有索引，换成索引扫描就天然有序。
+  if (plan->GetType() == PlanType::SeqScan) {
+    const auto &seq_scan = dynamic_cast<const SeqScanPlanNode &>(*plan);
+    if (seq_scan.filter_predicate_ == nullptr) {
+      if (auto index = MatchIndex(seq_scan.table_name_, col_idx); index != std::nullopt) {
+        return std::make_shared<IndexScanPlanNode>(seq_scan.output_schema_, std::get<0>(*index));
+      }
+    }
+  }
+  return nullptr;
+}
+
+auto Optimizer::OptimizeNLJAsMergeJoin(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(OptimizeNLJAsMergeJoin(child));
+  }
+  auto optimized_plan = plan->CloneWithChildren(std::move(children));
+
+  if (optimized_plan->GetType() != PlanType::NestedLoopJoin) {
+    return optimized_plan;
+  }
+  const auto &nlj_plan = dynamic_cast<const NestedLoopJoinPlanNode &>(*optimized_plan);
+  BUSTUB_ENSURE(nlj_plan.children_.size() == 2, "NLJ should have exactly 2 children.");
+  if (nlj_plan.GetJoinType() != JoinType::INNER && nlj_plan.GetJoinType() != JoinType::LEFT) {
+    return optimized_plan;
+  }
+
+  // 和hash join一样，只处理 <column_expr> = <column_expr>，且两边分别来自左右表。
+  const auto *expr = dynamic_cast<const ComparisonExpression *>(&nlj_plan.Predicate());
+  if (expr == nullptr || expr->comp_type_ != ComparisonType::Equal) {
+    return optimized_plan;
+  }
+  const auto *lhs = dynamic_cast<const ColumnValueExpression *>(expr->children_[0].get());
+  const auto *rhs = dynamic_cast<const ColumnValueExpression *>(expr->children_[1].get());
+  if (lhs == nullptr || rhs == nullptr || lhs->GetTupleIdx() == rhs->GetTupleIdx()) {
+    return optimized_plan;
+  }
+  if (lhs->GetTupleIdx() == 1) {
+    std::swap(lhs, rhs);
+  }
+  auto left_key = std::make_shared<ColumnValueExpression>(0, lhs->GetColIdx(), lhs->GetReturnType());
+  auto right_key = std::make_shared<ColumnValueExpression>(0, rhs->GetColIdx(), rhs->GetReturnType());
+
+  auto left = OrderedOnColumn(nlj_plan.GetLeftPlan(), lhs->GetColIdx());
+  auto right = OrderedOnColumn(nlj_plan.GetRightPlan(), rhs->GetColIdx());
+
+  if (left == nullptr || right == nullptr) {
+    // 至少有一边要排序，只有两边大小都能估计出来、而且排序比嵌套循环便宜时才做。
+    auto left_rows = EstimatedPlanCardinality(nlj_plan.GetLeftPlan());
+    auto right_rows = EstimatedPlanCardinality(nlj_plan.GetRightPlan());
+    if (left_rows == std::nullopt || right_rows == std::nullopt) {
+      return optimized_plan;
+    }
+    auto n = static_cast<double>(std::max<size_t>(*left_rows, 2));
+    auto m = static_cast<double>(std::max<size_t>(*right_rows, 2));
+    if (n * std::log2(n) + m * std::log2(m) + n + m >= n * m) {
+      return optimized_plan;
+    }
+    if (left == nullptr) {
+      left = std::make_shared<SortPlanNode>(nlj_plan.GetLeftPlan()->output_schema_, nlj_plan.GetLeftPlan(),
+                                            std::vector<std::pair<OrderByType, AbstractExpressionRef>>{
+                                                {OrderByType::ASC, left_key}});
+    }
+    if (right == nullptr) {
+      right = std::make_shared<SortPlanNode>(nlj_plan.GetRightPlan()->output_schema_, nlj_plan.GetRightPlan(),
+                                             std::vector<std::pair<OrderByType, AbstractExpressionRef>>{
+                                                 {OrderByType::ASC, right_key}});
+    }
+  }
+
+  return std::make_shared<MergeJoinPlanNode>(nlj_plan.output_schema_, std::move(left), std::move(right),
+                                             std::move(left_key), std::move(right_key), nlj_plan.GetJoinType());
+}
+
+}  // namespace bustub
@@ -11,10 +11,15 @@ auto Optimizer::OptimizeCustom(const AbstractPlanNodeRef &plan) -> AbstractPlanN
   auto p = plan;
   p = OptimizeMergeProjection(p);
   p = OptimizeMergeFilterNLJ(p);
+  p = OptimizeNLJAsMergeJoin(p);
   p = OptimizeNLJAsIndexJoin(p);
-  // p = OptimizeNLJAsHashJoin(p);  // Enable this rule after you have implemented hash join.
+  p = OptimizeNLJAsHashJoin(p);
   p = OptimizeOrderByAsIndexScan(p);
+  p = OptimizeAggregationAsStreamAggregation(p);
   p = OptimizeSortLimitAsTopN(p);
+  // 放在最后：前面的规则要看到不带过滤条件的SeqScan才会换成索引。
+  p = OptimizeMergeFilterScan(p);
+  p = OptimizeSeqScanAsIndexScan(p);
   return p;
 }
 
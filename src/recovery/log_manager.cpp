@@ -12,6 +12,8 @@
 
 #include "recovery/log_manager.h"
 
+#include "common/macros.h"
+
 namespace bustub {
 /*
  * set enable_logging = true
@@ -22,33 +24,288 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::scoped_lock lock(latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  running_ = true;
+  stop_ = false;
+  enable_logging = true;
+  flush_thread_ = new std::thread(&LogManager::FlushLoop, this);
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  {
+    std::scoped_lock lock(latch_);
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    stop_ = true;
+  }
+  flusher_cv_.notify_one();
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+  enable_logging = false;
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
  */
-auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t { return INVALID_LSN; }
+auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t {
+  auto size = static_cast<uint64_t>(log_record->size_);
+  BUSTUB_ASSERT(size <= static_cast<uint64_t>(LOG_BUFFER_SIZE), "log record does not fit in the log buffer");
+  while (true) {
+    auto generation = generation_.load();
+    // 一次fetch_add同时拿到LSN和缓冲区里的位置，之后各写各的，不用加锁。
+    auto state = state_.fetch_add(LSN_ONE + size);
+    auto offset = Offset(state);
+    if (offset + size <= static_cast<uint64_t>(LOG_BUFFER_SIZE)) {
+      log_record->lsn_ = Lsn(state);
+      SerializeLogRecord(*log_record, log_buffer_ + offset);
+      completed_.fetch_add(size, std::memory_order_release);
+      return log_record->lsn_;
+    }
+    if (offset <= static_cast<uint64_t>(LOG_BUFFER_SIZE)) {
+      // 第一个放不下的负责封口；这次拿到的LSN作废，换到新缓冲区再拿。
+      SealBuffer(state, false);
+    } else {
+      std::unique_lock lock(latch_);
+      cv_.wait(lock, [&] { return generation_ != generation; });
+    }
+  }
+}
+
+void LogManager::Flush(lsn_t lsn) {
+  std::unique_lock lock(latch_);
+  lsn = std::min(lsn, GetNextLSN() - 1);
+  while (persistent_lsn_ < lsn) {
+    if (running_) {
+      flush_requested_ = true;
+      flusher_cv_.notify_one();
+      cv_.wait(lock);
+      continue;
+    }
+    // 没有刷盘线程就自己封口写下去。别人正在封口的话，它会把缓冲区写完，等它换了缓冲区再看，不要空转。
+    auto generation = generation_.load();
+    lock.unlock();
+    bool sealed = SealCurrentBuffer(false);
+    lock.lock();
+    if (!sealed) {
+      cv_.wait(lock, [&] { return generation_ != generation || persistent_lsn_ >= lsn || running_; });
+    }
+  }
+}
+
+void LogManager::WaitForFlush(lsn_t lsn) {
+  std::unique_lock lock(latch_);
+  if (persistent_lsn_ >= lsn) {
+    return;
+  }
+  if (!running_) {
+    lock.unlock();
+    Flush(lsn);
+    return;
+  }
+  // 没有别人在等的话从现在开始攒一组。
+  if (commit_lsn_ <= persistent_lsn_) {
+    group_since_ = Clock::now();
+    flusher_cv_.notify_one();
+  }
+  commit_lsn_ = std::max(commit_lsn_, lsn);
+  group_size_++;
+  if (Offset(state_.load()) >= static_cast<uint64_t>(GROUP_COMMIT_SIZE) && !flush_requested_) {
+    flush_requested_ = true;
+    flusher_cv_.notify_one();
+  }
+  cv_.wait(lock, [&] { return persistent_lsn_ >= lsn; });
+}
+
+void LogManager::ScheduleFlush(lsn_t lsn) {
+  std::scoped_lock lock(latch_);
+  if (persistent_lsn_ >= lsn || !running_) {
+    return;
+  }
+  // 最早一个没落盘的异步提交定下期限，后来的搭同一趟。
+  if (async_lsn_ <= persistent_lsn_) {
+    async_since_ = Clock::now();
+    flusher_cv_.notify_one();
+  }
+  async_lsn_ = std::max(async_lsn_, lsn);
+}
+
+void LogManager::SerializeLogRecord(const LogRecord &log_record, char *dst) {
+  // 头部20字节：size, lsn, txn_id, prev_lsn, type。
+  memcpy(dst, &log_record, LogRecord::HEADER_SIZE);
+  auto *pos = dst + LogRecord::HEADER_SIZE;
+  switch (log_record.log_record_type_) {
+    case LogRecordType::INSERT:
+      memcpy(pos, &log_record.insert_rid_, sizeof(RID));
+      log_record.insert_tuple_.SerializeTo(pos + sizeof(RID));
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(pos, &log_record.delete_rid_, sizeof(RID));
+      log_record.delete_tuple_.SerializeTo(pos + sizeof(RID));
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(pos, &log_record.update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record.old_tuple_.SerializeTo(pos);
+      pos += sizeof(int32_t) + log_record.old_tuple_.GetLength();
+      log_record.new_tuple_.SerializeTo(pos);
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(pos, &log_record.prev_page_id_, sizeof(page_id_t));
+      memcpy(pos + sizeof(page_id_t), &log_record.page_id_, sizeof(page_id_t));
+      break;
+    case LogRecordType::INSERTPAGE: {
+      memcpy(pos, &log_record.page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      auto tuple_count = static_cast<int32_t>(log_record.page_tuples_.size());
+      memcpy(pos, &tuple_count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &tuple : log_record.page_tuples_) {
+        tuple.SerializeTo(pos);
+        pos += sizeof(int32_t) + tuple.GetLength();
+      }
+      break;
+    }
+    case LogRecordType::CHECKPOINT: {
+      memcpy(pos, &log_record.begin_lsn_, sizeof(lsn_t));
+      pos += sizeof(lsn_t);
+      auto txn_count = static_cast<int32_t>(log_record.active_txns_.size());
+      memcpy(pos, &txn_count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &[txn_id, last_lsn] : log_record.active_txns_) {
+        memcpy(pos, &txn_id, sizeof(txn_id_t));
+        memcpy(pos + sizeof(txn_id_t), &last_lsn, sizeof(lsn_t));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      auto page_count = static_cast<int32_t>(log_record.dirty_pages_.size());
+      memcpy(pos, &page_count, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &[page_id, rec_lsn] : log_record.dirty_pages_) {
+        memcpy(pos, &page_id, sizeof(page_id_t));
+        memcpy(pos + sizeof(page_id_t), &rec_lsn, sizeof(lsn_t));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void LogManager::SealBuffer(uint64_t state, bool is_flusher) {
+  auto end = Offset(state);
+  // 排在前面的人都写完了才能换，最多等一次memcpy。
+  while (completed_.load(std::memory_order_acquire) != end) {
+    std::this_thread::yield();
+  }
+
+  std::unique_lock lock(latch_);
+  while (flush_pending_) {
+    if (is_flusher) {
+      WriteFlushBuffer(&lock);
+    } else {
+      cv_.wait(lock);
+    }
+  }
+  std::swap(log_buffer_, flush_buffer_);
+  flush_size_ = end;
+  flush_lsn_ = Lsn(state) - 1;
+  flush_pending_ = true;
+  completed_ = 0;
+  // 封口之后又有人fetch_add过，LSN要保留他们用掉的，位置清零。
+  auto current = state_.load();
+  while (!state_.compare_exchange_weak(current, current & ~OFFSET_MASK)) {
+  }
+  generation_++;
+  if (is_flusher || !running_) {
+    WriteFlushBuffer(&lock);
+  } else {
+    flusher_cv_.notify_one();
+  }
+  cv_.notify_all();
+}
+
+auto LogManager::SealCurrentBuffer(bool is_flusher) -> bool {
+  auto state = state_.fetch_add(LOG_BUFFER_SIZE + 1);
+  if (Offset(state) > static_cast<uint64_t>(LOG_BUFFER_SIZE)) {
+    return false;
+  }
+  SealBuffer(state, is_flusher);
+  return true;
+}
+
+void LogManager::WriteFlushBuffer(std::unique_lock<std::mutex> *lock) {
+  auto size = flush_size_;
+  auto lsn = flush_lsn_;
+  // 写盘的时候不拿锁，写的人继续往另一块缓冲区里追加。
+  lock->unlock();
+  auto start = Clock::now();
+  disk_manager_->WriteLog(flush_buffer_, static_cast<int>(size));
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+  lock->lock();
+  if (size > 0) {
+    write_time_ = (write_time_ * 7 + elapsed) / 8;
+  }
+  persistent_lsn_ = std::max(persistent_lsn_.load(), lsn);
+  flush_pending_ = false;
+  if (commit_lsn_ > persistent_lsn_) {
+    // 这次没盖住的提交另起一组。
+    group_since_ = Clock::now();
+  }
+  cv_.notify_all();
+}
+
+void LogManager::FlushLoop() {
+  std::unique_lock lock(latch_);
+  while (true) {
+    Clock::time_point idle_deadline = Clock::now() + log_timeout;
+    while (!flush_pending_ && !flush_requested_ && !stop_) {
+      // 有提交在等就按组提交的窗口算，否则按log_timeout。
+      auto deadline = idle_deadline;
+      if (commit_lsn_ > persistent_lsn_) {
+        deadline = std::min(deadline, group_since_ + group_window_);
+      }
+      if (async_lsn_ > persistent_lsn_) {
+        deadline = std::min(deadline, async_since_ + async_commit_delay);
+      }
+      if (Clock::now() >= deadline) {
+        break;
+      }
+      flusher_cv_.wait_until(lock, deadline);
+    }
+    if (flush_pending_) {
+      WriteFlushBuffer(&lock);
+      continue;
+    }
+    // 超时、组提交到点、有人等着落盘或者要停了：没写满的缓冲区也封口写下去。
+    flush_requested_ = false;
+    if (Offset(state_.load()) != 0) {
+      // 上一组不止一个人的话，下一组多等一次写盘的时间让更多提交跟上；只有一个人就不等。
+      auto max_window = std::chrono::duration_cast<std::chrono::microseconds>(log_timeout);
+      group_window_ = group_size_ > 1 ? std::min(write_time_, max_window) : std::chrono::microseconds(0);
+      group_size_ = 0;
+      lock.unlock();
+      SealCurrentBuffer(true);
+      lock.lock();
+      continue;
+    }
+    if (stop_) {
+      running_ = false;
+      return;
+    }
+  }
+}
 
 }  // namespace bustub
@@ -12,15 +12,109 @@
 
 #include "recovery/log_recovery.h"
 
+#include <atomic>
+#include <thread>  // NOLINT
+
 #include "storage/page/table_page.h"
 
 namespace bustub {
+
+namespace {
+
+/** Page changes the reader collects for one redo worker before handing them over */
+constexpr size_t REDO_BATCH_SIZE = 64;
+
+}  // namespace
+
 /*
  * deserialize a log record from log buffer
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool { return false; }
+auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool {
+  if (!DeserializeLogHeader(data, log_record)) {
+    return false;
+  }
+  DeserializeLogBody(data, log_record);
+  return true;
+}
+
+auto LogRecovery::DeserializeLogHeader(const char *data, LogRecord *log_record) -> bool {
+  memcpy(&log_record->size_, data, sizeof(int32_t));
+  memcpy(&log_record->lsn_, data + 4, sizeof(lsn_t));
+  memcpy(&log_record->txn_id_, data + 8, sizeof(txn_id_t));
+  memcpy(&log_record->prev_lsn_, data + 12, sizeof(lsn_t));
+  memcpy(&log_record->log_record_type_, data + 16, sizeof(LogRecordType));
+  // 日志文件尾部是补的零，读到这里就结束了。
+  return log_record->size_ >= LogRecord::HEADER_SIZE && log_record->size_ <= LOG_BUFFER_SIZE && log_record->lsn_ >= 0 &&
+         log_record->log_record_type_ > LogRecordType::INVALID &&
+         log_record->log_record_type_ <= LogRecordType::CHECKPOINT;
+}
+
+void LogRecovery::DeserializeLogBody(const char *data, LogRecord *log_record) {
+  const char *pos = data + LogRecord::HEADER_SIZE;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      memcpy(&log_record->insert_rid_, pos, sizeof(RID));
+      log_record->insert_tuple_.DeserializeFrom(pos + sizeof(RID));
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(&log_record->delete_rid_, pos, sizeof(RID));
+      log_record->delete_tuple_.DeserializeFrom(pos + sizeof(RID));
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(&log_record->update_rid_, pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.DeserializeFrom(pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.DeserializeFrom(pos);
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(&log_record->prev_page_id_, pos, sizeof(page_id_t));
+      memcpy(&log_record->page_id_, pos + sizeof(page_id_t), sizeof(page_id_t));
+      break;
+    case LogRecordType::INSERTPAGE: {
+      memcpy(&log_record->page_id_, pos, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      int32_t tuple_count;
+      memcpy(&tuple_count, pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      log_record->page_tuples_.resize(tuple_count);
+      for (auto &tuple : log_record->page_tuples_) {
+        tuple.DeserializeFrom(pos);
+        pos += sizeof(int32_t) + tuple.GetLength();
+      }
+      break;
+    }
+    case LogRecordType::CHECKPOINT: {
+      memcpy(&log_record->begin_lsn_, pos, sizeof(lsn_t));
+      pos += sizeof(lsn_t);
+      int32_t txn_count;
+      memcpy(&txn_count, pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      log_record->active_txns_.resize(txn_count);
+      for (auto &[txn_id, last_lsn] : log_record->active_txns_) {
+        memcpy(&txn_id, pos, sizeof(txn_id_t));
+        memcpy(&last_lsn, pos + sizeof(txn_id_t), sizeof(lsn_t));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      int32_t page_count;
+      memcpy(&page_count, pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      log_record->dirty_pages_.resize(page_count);
+      for (auto &[page_id, rec_lsn] : log_record->dirty_pages_) {
+        memcpy(&page_id, pos, sizeof(page_id_t));
+        memcpy(&rec_lsn, pos + sizeof(page_id_t), sizeof(lsn_t));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
@@ -29,12 +123,345 @@ auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  // 分析：只看记录头，从头扫一遍建active_txn_和lsn_mapping_，顺便找最后一个检查点。
+  lsn_t redo_lsn = 0;
+  ScanLog(0, true, [&](LogRecord *record, int offset) {
+    lsn_mapping_[record->lsn_] = offset;
+    if (record->txn_id_ != INVALID_TXN_ID) {
+      if (record->log_record_type_ == LogRecordType::COMMIT || record->log_record_type_ == LogRecordType::ABORT) {
+        active_txn_.erase(record->txn_id_);
+      } else {
+        active_txn_[record->txn_id_] = record->lsn_;
+      }
+    }
+    if (record->log_record_type_ == LogRecordType::CHECKPOINT) {
+      redo_lsn = record->begin_lsn_;
+      for (const auto &[page_id, rec_lsn] : record->dirty_pages_) {
+        redo_lsn = std::min(redo_lsn, rec_lsn);
+      }
+    }
+  });
+  if (lsn_mapping_.empty()) {
+    return;
+  }
+  // 换缓冲区时会跳过LSN，从不小于redo_lsn的第一条开始；检查点自己就在后面，一定找得到。
+  while (redo_lsn > 0 && lsn_mapping_.count(redo_lsn) == 0) {
+    redo_lsn++;
+  }
+  int redo_offset = redo_lsn > 0 ? lsn_mapping_[redo_lsn] : 0;
+
+  std::vector<RedoQueue> queues(RECOVERY_WORKERS);
+  std::vector<std::vector<RedoTask>> pending(RECOVERY_WORKERS);
+  std::vector<std::thread> workers;
+  for (auto &queue : queues) {
+    workers.emplace_back(&LogRecovery::RunRedoWorker, this, &queue);
+  }
+  auto hand_over = [&](size_t worker) {
+    auto &queue = queues[worker];
+    {
+      std::scoped_lock lock(queue.latch_);
+      queue.batches_.push_back(std::move(pending[worker]));
+    }
+    queue.cv_.notify_one();
+    pending[worker].clear();
+  };
+  auto dispatch = [&](page_id_t page_id, RedoTask task) {
+    // 同一页总是交给同一个worker，页内按日志顺序重做。
+    auto worker = static_cast<size_t>(page_id) % RECOVERY_WORKERS;
+    pending[worker].push_back(std::move(task));
+    if (pending[worker].size() >= REDO_BATCH_SIZE) {
+      hand_over(worker);
+    }
+  };
+
+  ScanLog(redo_offset, false, [&](LogRecord *log_record, int /*offset*/) {
+    RedoTask task{std::move(*log_record)};
+    auto &record = task.record_;
+    switch (record.log_record_type_) {
+      case LogRecordType::INSERT:
+        dispatch(record.insert_rid_.GetPageId(), std::move(task));
+        break;
+      case LogRecordType::MARKDELETE:
+      case LogRecordType::APPLYDELETE:
+      case LogRecordType::ROLLBACKDELETE:
+        dispatch(record.delete_rid_.GetPageId(), std::move(task));
+        break;
+      case LogRecordType::UPDATE:
+        dispatch(record.update_rid_.GetPageId(), std::move(task));
+        break;
+      case LogRecordType::NEWPAGE:
+        if (record.prev_page_id_ != INVALID_PAGE_ID) {
+          dispatch(record.prev_page_id_, RedoTask{record, true});
+        }
+        dispatch(record.page_id_, std::move(task));
+        break;
+      case LogRecordType::INSERTPAGE:
+        dispatch(record.page_id_, std::move(task));
+        break;
+      default:
+        break;
+    }
+  });
+
+  for (size_t i = 0; i < RECOVERY_WORKERS; i++) {
+    if (!pending[i].empty()) {
+      hand_over(i);
+    }
+    std::scoped_lock lock(queues[i].latch_);
+    queues[i].closed_ = true;
+    queues[i].cv_.notify_one();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LogRecovery::ScanLog(int offset, bool header_only, const std::function<void(LogRecord *, int)> &visit) {
+  offset_ = offset;
+  int filled = 0;
+  int pos = 0;
+  while (true) {
+    int32_t size = 0;
+    if (filled - pos >= static_cast<int>(sizeof(int32_t))) {
+      memcpy(&size, log_buffer_ + pos, sizeof(int32_t));
+    }
+    if (filled - pos < LogRecord::HEADER_SIZE || (size <= LOG_BUFFER_SIZE && filled - pos < size)) {
+      // 剩下半条记录，挪到缓冲区开头再接着读。
+      memmove(log_buffer_, log_buffer_ + pos, filled - pos);
+      offset_ += pos;
+      filled -= pos;
+      pos = 0;
+      if (!disk_manager_->ReadLog(log_buffer_ + filled, LOG_BUFFER_SIZE - filled, offset_ + filled)) {
+        break;
+      }
+      filled = LOG_BUFFER_SIZE;
+      continue;
+    }
+
+    LogRecord record;
+    if (!DeserializeLogHeader(log_buffer_ + pos, &record)) {
+      break;
+    }
+    if (!header_only || record.log_record_type_ == LogRecordType::CHECKPOINT) {
+      DeserializeLogBody(log_buffer_ + pos, &record);
+    }
+    visit(&record, offset_ + pos);
+    pos += record.size_;
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  std::vector<lsn_t> losers;
+  losers.reserve(active_txn_.size());
+  for (const auto &[txn_id, last_lsn] : active_txn_) {
+    losers.push_back(last_lsn);
+  }
+  // 输家事务各改各的tuple，分给几个线程各自回滚。
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < std::min(RECOVERY_WORKERS, losers.size()); i++) {
+    workers.emplace_back([&] {
+      std::vector<char> buffer(LOG_BUFFER_SIZE);
+      for (auto j = next++; j < losers.size(); j = next++) {
+        UndoTransaction(losers[j], buffer.data());
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  active_txn_.clear();
+  lsn_mapping_.clear();
+}
+
+void LogRecovery::RunRedoWorker(RedoQueue *queue) {
+  while (true) {
+    std::vector<RedoTask> batch;
+    {
+      std::unique_lock lock(queue->latch_);
+      queue->cv_.wait(lock, [queue] { return queue->closed_ || !queue->batches_.empty(); });
+      if (queue->batches_.empty()) {
+        return;
+      }
+      batch = std::move(queue->batches_.front());
+      queue->batches_.pop_front();
+    }
+    for (auto &task : batch) {
+      RedoPage(&task);
+    }
+  }
+}
+
+void LogRecovery::RedoPage(RedoTask *task) {
+  auto &record = task->record_;
+  page_id_t page_id;
+  switch (record.log_record_type_) {
+    case LogRecordType::INSERT:
+      page_id = record.insert_rid_.GetPageId();
+      break;
+    case LogRecordType::UPDATE:
+      page_id = record.update_rid_.GetPageId();
+      break;
+    case LogRecordType::NEWPAGE:
+      page_id = task->link_ ? record.prev_page_id_ : record.page_id_;
+      break;
+    case LogRecordType::INSERTPAGE:
+      page_id = record.page_id_;
+      break;
+    default:
+      page_id = record.delete_rid_.GetPageId();
+      break;
+  }
+  auto *page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "Redo needs a free frame for every worker.");
+  page->WLatch();
+
+  bool dirty = false;
+  if (task->link_) {
+    // 链表指针不带LSN，直接看是不是已经指过去了。
+    if (page->GetNextPageId() != record.page_id_) {
+      page->SetNextPageId(record.page_id_);
+      dirty = true;
+    }
+  } else if (page->GetLSN() < record.lsn_) {
+    RID rid;
+    Tuple old_tuple;
+    std::vector<RID> rids;
+    switch (record.log_record_type_) {
+      case LogRecordType::INSERT:
+        // 页上的状态和当初一样，挑到的槽也一样。
+        page->InsertTuple(record.insert_tuple_, &rid, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::MARKDELETE:
+        page->MarkDelete(record.delete_rid_, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::APPLYDELETE:
+        page->ApplyDelete(record.delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::ROLLBACKDELETE:
+        page->RollbackDelete(record.delete_rid_, nullptr, nullptr);
+        break;
+      case LogRecordType::UPDATE:
+        page->UpdateTuple(record.new_tuple_, &old_tuple, record.update_rid_, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::NEWPAGE:
+        page->Init(page_id, BUSTUB_PAGE_SIZE, record.prev_page_id_, nullptr, nullptr);
+        break;
+      case LogRecordType::INSERTPAGE:
+        page->AppendTuples(record.page_tuples_, 0, &rids);
+        break;
+      default:
+        break;
+    }
+    page->SetLSN(record.lsn_);
+    dirty = true;
+  }
+
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, dirty);
+}
+
+void LogRecovery::UndoTransaction(lsn_t last_lsn, char *buffer) {
+  std::unordered_set<RID> lost_slots;
+  for (auto lsn = last_lsn; lsn != INVALID_LSN;) {
+    LogRecord log_record;
+    if (!ReadLogRecord(lsn, buffer, &log_record)) {
+      break;
+    }
+    UndoPage(&log_record, &lost_slots);
+    lsn = log_record.prev_lsn_;
+  }
+}
+
+void LogRecovery::UndoPage(LogRecord *log_record, std::unordered_set<RID> *lost_slots) {
+  page_id_t page_id;
+  RID rid;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      rid = log_record->insert_rid_;
+      page_id = rid.GetPageId();
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      rid = log_record->delete_rid_;
+      page_id = rid.GetPageId();
+      break;
+    case LogRecordType::UPDATE:
+      rid = log_record->update_rid_;
+      page_id = rid.GetPageId();
+      break;
+    case LogRecordType::INSERTPAGE:
+      page_id = log_record->page_id_;
+      break;
+    default:
+      // BEGIN没什么要撤的；新页留在链表上当空页用。
+      return;
+  }
+  // 槽已经归了别的事务，这一行更早的修改也不能再撤到别人的tuple上。
+  if (lost_slots->count(rid) > 0) {
+    return;
+  }
+  auto *page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "Undo needs a free frame for every worker.");
+  page->WLatch();
+
+  Tuple old_tuple;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      page->ApplyDelete(log_record->insert_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::MARKDELETE:
+      page->RollbackDelete(log_record->delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      // 放回原来的槽，不能随便找个空槽：更早的记录还要按原来的RID撤。
+      if (!page->RestoreTuple(log_record->delete_rid_, log_record->delete_tuple_)) {
+        lost_slots->insert(log_record->delete_rid_);
+      }
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->MarkDelete(log_record->delete_rid_, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE:
+      page->UpdateTuple(log_record->old_tuple_, &old_tuple, log_record->update_rid_, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::INSERTPAGE:
+      for (auto i = log_record->page_tuples_.size(); i > 0; i--) {
+        page->ApplyDelete(RID(page_id, i - 1), nullptr, nullptr);
+      }
+      break;
+    default:
+      break;
+  }
+
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+auto LogRecovery::ReadLogRecord(lsn_t lsn, char *buffer, LogRecord *log_record) -> bool {
+  auto it = lsn_mapping_.find(lsn);
+  if (it == lsn_mapping_.end()) {
+    return false;
+  }
+  {
+    std::scoped_lock lock(log_latch_);
+    if (!disk_manager_->ReadLog(buffer, LogRecord::HEADER_SIZE, it->second)) {
+      return false;
+    }
+    int32_t size;
+    memcpy(&size, buffer, sizeof(int32_t));
+    if (size < LogRecord::HEADER_SIZE || size > LOG_BUFFER_SIZE ||
+        !disk_manager_->ReadLog(buffer, size, it->second)) {
+      return false;
+    }
+  }
+  return DeserializeLogRecord(buffer, log_record);
+}
 
 }  // namespace bustub
@@ -638,6 +638,50 @@ auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
   buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
   return false;
 }
+
+/*
+ * 批量点查询，keys必须升序。
+ * 后一个键只要不超过当前叶子的最大键，就一定落在这个叶子里，不用再从根往下找。
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::GetValues(const std::vector<KeyType> &keys, std::vector<std::pair<size_t, ValueType>> *result,
+                               Transaction *transaction) {
+  std::shared_lock<std::shared_mutex> lock(latch_);
+  // 一批键可能全被外层过滤掉（比如都是NULL），这时一页也不用取。
+  if (IsEmpty() || keys.empty()) {
+    return;
+  }
+
+  LeafPage *leaf_page = nullptr;
+  for (size_t k = 0; k < keys.size(); ++k) {
+    const auto &key = keys[k];
+    if (leaf_page == nullptr || leaf_page->GetSize() == 0 ||
+        comparator_(key, leaf_page->KeyAt(leaf_page->GetSize() - 1)) > 0) {
+      if (leaf_page != nullptr) {
+        buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+      }
+
+      InternalPage *cur_internal_page = FetchInternalPage(root_page_id_);
+      while (!cur_internal_page->IsLeafPage()) {
+        auto *cur_array = cur_internal_page->GetArray();
+        int i = UpperBound(cur_array + 1, cur_array + cur_internal_page->GetSize(), key) - cur_array - 1;
+        auto tmp = static_cast<page_id_t>(cur_internal_page->ValueAt(i));
+        buffer_pool_manager_->UnpinPage(cur_internal_page->GetPageId(), false);
+        cur_internal_page = FetchInternalPage(tmp);
+      }
+      leaf_page = reinterpret_cast<LeafPage *>(cur_internal_page);
+    }
+
+    auto *leaf_array = leaf_page->GetArray();
+    int i = LowerBound(leaf_array, leaf_array + leaf_page->GetSize(), key) - leaf_array;
+    if (i < leaf_page->GetSize() && comparator_(leaf_page->KeyAt(i), key) == 0) {
+      result->emplace_back(k, leaf_page->ValueAt(i));
+    }
+  }
+
+  buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
@@ -852,19 +896,20 @@ auto BPLUSTREE_TYPE::Begin(const KeyType &key) -> INDEXITERATOR_TYPE {
 
   cur_internal_page = nullptr;
 
-  // 寻找位置，
+  // 寻找位置，停在第一个不小于key的键上，范围扫描从这里开始。
   auto *leaf_array = leaf_page->GetArray();
   i = LowerBound(leaf_array, leaf_array + leaf_page->GetSize(), key) - leaf_array;
 
-  // 如果等于，返回false。
-  if (i >= 0 && i < leaf_page->GetSize() && comparator_(key, leaf_page->KeyAt(i)) == 0) {
+  if (i < leaf_page->GetSize()) {
     INDEXITERATOR_TYPE tmp(leaf_page->GetPageId(), i, buffer_pool_manager_);
     buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
     return tmp;
   }
 
+  // 这个叶子里的键都比key小，那就是下一个叶子的第一个键。
+  page_id_t next_page_id = leaf_page->GetNextPageId();
   buffer_pool_manager_->UnpinPage(leaf_page->GetPageId(), false);
-  return End();
+  return INDEXITERATOR_TYPE(next_page_id, 0, buffer_pool_manager_);
 }
 
 /*
@@ -16,17 +16,33 @@
 
 namespace bustub {
 
+namespace {
+
+/**
+ * Append a change to a table page to the log, chain it into the transaction's records and stamp the page with its
+ * LSN. Garbage collection deletes tuples without a transaction; its records belong to none and are only ever redone.
+ */
+template <typename... Args>
+void LogChange(TablePage *page, Transaction *txn, LogManager *log_manager, LogRecordType type, const Args &...args) {
+  txn_id_t txn_id = txn == nullptr ? INVALID_TXN_ID : txn->GetTransactionId();
+  lsn_t prev_lsn = txn == nullptr ? INVALID_LSN : txn->GetPrevLSN();
+  LogRecord log_record(txn_id, prev_lsn, type, args...);
+  lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+  page->SetLSN(lsn);
+  if (txn != nullptr) {
+    txn->SetPrevLSN(lsn);
+  }
+}
+
+}  // namespace
+
 void TablePage::Init(page_id_t page_id, uint32_t page_size, page_id_t prev_page_id, LogManager *log_manager,
                      Transaction *txn) {
   // Set the page ID.
   memcpy(GetData(), &page_id, sizeof(page_id));
   // Log that we are creating a new page.
   if (enable_logging) {
-    LogRecord log_record =
-        LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::NEWPAGE, prev_page_id, page_id);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    LogChange(this, txn, log_manager, LogRecordType::NEWPAGE, prev_page_id, page_id);
   }
   // Set the previous and next page IDs.
   SetPrevPageId(prev_page_id);
@@ -71,24 +87,63 @@ auto TablePage::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, Lock
     SetTupleCount(GetTupleCount() + 1);
   }
 
-  /**
-   * Removed to support new lock manager API for p4 (multilevel locking); Big hack energy
-   * This clause was used in logging and recovery projects previously; not being used right now
-   */
-  //  // Write the log record.
-  //  if (enable_logging) {
-  //    BUSTUB_ASSERT(!txn->IsSharedLocked(*rid) && !txn->IsExclusiveLocked(*rid), "A new tuple should not be locked.");
-  //    // Acquire an exclusive lock on the new tuple.
-  //    bool locked = lock_manager->LockExclusive(txn, *rid);
-  //    BUSTUB_ENSURE(locked, "Locking a new tuple should always work.");
-  //    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::INSERT, *rid, tuple);
-  //    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-  //    SetLSN(lsn);
-  //    txn->SetPrevLSN(lsn);
-  //  }
+  // Write the log record. The executors take the locks, so only the record is written here.
+  if (enable_logging) {
+    LogChange(this, txn, log_manager, LogRecordType::INSERT, *rid, tuple);
+  }
+  return true;
+}
+
+auto TablePage::RestoreTuple(const RID &rid, const Tuple &tuple) -> bool {
+  BUSTUB_ASSERT(tuple.size_ > 0, "Cannot have empty tuples.");
+  uint32_t slot_num = rid.GetSlotNum();
+  uint32_t tuple_count = GetTupleCount();
+  if (slot_num < tuple_count && GetTupleSize(slot_num) != 0) {
+    return false;
+  }
+  // 槽数组只会变长，一般槽还在；不在的话把中间的槽当空槽补上。
+  uint32_t new_slots = slot_num < tuple_count ? 0 : slot_num + 1 - tuple_count;
+  if (GetFreeSpaceRemaining() < tuple.size_ + SIZE_TUPLE * new_slots) {
+    return false;
+  }
+  for (uint32_t i = tuple_count; i < slot_num; i++) {
+    SetTupleOffsetAtSlot(i, 0);
+    SetTupleSize(i, 0);
+  }
+  if (new_slots > 0) {
+    SetTupleCount(slot_num + 1);
+  }
+
+  SetFreeSpacePointer(GetFreeSpacePointer() - tuple.size_);
+  memcpy(GetData() + GetFreeSpacePointer(), tuple.data_, tuple.size_);
+  SetTupleOffsetAtSlot(slot_num, GetFreeSpacePointer());
+  SetTupleSize(slot_num, SetDeletedFlag(tuple.size_));
   return true;
 }
 
+auto TablePage::AppendTuples(const std::vector<Tuple> &tuples, size_t begin, std::vector<RID> *rids) -> size_t {
+  // 新页没有空出来的槽，直接往后追加，不用每插一个都从头找一遍槽。
+  size_t i = begin;
+  uint32_t free_space_pointer = GetFreeSpacePointer();
+  uint32_t tuple_count = GetTupleCount();
+  for (; i < tuples.size(); i++) {
+    const auto &tuple = tuples[i];
+    BUSTUB_ASSERT(tuple.size_ > 0, "Cannot have empty tuples.");
+    if (free_space_pointer - SIZE_TABLE_PAGE_HEADER - SIZE_TUPLE * tuple_count < tuple.size_ + SIZE_TUPLE) {
+      break;
+    }
+    free_space_pointer -= tuple.size_;
+    memcpy(GetData() + free_space_pointer, tuple.data_, tuple.size_);
+    SetTupleOffsetAtSlot(tuple_count, free_space_pointer);
+    SetTupleSize(tuple_count, tuple.size_);
+    rids->emplace_back(GetTablePageId(), tuple_count);
+    tuple_count++;
+  }
+  SetFreeSpacePointer(free_space_pointer);
+  SetTupleCount(tuple_count);
+  return i - begin;
+}
+
 auto TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager)
     -> bool {
   uint32_t slot_num = rid.GetSlotNum();
@@ -109,25 +164,10 @@ auto TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_m
     return false;
   }
 
-  /**
-   * Removed to support new lock manager API for p4 (multilevel locking); Big hack energy
-   * This clause was used in logging and recovery projects previously; not being used right now
-   */
-  //  if (enable_logging) {
-  //    // Acquire an exclusive lock, upgrading from a shared lock if necessary.
-  //    if (txn->IsSharedLocked(rid)) {
-  //      if (!lock_manager->LockUpgrade(txn, rid)) {
-  //        return false;
-  //      }
-  //    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
-  //      return false;
-  //    }
-  //    Tuple dummy_tuple;
-  //    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::MARKDELETE, rid, dummy_tuple);
-  //    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-  //    SetLSN(lsn);
-  //    txn->SetPrevLSN(lsn);
-  //  }
+  // Write the log record.
+  if (enable_logging) {
+    LogChange(this, txn, log_manager, LogRecordType::MARKDELETE, rid, Tuple());
+  }
 
   // Mark the tuple as deleted.
   if (tuple_size > 0) {
@@ -171,22 +211,10 @@ auto TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
   old_tuple->rid_ = rid;
   old_tuple->allocated_ = true;
 
-  /**
-   * Removed to support new lock manager API for p4 (multilevel locking); Big hack energy
-   * This clause was used in logging and recovery projects previously; not being used right now
-   */
-  //  if (enable_logging) {
-  //    // Acquire an exclusive lock, upgrading from shared if necessary.
-  //    if (txn->IsSharedLocked(rid)) {
-  //      if (!lock_manager->LockUpgrade(txn, rid)) {
-  //        return false;
-  //      }
-  //    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
-  //      return false;
-  //    }
-  //    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple,
-  //    new_tuple); lsn_t lsn = log_manager->AppendLogRecord(&log_record); SetLSN(lsn); txn->SetPrevLSN(lsn);
-  //  }
+  // Write the log record.
+  if (enable_logging) {
+    LogChange(this, txn, log_manager, LogRecordType::UPDATE, rid, *old_tuple, new_tuple);
+  }
 
   // Perform the update.
   uint32_t free_space_pointer = GetFreeSpacePointer();
@@ -228,18 +256,10 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
   delete_tuple.rid_ = rid;
   delete_tuple.allocated_ = true;
 
-  /**
-   * Removed to support new lock manager API for p4 (multilevel locking); Big hack energy
-   * This clause was used in logging and recovery projects previously; not being used right now
-   */
-  //  if (enable_logging) {
-  //    BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own the exclusive lock!");
-  //
-  //    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::APPLYDELETE, rid, delete_tuple);
-  //    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-  //    SetLSN(lsn);
-  //    txn->SetPrevLSN(lsn);
-  //  }
+  // Write the log record.
+  if (enable_logging) {
+    LogChange(this, txn, log_manager, LogRecordType::APPLYDELETE, rid, delete_tuple);
+  }
 
   uint32_t free_space_pointer = GetFreeSpacePointer();
   BUSTUB_ASSERT(tuple_offset >= free_space_pointer, "Free space appears before tuples.");
@@ -261,16 +281,9 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
 
 void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager) {
   // Log the rollback.
-  /**
-   * Removed to support new lock manager API for p4 (multilevel locking); Big hack energy
-   * This clause was used in logging and recovery projects previously; not being used right now
-   */
-  //  if (enable_logging) {
-  //    BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own an exclusive lock on the RID.");
-  //    Tuple dummy_tuple;
-  //    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ROLLBACKDELETE, rid,
-  //    dummy_tuple); lsn_t lsn = log_manager->AppendLogRecord(&log_record); SetLSN(lsn); txn->SetPrevLSN(lsn);
-  //  }
+  if (enable_logging) {
+    LogChange(this, txn, log_manager, LogRecordType::ROLLBACKDELETE, rid, Tuple());
+  }
 
   uint32_t slot_num = rid.GetSlotNum();
   BUSTUB_ASSERT(slot_num < GetTupleCount(), "We can't have more slots than tuples.");
@@ -326,6 +339,47 @@ auto TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   return true;
 }
 
+auto TablePage::GetTupleView(const RID &rid, Tuple *tuple) -> bool {
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount()) {
+    return false;
+  }
+  uint32_t tuple_size = GetTupleSize(slot_num);
+  if (IsDeleted(tuple_size)) {
+    return false;
+  }
+  if (tuple->allocated_) {
+    delete[] tuple->data_;
+  }
+  tuple->data_ = GetData() + GetTupleOffsetAtSlot(slot_num);
+  tuple->size_ = tuple_size;
+  tuple->rid_ = rid;
+  tuple->allocated_ = false;
+  return true;
+}
+
+auto TablePage::GetTupleWithMark(const RID &rid, Tuple *tuple, bool *marked) -> bool {
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount()) {
+    return false;
+  }
+  uint32_t tuple_size = GetTupleSize(slot_num);
+  *marked = static_cast<bool>(tuple_size & DELETE_MASK);
+  tuple_size = UnsetDeletedFlag(tuple_size);
+  if (tuple_size == 0) {
+    return false;
+  }
+  if (tuple->allocated_) {
+    delete[] tuple->data_;
+  }
+  tuple->size_ = tuple_size;
+  tuple->data_ = new char[tuple->size_];
+  memcpy(tuple->data_, GetData() + GetTupleOffsetAtSlot(slot_num), tuple->size_);
+  tuple->rid_ = rid;
+  tuple->allocated_ = true;
+  return true;
+}
+
 auto TablePage::GetFirstTupleRid(RID *first_rid) -> bool {
   // Find and return the first valid tuple.
   for (uint32_t i = 0; i < GetTupleCount(); ++i) {
@@ -0,0 +1,53 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// free_space_map.cpp
+//
+// Identification: src/storage/table/free_space_map.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/free_space_map.h"
+
+namespace bustub {
+
+void FreeSpaceMap::Update(page_id_t page_id, uint32_t free_bytes) {
+  std::scoped_lock lock(latch_);
+  auto category = CategoryOf(free_bytes);
+  auto it = categories_.find(page_id);
+  if (it != categories_.end()) {
+    if (it->second == category) {
+      return;
+    }
+    pages_[it->second].erase(page_id);
+    if (pages_[it->second].empty()) {
+      non_empty_.reset(it->second);
+    }
+    it->second = category;
+  } else {
+    categories_.emplace(page_id, category);
+  }
+  pages_[category].insert(page_id);
+  non_empty_.set(category);
+}
+
+auto FreeSpaceMap::FindPage(uint32_t bytes) -> page_id_t {
+  std::scoped_lock lock(latch_);
+  // 类别只是下界，要向上取整才能保证空间一定够。
+  for (auto category = (bytes + CATEGORY_SIZE - 1) / CATEGORY_SIZE; category < CATEGORY_COUNT; category++) {
+    if (non_empty_.test(category)) {
+      return *pages_[category].begin();
+    }
+  }
+  return INVALID_PAGE_ID;
+}
+
+auto FreeSpaceMap::Size() -> size_t {
+  std::scoped_lock lock(latch_);
+  return categories_.size();
+}
+
+}  // namespace bustub
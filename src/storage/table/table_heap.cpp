@@ -33,64 +33,184 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_m
   BUSTUB_ASSERT(first_page != nullptr,
                 "Couldn't create a page for the table heap. Have you completed the buffer pool manager project?");
   first_page->Init(first_page_id_, BUSTUB_PAGE_SIZE, INVALID_LSN, log_manager_, txn);
+  free_space_map_.Update(first_page_id_, first_page->GetFreeSpaceRemaining());
   buffer_pool_manager_->UnpinPage(first_page_id_, true);
+  last_page_id_ = first_page_id_;
+  append_target_ = first_page_id_;
+  free_space_map_loaded_ = true;
 }
 
-auto TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> bool {
-  if (tuple.size_ + 32 > BUSTUB_PAGE_SIZE) {  // larger than one page size
-    txn->SetState(TransactionState::ABORTED);
+void TableHeap::LoadFreeSpaceMap() {
+  std::scoped_lock lock(latch_);
+  if (free_space_map_loaded_) {
+    return;
+  }
+  // 打开已有的表时走一遍页链，把每页的剩余空间记下来，顺便找到最后一页。
+  auto page_id = first_page_id_;
+  while (page_id != INVALID_PAGE_ID) {
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    BUSTUB_ENSURE(page != nullptr, "BPM full");
+    page->RLatch();
+    free_space_map_.Update(page_id, page->GetFreeSpaceRemaining());
+    auto next_page_id = page->GetNextPageId();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    last_page_id_ = page_id;
+    page_id = next_page_id;
+  }
+  append_target_ = last_page_id_;
+  free_space_map_loaded_ = true;
+}
+
+auto TableHeap::InsertIntoPage(page_id_t page_id, const Tuple &tuple, RID *rid, Transaction *txn) -> bool {
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  if (page == nullptr) {
     return false;
   }
+  page->WLatch();
+  bool inserted = page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_);
+  if (inserted) {
+    version_store_.RecordWrite(txn, *rid, nullptr, false);
+  }
+  uint32_t free_bytes = page->GetFreeSpaceRemaining();
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, inserted);
+  free_space_map_.Update(page_id, free_bytes);
+  return inserted;
+}
 
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
+auto TableHeap::InsertAtEnd(const Tuple &tuple, RID *rid, Transaction *txn) -> bool {
+  std::scoped_lock lock(latch_);
+  // 等锁的时候别人可能已经加了新页，先试一下当前的最后一页。
+  auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(last_page_id_));
   if (cur_page == nullptr) {
+    return false;
+  }
+  cur_page->WLatch();
+  if (cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+    version_store_.RecordWrite(txn, *rid, nullptr, false);
+    free_space_map_.Update(last_page_id_, cur_page->GetFreeSpaceRemaining());
+    cur_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(last_page_id_, true);
+    append_target_ = last_page_id_;
+    return true;
+  }
+
+  page_id_t next_page_id;
+  auto new_page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(&next_page_id));
+  // If we could not create a new page,
+  if (new_page == nullptr) {
+    // Then life sucks and we abort the transaction.
+    cur_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(last_page_id_, false);
+    return false;
+  }
+  // Otherwise we were able to create a new page. We initialize it now.
+  new_page->WLatch();
+  cur_page->SetNextPageId(next_page_id);
+  new_page->Init(next_page_id, BUSTUB_PAGE_SIZE, last_page_id_, log_manager_, txn);
+  cur_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(last_page_id_, true);
+
+  bool inserted = new_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_);
+  if (inserted) {
+    version_store_.RecordWrite(txn, *rid, nullptr, false);
+  }
+  free_space_map_.Update(next_page_id, new_page->GetFreeSpaceRemaining());
+  new_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(next_page_id, true);
+  last_page_id_ = next_page_id;
+  append_target_ = next_page_id;
+  return inserted;
+}
+
+auto TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> bool {
+  if (tuple.size_ + 32 > BUSTUB_PAGE_SIZE) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
+  LoadFreeSpaceMap();
 
-  cur_page->WLatch();
+  page_id_t page_id;
+  {
+    std::scoped_lock lock(latch_);
+    page_id = append_target_;
+  }
 
-  // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
-  // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
-    auto next_page_id = cur_page->GetNextPageId();
-    // If the next page is a valid page,
-    if (next_page_id != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(next_page_id));
-      next_page->WLatch();
-      // Unlatch and unpin the current page.
-      cur_page->WUnlatch();
-      buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), false);
-      cur_page = next_page;
-    } else {
-      // Otherwise we have run out of valid pages. We need to create a new page.
-      auto new_page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(&next_page_id));
-      // If we could not create a new page,
-      if (new_page == nullptr) {
-        // Then life sucks and we abort the transaction.
-        cur_page->WUnlatch();
-        buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), false);
-        txn->SetState(TransactionState::ABORTED);
-        return false;
-      }
-      // Otherwise we were able to create a new page. We initialize it now.
-      new_page->WLatch();
-      cur_page->SetNextPageId(next_page_id);
-      new_page->Init(next_page_id, BUSTUB_PAGE_SIZE, cur_page->GetTablePageId(), log_manager_, txn);
-      cur_page->WUnlatch();
-      buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
-      cur_page = new_page;
+  // 先试上次插入的那页，再问free space map要一个放得下的页，最后才在链表末尾加新页。
+  bool inserted = InsertIntoPage(page_id, tuple, rid, txn);
+  while (!inserted) {
+    page_id = free_space_map_.FindPage(TablePage::SpaceForTuple(tuple.size_));
+    if (page_id == INVALID_PAGE_ID) {
+      break;
     }
+    inserted = InsertIntoPage(page_id, tuple, rid, txn);
   }
-  // This line has caused most of us to double-take and "whoa double unlatch".
-  // We are not, in fact, double unlatching. See the invariant above.
-  cur_page->WUnlatch();
-  buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
+  if (inserted) {
+    std::scoped_lock lock(latch_);
+    append_target_ = page_id;
+  } else if (!InsertAtEnd(tuple, rid, txn)) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+
   // Update the transaction's write set.
   txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, Tuple{}, this);
   return true;
 }
 
+auto TableHeap::AppendBatch(const std::vector<Tuple> &tuples, std::vector<RID> *rids, Transaction *txn) -> bool {
+  for (const auto &tuple : tuples) {
+    if (tuple.size_ + 32 > BUSTUB_PAGE_SIZE) {  // larger than one page size
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+  }
+  LoadFreeSpaceMap();
+
+  std::scoped_lock lock(latch_);
+  size_t next = 0;
+  while (next < tuples.size()) {
+    page_id_t page_id;
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(&page_id));
+    if (page == nullptr) {
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+    // 先把新页填满再挂到链表上，扫描的人看不到填了一半的页。
+    page->WLatch();
+    page->Init(page_id, BUSTUB_PAGE_SIZE, last_page_id_, log_manager_, txn);
+    auto first = next;
+    next += page->AppendTuples(tuples, first, rids);
+    BUSTUB_ASSERT(next > first, "A tuple always fits into an empty page.");
+    for (auto i = first; i < next; i++) {
+      version_store_.RecordWrite(txn, (*rids)[i], nullptr, false);
+    }
+    if (enable_logging) {
+      LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::INSERTPAGE, page_id,
+                           std::vector<Tuple>(tuples.begin() + first, tuples.begin() + next));
+      lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+      page->SetLSN(lsn);
+      txn->SetPrevLSN(lsn);
+    }
+    free_space_map_.Update(page_id, page->GetFreeSpaceRemaining());
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, true);
+
+    auto last_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(last_page_id_));
+    BUSTUB_ENSURE(last_page != nullptr, "BPM full");
+    last_page->WLatch();
+    last_page->SetNextPageId(page_id);
+    last_page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(last_page_id_, true);
+    last_page_id_ = page_id;
+    append_target_ = page_id;
+
+    txn->GetWriteSet()->emplace_back(RID(page_id, 0), WType::INSERT, Tuple{}, this, next - first);
+  }
+  return true;
+}
+
 auto TableHeap::MarkDelete(const RID &rid, Transaction *txn) -> bool {
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
@@ -102,7 +222,20 @@ auto TableHeap::MarkDelete(const RID &rid, Transaction *txn) -> bool {
   }
   // Otherwise, mark the tuple as deleted.
   page->WLatch();
+  // 快照之后已经有人提交过这一行，快照隔离的事务不能再写它。
+  if (version_store_.HasConflict(txn, rid)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  // 删除前的版本留给还在读旧快照的事务。
+  Tuple old_tuple;
+  bool exists = page->GetTuple(rid, &old_tuple, txn, lock_manager_);
   page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  if (exists) {
+    version_store_.RecordWrite(txn, rid, &old_tuple, true);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -120,9 +253,22 @@ auto TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   }
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
+  // Abort也是用这个函数把旧值写回去的，那时不算一次新的写。
+  bool rollback = txn->GetState() == TransactionState::ABORTED;
   page->WLatch();
+  if (!rollback && version_store_.HasConflict(txn, rid)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  if (is_updated && !rollback) {
+    version_store_.RecordWrite(txn, rid, &old_tuple, false);
+  }
+  uint32_t free_bytes = page->GetFreeSpaceRemaining();
   page->WUnlatch();
+  free_space_map_.Update(rid.GetPageId(), free_bytes);
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
   // Update the transaction's write set.
   if (is_updated && txn->GetState() != TransactionState::ABORTED) {
@@ -137,11 +283,15 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Delete the tuple from the page.
   page->WLatch();
+  // 槽空出来以后可能被新的插入复用，旧的版本链不能留着。
+  version_store_.Erase(rid);
   page->ApplyDelete(rid, txn, log_manager_);
   /** Commented out to make compatible with p4; This is called only on commit or delete, which consequently unlocks the
    * tuple; so should be fine */
   // lock_manager_->Unlock(txn, rid);
+  uint32_t free_bytes = page->GetFreeSpaceRemaining();
   page->WUnlatch();
+  free_space_map_.Update(rid.GetPageId(), free_bytes);
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
@@ -168,7 +318,11 @@ auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool ac
   if (acquire_read_lock) {
     page->RLatch();
   }
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res = txn != nullptr && txn->ReadsSnapshot() ? ReadVersion(page, rid, tuple, txn)
+                                                    : page->GetTuple(rid, tuple, txn, lock_manager_);
+  if (res) {
+    RecordRead(txn, rid);
+  }
   if (acquire_read_lock) {
     page->RUnlatch();
   }
@@ -176,7 +330,31 @@ auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, bool ac
   return res;
 }
 
+auto TableHeap::ReadVersion(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn) -> bool {
+  bool marked;
+  if (!page->GetTupleWithMark(rid, tuple, &marked)) {
+    return false;
+  }
+  return version_store_.Read(txn, rid, marked, tuple) != VersionStore::ReadResult::INVISIBLE;
+}
+
+void TableHeap::RecordRead(Transaction *txn, const RID &rid) {
+  if (txn != nullptr && txn->IsOptimistic()) {
+    txn->GetReadSet()->emplace_back(rid, this, version_words_.Get(rid) & ~VersionWords::LOCK_BIT);
+  }
+}
+
+void TableHeap::CollectVersions(timestamp_t oldest, Transaction *txn) {
+  for (const auto &rid : version_store_.Collect(oldest)) {
+    ApplyDelete(rid, txn);
+  }
+}
+
 auto TableHeap::Begin(Transaction *txn) -> TableIterator {
+  if (txn != nullptr && txn->ReadsSnapshot()) {
+    // 快照里可能还有页上已经标记删除的tuple，从第一页的第一个槽开始，由迭代器自己找第一个看得见的版本。
+    return {this, RID(first_page_id_, 0), txn};
+  }
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
   RID rid;
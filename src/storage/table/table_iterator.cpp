@@ -10,7 +10,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <utility>
 
 #include "common/exception.h"
 #include "concurrency/transaction.h"
@@ -19,11 +21,22 @@
 namespace bustub {
 
 TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
+    : table_heap_(table_heap),
+      tuple_(new Tuple(rid)),
+      txn_(txn),
+      snapshot_(txn != nullptr && txn->ReadsSnapshot()) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
-    if (!table_heap_->GetTuple(tuple_->rid_, tuple_, txn_)) {
+    LoadPage(rid);
+    if (snapshot_) {
+      // 快照里的第一个tuple不一定就在rid上，像++一样往后找。
+      ++(*this);
+      return;
+    }
+    if (batch_.empty() || !(batch_[0].GetRid() == rid)) {
       throw bustub::Exception("read non-existing tuple");
     }
+    *tuple_ = std::move(batch_[0]);
+    next_in_batch_ = 1;
   }
 }
 
@@ -37,43 +50,76 @@ auto TableIterator::operator->() -> Tuple * {
   return tuple_;
 }
 
-auto TableIterator::operator++() -> TableIterator & {
+void TableIterator::LoadPage(RID from) {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
-  BUSTUB_ENSURE(cur_page != nullptr, "BPM full");  // all pages are pinned
+  auto page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(from.GetPageId()));
+  BUSTUB_ENSURE(page != nullptr, "BPM full");  // all pages are pinned
 
-  cur_page->RLatch();
-  RID next_tuple_rid;
-  if (!cur_page->GetNextTupleRid(tuple_->rid_,
-                                 &next_tuple_rid)) {  // end of this page
-    while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
-      cur_page->RUnlatch();
-      buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
-      cur_page = next_page;
-      cur_page->RLatch();
-      if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
-        break;
+  batch_.clear();
+  next_in_batch_ = 0;
+  // 整页只pin、只加读锁一次，把这页剩下的tuple一次拷出来，后面的++都不用再碰buffer pool。
+  page->RLatch();
+  if (snapshot_) {
+    // 快照读把标记删除的槽也看一遍，每个槽换成这个快照看得到的版本，再对着它判断谓词。
+    for (auto slot = from.GetSlotNum(); slot < page->GetSlotCount(); slot++) {
+      Tuple version;
+      if (table_heap_->ReadVersion(page, RID(from.GetPageId(), slot), &version, txn_) &&
+          (predicate_ == nullptr || predicate_(version))) {
+        batch_.push_back(std::move(version));
       }
     }
+    next_page_id_ = page->GetNextPageId();
+    page->RUnlatch();
+    buffer_pool_manager->UnpinPage(page->GetTablePageId(), false);
+    return;
   }
-  tuple_->rid_ = next_tuple_rid;
-
-  if (*this != table_heap_->End()) {
-    // DO NOT ACQUIRE READ LOCK twice in a single thread otherwise it may deadlock.
-    // See https://users.rust-lang.org/t/how-bad-is-the-potential-deadlock-mentioned-in-rwlocks-document/67234
-    if (!table_heap_->GetTuple(tuple_->rid_, tuple_, txn_, false)) {
-      cur_page->RUnlatch();
-      buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
-      throw bustub::Exception("read non-existing tuple");
+  RID rid = from;
+  Tuple view;
+  bool found = page->GetTupleView(rid, &view) || page->GetNextTupleRid(from, &rid);
+  while (found) {
+    // 先在页里原地看一眼，过不了谓词的tuple不用拷出来。
+    if (predicate_ == nullptr || (page->GetTupleView(rid, &view) && predicate_(view))) {
+      batch_.emplace_back();
+      if (!page->GetTuple(rid, &batch_.back(), txn_, table_heap_->lock_manager_)) {
+        page->RUnlatch();
+        buffer_pool_manager->UnpinPage(page->GetTablePageId(), false);
+        throw bustub::Exception("read non-existing tuple");
+      }
+      table_heap_->RecordRead(txn_, rid);
     }
+    found = page->GetNextTupleRid(rid, &rid);
+  }
+  next_page_id_ = page->GetNextPageId();
+  page->RUnlatch();
+  buffer_pool_manager->UnpinPage(page->GetTablePageId(), false);
+}
+
+auto TableIterator::operator++() -> TableIterator & {
+  while (next_in_batch_ == batch_.size() && next_page_id_ != INVALID_PAGE_ID) {
+    LoadPage(RID(next_page_id_, 0));
+  }
+  if (next_in_batch_ < batch_.size()) {
+    *tuple_ = std::move(batch_[next_in_batch_++]);
+  } else {
+    tuple_->rid_ = RID(INVALID_PAGE_ID, 0);
   }
-  // release until copy the tuple
-  cur_page->RUnlatch();
-  buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
   return *this;
 }
 
+void TableIterator::SetPredicate(Predicate predicate) {
+  predicate_ = std::move(predicate);
+  if (predicate_ == nullptr) {
+    return;
+  }
+  // 这一页已经拷出来的tuple也要补上过滤。
+  auto it = std::remove_if(batch_.begin() + next_in_batch_, batch_.end(),
+                           [this](const Tuple &tuple) { return !predicate_(tuple); });
+  batch_.erase(it, batch_.end());
+  if (*this != table_heap_->End() && !predicate_(*tuple_)) {
+    ++(*this);
+  }
+}
+
 auto TableIterator::operator++(int) -> TableIterator {
   TableIterator clone(*this);
   ++(*this);
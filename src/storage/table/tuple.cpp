@@ -61,6 +61,29 @@ Tuple::Tuple(std::vector<Value> values, const Schema *schema) : allocated_(true)
   }
 }
 
+Tuple::Tuple(const Tuple &left, const Schema *left_schema, const Tuple &right, const Schema *right_schema)
+    : allocated_(true) {
+  // 两边的布局都是 [定长部分][变长部分]，拼接后是 [左定长][右定长][左变长][右变长]。
+  uint32_t left_fixed = left_schema->GetLength();
+  uint32_t right_fixed = right_schema->GetLength();
+  size_ = left.size_ + right.size_;
+  data_ = new char[size_];
+
+  memcpy(data_, left.data_, left_fixed);
+  memcpy(data_ + left_fixed, right.data_, right_fixed);
+  memcpy(data_ + left_fixed + right_fixed, left.data_ + left_fixed, left.size_ - left_fixed);
+  memcpy(data_ + left_fixed + right_fixed + left.size_ - left_fixed, right.data_ + right_fixed,
+         right.size_ - right_fixed);
+
+  // 变长字段存的是相对偏移，整体挪动之后要修正：左边的后移了右定长部分，右边的后移了整个左tuple。
+  for (auto i : left_schema->GetUnlinedColumns()) {
+    *reinterpret_cast<uint32_t *>(data_ + left_schema->GetColumn(i).GetOffset()) += right_fixed;
+  }
+  for (auto i : right_schema->GetUnlinedColumns()) {
+    *reinterpret_cast<uint32_t *>(data_ + left_fixed + right_schema->GetColumn(i).GetOffset()) += left.size_;
+  }
+}
+
 Tuple::Tuple(const Tuple &other) : allocated_(other.allocated_), rid_(other.rid_), size_(other.size_) {
   if (allocated_) {
     delete[] data_;
@@ -95,6 +118,31 @@ auto Tuple::operator=(const Tuple &other) -> Tuple & {
   return *this;
 }
 
+Tuple::Tuple(Tuple &&other) noexcept
+    : allocated_(other.allocated_), rid_(other.rid_), size_(other.size_), data_(other.data_) {
+  other.allocated_ = false;
+  other.size_ = 0;
+  other.data_ = nullptr;
+}
+
+auto Tuple::operator=(Tuple &&other) noexcept -> Tuple & {
+  if (this == &other) {
+    return *this;
+  }
+  if (allocated_) {
+    delete[] data_;
+  }
+  allocated_ = other.allocated_;
+  rid_ = other.rid_;
+  size_ = other.size_;
+  data_ = other.data_;
+  // rid留在原处，table iterator移走tuple之后还要靠它往后走。
+  other.allocated_ = false;
+  other.size_ = 0;
+  other.data_ = nullptr;
+  return *this;
+}
+
 auto Tuple::GetValue(const Schema *schema, const uint32_t column_idx) const -> Value {
   assert(schema);
   assert(data_);
@@ -105,7 +153,7 @@ auto Tuple::GetValue(const Schema *schema, const uint32_t column_idx) const -> V
 }
 
 auto Tuple::KeyFromTuple(const Schema &schema, const Schema &key_schema, const std::vector<uint32_t> &key_attrs)
-    -> Tuple {
+    const -> Tuple {
   std::vector<Value> values;
   values.reserve(key_attrs.size());
   for (auto idx : key_attrs) {
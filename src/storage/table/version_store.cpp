@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/storage/table/version_store.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/version_store.h"
+
+#include <algorithm>
+#include <mutex>  // NOLINT
+
+namespace bustub {
+
+auto VersionStore::HasConflict(Transaction *txn, const RID &rid) -> bool {
+  if (!txn->ReadsSnapshot() || chain_count_.load() == 0) {
+    return false;
+  }
+  std::shared_lock lock(latch_);
+  auto it = chains_.find(rid);
+  if (it == chains_.end()) {
+    return false;
+  }
+  // 写之前行锁已经拿到了，别人没提交的写不会在这里。只要快照之后有人提交过，就是先提交者赢。
+  auto &chain = it->second;
+  return chain.writer_ == INVALID_TXN_ID && chain.ts_ > txn->GetReadTs();
+}
+
+void VersionStore::RecordWrite(Transaction *txn, const RID &rid, const Tuple *before, bool deleting) {
+  std::unique_lock lock(latch_);
+  auto [it, inserted] = chains_.try_emplace(rid);
+  auto &chain = it->second;
+  if (inserted) {
+    chain_count_++;
+    // 空槽上的插入没有旧版本，之前的快照看不到它就行。
+    if (before == nullptr) {
+      chain.writer_ = txn->GetTransactionId();
+      return;
+    }
+  }
+  if (chain.writer_ != txn->GetTransactionId()) {
+    // 同一个事务改同一行，只有第一次要留下提交过的旧版本。
+    chain.undo_.push_back({chain.ts_, chain.deleted_, before == nullptr ? Tuple{} : *before});
+    chain.writer_ = txn->GetTransactionId();
+  }
+  chain.deleted_ = deleting;
+}
+
+void VersionStore::Commit(txn_id_t txn_id, const RID &rid, timestamp_t commit_ts) {
+  std::unique_lock lock(latch_);
+  auto it = chains_.find(rid);
+  if (it != chains_.end() && it->second.writer_ == txn_id) {
+    it->second.writer_ = INVALID_TXN_ID;
+    it->second.ts_ = commit_ts;
+  }
+}
+
+void VersionStore::Rollback(txn_id_t txn_id, const RID &rid) {
+  std::unique_lock lock(latch_);
+  auto it = chains_.find(rid);
+  if (it == chains_.end() || it->second.writer_ != txn_id) {
+    return;
+  }
+  auto &chain = it->second;
+  if (!chain.undo_.empty()) {
+    chain.ts_ = chain.undo_.back().ts_;
+    chain.deleted_ = chain.undo_.back().deleted_;
+    chain.undo_.pop_back();
+  }
+  chain.writer_ = INVALID_TXN_ID;
+  // 退回到了谁都能看见的版本，链就没用了。
+  if (chain.undo_.empty() && chain.ts_ == 0 && !chain.deleted_) {
+    chains_.erase(it);
+    chain_count_--;
+  }
+}
+
+auto VersionStore::WriterOf(const RID &rid) -> txn_id_t {
+  if (chain_count_.load() == 0) {
+    return INVALID_TXN_ID;
+  }
+  std::shared_lock lock(latch_);
+  auto it = chains_.find(rid);
+  return it == chains_.end() ? INVALID_TXN_ID : it->second.writer_;
+}
+
+void VersionStore::Erase(const RID &rid) {
+  if (chain_count_.load() == 0) {
+    return;
+  }
+  std::unique_lock lock(latch_);
+  if (chains_.erase(rid) > 0) {
+    chain_count_--;
+  }
+}
+
+auto VersionStore::Read(Transaction *txn, const RID &rid, bool marked, Tuple *old_version) -> ReadResult {
+  if (chain_count_.load() == 0) {
+    return marked ? ReadResult::INVISIBLE : ReadResult::CURRENT;
+  }
+  std::shared_lock lock(latch_);
+  auto it = chains_.find(rid);
+  if (it == chains_.end()) {
+    return marked ? ReadResult::INVISIBLE : ReadResult::CURRENT;
+  }
+  auto &chain = it->second;
+  if (chain.writer_ == txn->GetTransactionId()) {
+    return marked ? ReadResult::INVISIBLE : ReadResult::CURRENT;
+  }
+  if (chain.writer_ == INVALID_TXN_ID && chain.ts_ <= txn->GetReadTs()) {
+    return chain.deleted_ ? ReadResult::INVISIBLE : ReadResult::CURRENT;
+  }
+  // 页上的版本对这个快照来说太新了，从新到旧找第一个快照之前提交的版本。
+  for (auto version = chain.undo_.rbegin(); version != chain.undo_.rend(); ++version) {
+    if (version->ts_ <= txn->GetReadTs()) {
+      if (version->deleted_) {
+        return ReadResult::INVISIBLE;
+      }
+      *old_version = version->tuple_;
+      return ReadResult::UNDO;
+    }
+  }
+  return ReadResult::INVISIBLE;
+}
+
+auto VersionStore::Collect(timestamp_t oldest) -> std::vector<RID> {
+  std::vector<RID> purged;
+  std::unique_lock lock(latch_);
+  for (auto it = chains_.begin(); it != chains_.end();) {
+    auto &chain = it->second;
+    if (chain.writer_ == INVALID_TXN_ID && chain.ts_ <= oldest) {
+      // 所有快照都看得到页上的版本了。是删除的话，页里的tuple也可以真正删掉了。
+      if (chain.deleted_) {
+        purged.push_back(it->first);
+      }
+      it = chains_.erase(it);
+      continue;
+    }
+    // 最老的快照看到的是最新的一个不晚于它的版本，比它还旧的谁也用不到。
+    auto visible = std::find_if(chain.undo_.rbegin(), chain.undo_.rend(),
+                                [oldest](const Version &version) { return version.ts_ <= oldest; });
+    if (visible != chain.undo_.rend()) {
+      chain.undo_.erase(chain.undo_.begin(), std::prev(visible.base()));
+    }
+    ++it;
+  }
+  chain_count_ = chains_.size();
+  collect_at_ = std::max(VERSION_GC_INTERVAL, 2 * chains_.size());
+  collected_for_ = oldest;
+  return purged;
+}
+
+auto VersionStore::NeedsCollect(timestamp_t oldest) -> bool {
+  std::shared_lock lock(latch_);
+  return oldest > collected_for_ && chains_.size() >= collect_at_;
+}
+
+}  // namespace bustub
@@ -0,0 +1,80 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_words.cpp
+//
+// Identification: src/storage/table/version_words.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/version_words.h"
+
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+
+namespace bustub {
+
+auto VersionWords::Get(const RID &rid) -> uint64_t {
+  std::shared_lock lock(latch_);
+  auto it = words_.find(rid);
+  return it == words_.end() ? 0 : it->second.load();
+}
+
+void VersionWords::Bump(const RID &rid) {
+  // 只动版本号，锁位留给持有它的乐观事务自己放。提交的写事务不一定是乐观事务，全程拿着latch，Clear才动不了它。
+  {
+    std::shared_lock lock(latch_);
+    auto it = words_.find(rid);
+    if (it != words_.end()) {
+      it->second.fetch_add(1);
+      return;
+    }
+  }
+  std::unique_lock lock(latch_);
+  words_.try_emplace(rid, 0).first->second.fetch_add(1);
+}
+
+void VersionWords::Lock(const RID &rid) {
+  auto &word = Word(rid);
+  auto expected = word.load();
+  while (true) {
+    if ((expected & LOCK_BIT) != 0) {
+      // 别的乐观事务正在装它的写，很快就放。
+      std::this_thread::yield();
+      expected = word.load();
+      continue;
+    }
+    if (word.compare_exchange_weak(expected, expected | LOCK_BIT)) {
+      return;
+    }
+  }
+}
+
+void VersionWords::Unlock(const RID &rid) { Word(rid).fetch_and(~LOCK_BIT); }
+
+void VersionWords::Clear() {
+  std::unique_lock lock(latch_);
+  words_.clear();
+}
+
+auto VersionWords::Size() -> size_t {
+  std::shared_lock lock(latch_);
+  return words_.size();
+}
+
+auto VersionWords::Word(const RID &rid) -> std::atomic<uint64_t> & {
+  {
+    std::shared_lock lock(latch_);
+    auto it = words_.find(rid);
+    if (it != words_.end()) {
+      return it->second;
+    }
+  }
+  std::unique_lock lock(latch_);
+  return words_.try_emplace(rid, 0).first->second;
+}
+
+}  // namespace bustub
@@ -222,4 +222,95 @@ TEST(LockManagerDeadlockDetectionTest, CycleTest1) {
   lock_mgr.RemoveEdge(4, 2);
 }
 
-}  // namespace bustub
\ No newline at end of file
+
+/**
+ * T0 holds rid0 and T1 holds rid1, then each asks for the other's row. `older_blocks_first` picks who blocks first.
+ * Every policy must abort T1, the younger transaction; all but DETECTION do it without waiting for the detection thread.
+ * With `older_has_larger_id`, T0 begins on another thread and gets its id from a later batch than T1.
+ */
+void DeadlockPolicyTest(LockManager::DeadlockPolicy policy, bool older_blocks_first, bool older_has_larger_id = false) {
+  LockManager lock_mgr{policy};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  table_oid_t toid{0};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+  Transaction *txn0 = nullptr;
+  if (older_has_larger_id) {
+    // this thread takes the first batch of ids, so T0 begins with an id from the second one
+    auto *first = txn_mgr.Begin();
+    txn_mgr.Commit(first);
+    delete first;
+    std::thread([&] { txn0 = txn_mgr.Begin(); }).join();
+  } else {
+    txn0 = txn_mgr.Begin();
+  }
+  auto *txn1 = txn_mgr.Begin();
+  if (older_has_larger_id) {
+    ASSERT_GT(txn0->GetTransactionId(), txn1->GetTransactionId());
+  }
+  EXPECT_TRUE(lock_mgr.LockTable(txn0, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockTable(txn1, LockManager::LockMode::INTENTION_EXCLUSIVE, toid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::EXCLUSIVE, toid, rid0));
+  EXPECT_TRUE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, toid, rid1));
+
+  std::thread t0([&] {
+    if (!older_blocks_first) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::EXCLUSIVE, toid, rid1));
+    txn_mgr.Commit(txn0);
+  });
+
+  std::thread t1([&] {
+    if (older_blocks_first) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, toid, rid0));
+    if (policy != LockManager::DeadlockPolicy::DETECTION) {
+      // resolved without waiting for a detection round
+      EXPECT_LT(std::chrono::steady_clock::now() - start, cycle_detection_interval);
+    }
+    EXPECT_EQ(TransactionState::ABORTED, txn1->GetState());
+    txn_mgr.Abort(txn1);
+  });
+
+  t0.join();
+  t1.join();
+  EXPECT_EQ(TransactionState::COMMITTED, txn0->GetState());
+  EXPECT_TRUE(lock_mgr.GetEdgeList().empty());
+
+  delete txn0;
+  delete txn1;
+}
+
+TEST(LockManagerDeadlockDetectionTest, DetectionVictimTest) {
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::DETECTION, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::DETECTION, false);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::DETECTION, true, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::DETECTION, false, true);
+}
+
+TEST(LockManagerDeadlockDetectionTest, IncrementalDetectionTest) {
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::INCREMENTAL_DETECTION, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::INCREMENTAL_DETECTION, false);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::INCREMENTAL_DETECTION, true, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::INCREMENTAL_DETECTION, false, true);
+}
+
+TEST(LockManagerDeadlockDetectionTest, WoundWaitTest) {
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WOUND_WAIT, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WOUND_WAIT, false);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WOUND_WAIT, true, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WOUND_WAIT, false, true);
+}
+
+TEST(LockManagerDeadlockDetectionTest, WaitDieTest) {
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WAIT_DIE, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WAIT_DIE, false);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WAIT_DIE, true, true);
+  DeadlockPolicyTest(LockManager::DeadlockPolicy::WAIT_DIE, false, true);
+}
+
+}  // namespace bustub
@@ -4,6 +4,8 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <atomic>
+#include <numeric>
 #include <random>
 #include <thread>  // NOLINT
 
@@ -327,6 +329,203 @@ void RowLockTest1() {
 }
 TEST(LockManagerTest, RowLockTest1) { RowLockTest1(); }  // NOLINT
 
+/** Threads lock rows spread over every shard of the row lock table, and all of them also queue on one hot row */
+TEST(LockManagerTest, ShardedRowLockTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  table_oid_t oid = 0;
+  RID hot_rid{0, 0};
+  const int num_threads = 8;
+  const int num_rounds = 50;
+  const int rows_per_round = 20;
+  int counter = 0;
+  std::atomic<int> holders{0};
+
+  auto task = [&](int thread_id) {
+    for (int round = 0; round < num_rounds; round++) {
+      auto *txn = txn_mgr.Begin();
+      EXPECT_TRUE(lock_mgr.LockTable(txn, LockManager::LockMode::INTENTION_EXCLUSIVE, oid));
+      for (int i = 0; i < rows_per_round; i++) {
+        RID rid{thread_id + 1, static_cast<uint32_t>(round * rows_per_round + i)};
+        EXPECT_TRUE(lock_mgr.LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, rid));
+      }
+      EXPECT_TRUE(lock_mgr.LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, hot_rid));
+      EXPECT_EQ(1, ++holders);
+      counter++;
+      holders--;
+      CheckTxnRowLockSize(txn, oid, 0, rows_per_round + 1);
+      txn_mgr.Commit(txn);
+      CheckTxnRowLockSize(txn, oid, 0, 0);
+      delete txn;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(task, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_threads * num_rounds, counter);
+}
+
+TEST(LockManagerTest, HeldLockTest) {
+  // Asking again for a lock the transaction already holds, or for a weaker one, is granted without an upgrade.
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  table_oid_t oid = 0;
+  RID rid{0, 0};
+  auto *txn = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(txn, LockManager::LockMode::SHARED_INTENTION_EXCLUSIVE, oid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, rid));
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(lock_mgr.LockTable(txn, LockManager::LockMode::INTENTION_SHARED, oid));
+    EXPECT_TRUE(lock_mgr.LockTable(txn, LockManager::LockMode::SHARED, oid));
+    EXPECT_TRUE(lock_mgr.LockTable(txn, LockManager::LockMode::INTENTION_EXCLUSIVE, oid));
+    EXPECT_TRUE(lock_mgr.LockRow(txn, LockManager::LockMode::SHARED, oid, rid));
+    EXPECT_TRUE(lock_mgr.LockRow(txn, LockManager::LockMode::EXCLUSIVE, oid, rid));
+  }
+  CheckGrowing(txn);
+  CheckTableLockSizes(txn, 0, 0, 0, 0, 1);
+  CheckTxnRowLockSize(txn, oid, 0, 1);
+
+  txn_mgr.Commit(txn);
+  CheckTableLockSizes(txn, 0, 0, 0, 0, 0);
+  delete txn;
+}
+
+TEST(LockManagerTest, ProfilerTest) {
+  // txn1 holds X on the table while txn0 waits for S: the profiler shows who blocks whom, then counts the wait.
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  auto *profiler = lock_mgr.GetProfiler();
+
+  table_oid_t oid = 0;
+  auto *txn0 = txn_mgr.Begin();
+  auto *txn1 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(txn1, LockManager::LockMode::EXCLUSIVE, oid));
+
+  std::thread waiter([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(txn0, LockManager::LockMode::SHARED, oid));
+    txn_mgr.Commit(txn0);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto waiters = profiler->GetWaiters();
+  ASSERT_EQ(waiters.size(), 1U);
+  EXPECT_EQ(waiters[0].txn_id_, txn0->GetTransactionId());
+  EXPECT_EQ(waiters[0].mode_, "S");
+  EXPECT_EQ(waiters[0].blockers_, std::vector<txn_id_t>{txn1->GetTransactionId()});
+
+  txn_mgr.Commit(txn1);
+  waiter.join();
+  EXPECT_TRUE(profiler->GetWaiters().empty());
+  auto counters = profiler->GetTableCounters().at(oid);
+  EXPECT_EQ(counters.acquisitions_, 2U);
+  EXPECT_EQ(counters.waits_, 1U);
+  EXPECT_GE(counters.wait_us_, 50000U);
+  EXPECT_EQ(std::accumulate(counters.wait_histogram_.begin(), counters.wait_histogram_.end(), 0ULL), 1U);
+
+  // row locks and their upgrades are counted apart from the table locks
+  auto *txn3 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(txn3, LockManager::LockMode::INTENTION_EXCLUSIVE, oid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn3, LockManager::LockMode::SHARED, oid, RID{0, 0}));
+  EXPECT_TRUE(lock_mgr.LockRow(txn3, LockManager::LockMode::EXCLUSIVE, oid, RID{0, 0}));
+  txn_mgr.Commit(txn3);
+  counters = profiler->GetTableCounters().at(oid);
+  EXPECT_EQ(counters.acquisitions_, 3U);
+  EXPECT_EQ(counters.upgrades_, 0U);
+  EXPECT_EQ(counters.row_acquisitions_, 2U);
+  EXPECT_EQ(counters.row_upgrades_, 1U);
+
+  auto *txn2 = txn_mgr.Begin(nullptr, IsolationLevel::READ_UNCOMMITTED);
+  EXPECT_THROW(lock_mgr.LockTable(txn2, LockManager::LockMode::SHARED, oid), TransactionAbortException);
+  txn_mgr.Abort(txn2);
+  EXPECT_EQ(profiler->GetAborts(AbortReason::LOCK_SHARED_ON_READ_UNCOMMITTED), 1U);
+  EXPECT_NE(profiler->ToJson().find(R"("LOCK_SHARED_ON_READ_UNCOMMITTED":1)"), std::string::npos);
+
+  delete txn0;
+  delete txn1;
+  delete txn2;
+  delete txn3;
+}
+
+TEST(LockManagerTest, LockEscalationTest) {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  table_oid_t oid = 0;
+
+  /** S row locks turn IS into S, further S row locks are covered by the table lock */
+  auto *txn0 = txn_mgr.Begin();
+  txn0->SetLockEscalationThreshold(10);
+  EXPECT_TRUE(lock_mgr.LockTable(txn0, LockManager::LockMode::INTENTION_SHARED, oid));
+  for (uint32_t i = 0; i < 9; i++) {
+    EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::SHARED, oid, RID{0, i}));
+  }
+  CheckTxnRowLockSize(txn0, oid, 9, 0);
+  EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::SHARED, oid, RID{0, 9}));
+  CheckTxnRowLockSize(txn0, oid, 0, 0);
+  CheckTableLockSizes(txn0, 1, 0, 0, 0, 0);
+  EXPECT_TRUE(lock_mgr.LockRow(txn0, LockManager::LockMode::SHARED, oid, RID{0, 10}));
+  CheckTxnRowLockSize(txn0, oid, 0, 0);
+  CheckGrowing(txn0);
+  txn_mgr.Commit(txn0);
+  CheckTableLockSizes(txn0, 0, 0, 0, 0, 0);
+
+  /** X row locks turn IX into X */
+  auto *txn1 = txn_mgr.Begin();
+  txn1->SetLockEscalationThreshold(5);
+  EXPECT_TRUE(lock_mgr.LockTable(txn1, LockManager::LockMode::INTENTION_EXCLUSIVE, oid));
+  for (uint32_t i = 0; i < 5; i++) {
+    EXPECT_TRUE(lock_mgr.LockRow(txn1, LockManager::LockMode::EXCLUSIVE, oid, RID{0, i}));
+  }
+  CheckTxnRowLockSize(txn1, oid, 0, 0);
+  CheckTableLockSizes(txn1, 0, 1, 0, 0, 0);
+  CheckGrowing(txn1);
+  txn_mgr.Commit(txn1);
+
+  /** Escalation never waits: with another IX holder, the S row locks stay */
+  auto *txn2 = txn_mgr.Begin();
+  auto *txn3 = txn_mgr.Begin();
+  txn3->SetLockEscalationThreshold(3);
+  EXPECT_TRUE(lock_mgr.LockTable(txn2, LockManager::LockMode::INTENTION_EXCLUSIVE, oid));
+  EXPECT_TRUE(lock_mgr.LockTable(txn3, LockManager::LockMode::INTENTION_SHARED, oid));
+  for (uint32_t i = 0; i < 4; i++) {
+    EXPECT_TRUE(lock_mgr.LockRow(txn3, LockManager::LockMode::SHARED, oid, RID{0, i}));
+  }
+  CheckTxnRowLockSize(txn3, oid, 4, 0);
+  CheckTableLockSizes(txn3, 0, 0, 1, 0, 0);
+  txn_mgr.Commit(txn2);
+  txn_mgr.Commit(txn3);
+
+  /** Writing after escalation: IX on top of the escalated S becomes SIX, and X row locks are still taken */
+  auto *txn4 = txn_mgr.Begin();
+  txn4->SetLockEscalationThreshold(3);
+  EXPECT_TRUE(lock_mgr.LockTable(txn4, LockManager::LockMode::INTENTION_SHARED, oid));
+  for (uint32_t i = 0; i < 3; i++) {
+    EXPECT_TRUE(lock_mgr.LockRow(txn4, LockManager::LockMode::SHARED, oid, RID{0, i}));
+  }
+  CheckTableLockSizes(txn4, 1, 0, 0, 0, 0);
+  EXPECT_TRUE(lock_mgr.LockTable(txn4, LockManager::LockMode::INTENTION_EXCLUSIVE, oid));
+  CheckTableLockSizes(txn4, 0, 0, 0, 0, 1);
+  EXPECT_TRUE(lock_mgr.LockTable(txn4, LockManager::LockMode::INTENTION_EXCLUSIVE, oid));
+  EXPECT_TRUE(lock_mgr.LockRow(txn4, LockManager::LockMode::EXCLUSIVE, oid, RID{0, 0}));
+  CheckTxnRowLockSize(txn4, oid, 0, 1);
+  CheckGrowing(txn4);
+  txn_mgr.Commit(txn4);
+  CheckTableLockSizes(txn4, 0, 0, 0, 0, 0);
+
+  delete txn0;
+  delete txn1;
+  delete txn2;
+  delete txn3;
+  delete txn4;
+}
+
 void TwoPLTest1() {
   LockManager lock_mgr{};
   TransactionManager txn_mgr{&lock_mgr};
@@ -13,10 +13,13 @@
 #include "concurrency/transaction.h"
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
 #include <memory>
 #include <random>
+#include <set>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
@@ -119,4 +122,351 @@ TEST_F(TransactionTest, DirtyReadsTest) {
   delete txn1;
 }
 
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotReadTest) {
+  // txn1 (snapshot): SELECT * FROM t;
+  // txn2: DELETE FROM t WHERE a = 2; INSERT INTO t VALUES (4, 40); commit
+  // txn1 keeps reading its snapshot without taking any lock, txn3 (snapshot) sees the new state.
+
+  auto noop_writer = NoopWriter();
+  bustub_->ExecuteSql("CREATE TABLE t (a int, b int);", noop_writer);
+  bustub_->ExecuteSql("INSERT INTO t VALUES (1, 10), (2, 20), (3, 30);", noop_writer);
+  auto *table = bustub_->catalog_->GetTable("t")->table_.get();
+
+  auto select = [&](Transaction *txn) {
+    std::stringstream ss;
+    auto writer = SimpleStreamWriter(ss, true);
+    EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t", writer, txn));
+    return ss.str();
+  };
+
+  auto *txn1 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ(select(txn1), "1\t10\t\n2\t20\t\n3\t30\t\n");
+
+  auto *txn2 = bustub_->txn_manager_->Begin();
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 2", noop_writer, txn2));
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (4, 40)", noop_writer, txn2));
+  // txn2 holds exclusive locks on the rows it wrote, the snapshot read does not wait for them.
+  EXPECT_EQ(select(txn1), "1\t10\t\n2\t20\t\n3\t30\t\n");
+  bustub_->txn_manager_->Commit(txn2);
+  delete txn2;
+
+  EXPECT_EQ(select(txn1), "1\t10\t\n2\t20\t\n3\t30\t\n");
+  EXPECT_TRUE(txn1->GetSharedRowLockSet()->empty());
+  EXPECT_TRUE(txn1->GetIntentionSharedTableLockSet()->empty());
+
+  auto *txn3 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ(select(txn3), "1\t10\t\n3\t30\t\n4\t40\t\n");
+
+  // txn1 still needs the deleted row, so the versions survive a collection.
+  bustub_->txn_manager_->CollectVersions(table, bustub_->txn_manager_->GetOldestSnapshot());
+  EXPECT_EQ(select(txn1), "1\t10\t\n2\t20\t\n3\t30\t\n");
+  EXPECT_GT(table->GetVersionStore()->Size(), 0U);
+
+  bustub_->txn_manager_->Commit(txn1);
+  delete txn1;
+  bustub_->txn_manager_->Commit(txn3);
+  delete txn3;
+
+  bustub_->txn_manager_->CollectVersions(table, bustub_->txn_manager_->GetOldestSnapshot());
+  EXPECT_EQ(table->GetVersionStore()->Size(), 0U);
+  auto *txn4 = bustub_->txn_manager_->Begin();
+  EXPECT_EQ(select(txn4), "1\t10\t\n3\t30\t\n4\t40\t\n");
+  bustub_->txn_manager_->Commit(txn4);
+  delete txn4;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotWriteConflictTest) {
+  // txn1 (snapshot) begins, txn2 deletes a row and commits, txn1 tries to delete the same row: first committer wins.
+
+  auto noop_writer = NoopWriter();
+  bustub_->ExecuteSql("CREATE TABLE t (a int, b int);", noop_writer);
+  bustub_->ExecuteSql("INSERT INTO t VALUES (1, 10), (2, 20);", noop_writer);
+
+  auto *txn1 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto *txn2 = bustub_->txn_manager_->Begin();
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 1", noop_writer, txn2));
+  bustub_->txn_manager_->Commit(txn2);
+  delete txn2;
+
+  // A row nobody touched since the snapshot can still be written.
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 2", noop_writer, txn1));
+  EXPECT_FALSE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 1", noop_writer, txn1));
+  CheckAborted(txn1);
+  bustub_->txn_manager_->Abort(txn1);
+  delete txn1;
+
+  auto *txn3 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  std::stringstream ss;
+  auto writer = SimpleStreamWriter(ss, true);
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t", writer, txn3));
+  EXPECT_EQ(ss.str(), "2\t20\t\n");
+  bustub_->txn_manager_->Commit(txn3);
+  delete txn3;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, WriterBesideSnapshotTest) {
+  // txn1 deletes a row while no snapshot runs and still records the version. txn2 (snapshot) begins on another thread
+  // without waiting for txn1 and reads the row through the version store, before and after txn1 commits.
+
+  auto noop_writer = NoopWriter();
+  bustub_->ExecuteSql("CREATE TABLE t (a int, b int);", noop_writer);
+  bustub_->ExecuteSql("INSERT INTO t VALUES (1, 10), (2, 20);", noop_writer);
+  auto *table = bustub_->catalog_->GetTable("t")->table_.get();
+
+  auto *txn1 = bustub_->txn_manager_->Begin();
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 1", noop_writer, txn1));
+  EXPECT_GT(table->GetVersionStore()->Size(), 0U);
+
+  std::atomic<bool> began{false};
+  std::atomic<bool> committed{false};
+  std::stringstream ss1;
+  std::stringstream ss2;
+  std::thread reader([&] {
+    auto *txn2 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+    began = true;
+    auto writer1 = SimpleStreamWriter(ss1, true);
+    EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t", writer1, txn2));
+    while (!committed) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto writer2 = SimpleStreamWriter(ss2, true);
+    EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t", writer2, txn2));
+    bustub_->txn_manager_->Commit(txn2);
+    delete txn2;
+  });
+  for (int i = 0; i < 1000 && !began; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_TRUE(began);
+  bustub_->txn_manager_->Commit(txn1);
+  delete txn1;
+  committed = true;
+  reader.join();
+  EXPECT_EQ(ss1.str(), "1\t10\t\n2\t20\t\n");
+  EXPECT_EQ(ss2.str(), "1\t10\t\n2\t20\t\n");
+
+  auto *txn3 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  std::stringstream ss3;
+  auto writer3 = SimpleStreamWriter(ss3, true);
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t", writer3, txn3));
+  EXPECT_EQ(ss3.str(), "2\t20\t\n");
+  bustub_->txn_manager_->Commit(txn3);
+  delete txn3;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, OptimisticValidationTest) {
+  // txn1 and txn2 (optimistic) both delete the same row; txn1 commits first, so txn2 fails validation at commit.
+
+  auto noop_writer = NoopWriter();
+  bustub_->ExecuteSql("CREATE TABLE t (a int, b int);", noop_writer);
+  bustub_->ExecuteSql("INSERT INTO t VALUES (1, 10), (2, 20);", noop_writer);
+
+  auto *txn1 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::REPEATABLE_READ, ConcurrencyControl::OPTIMISTIC);
+  auto *txn2 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::REPEATABLE_READ, ConcurrencyControl::OPTIMISTIC);
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 1", noop_writer, txn1));
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 1", noop_writer, txn2));
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (3, 30)", noop_writer, txn2));
+  EXPECT_TRUE(bustub_->txn_manager_->Commit(txn1));
+  // txn2 still runs and validates against the word txn1 moved.
+  auto *table = bustub_->catalog_->GetTable("t")->table_.get();
+  EXPECT_GT(table->GetVersionWords()->Size(), 0U);
+  EXPECT_FALSE(bustub_->txn_manager_->Commit(txn2));
+  CheckAborted(txn2);
+  delete txn1;
+  delete txn2;
+  // No optimistic transaction is left to hold a word.
+  EXPECT_EQ(table->GetVersionWords()->Size(), 0U);
+
+  // A read-only optimistic transaction validates against the committed delete, and txn2 installed nothing.
+  auto *txn3 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::REPEATABLE_READ, ConcurrencyControl::OPTIMISTIC);
+  std::stringstream ss;
+  auto writer = SimpleStreamWriter(ss, true);
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t", writer, txn3));
+  EXPECT_EQ(ss.str(), "2\t20\t\n");
+  EXPECT_TRUE(bustub_->txn_manager_->Commit(txn3));
+  CheckCommitted(txn3);
+  delete txn3;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, NextKeyLockTest) {
+  // txn1 range-scans a in [4, 6] through the index. An insert above the next key goes through, while an insert into
+  // the gap between the range and the next key waits until txn1 commits.
+
+  auto noop_writer = NoopWriter();
+  bustub_->ExecuteSql("CREATE TABLE t (a int, b int);", noop_writer);
+  bustub_->ExecuteSql("CREATE INDEX t_a ON t(a);", noop_writer);
+  bustub_->ExecuteSql("INSERT INTO t VALUES (1, 10), (5, 50), (10, 100);", noop_writer);
+
+  auto *txn1 = bustub_->txn_manager_->Begin();
+  std::stringstream ss;
+  auto writer = SimpleStreamWriter(ss, true);
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t WHERE a >= 4 AND a <= 6", writer, txn1));
+  EXPECT_EQ(ss.str(), "5\t50\t\n");
+  // The key in the range and the key right above it.
+  ASSERT_EQ(txn1->GetSharedKeyLockSet()->size(), 1U);
+  EXPECT_EQ(txn1->GetSharedKeyLockSet()->begin()->second.size(), 2U);
+
+  auto *txn2 = bustub_->txn_manager_->Begin();
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (20, 200)", noop_writer, txn2));
+  bustub_->txn_manager_->Commit(txn2);
+  delete txn2;
+
+  std::atomic<bool> inserted{false};
+  std::thread insert_thread([&] {
+    auto *txn3 = bustub_->txn_manager_->Begin();
+    EXPECT_TRUE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (6, 60)", noop_writer, txn3));
+    inserted = true;
+    bustub_->txn_manager_->Commit(txn3);
+    delete txn3;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(inserted);
+
+  // Reading the range again inside txn1 sees no phantom.
+  ss.str("");
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t WHERE a >= 4 AND a <= 6", writer, txn1));
+  EXPECT_EQ(ss.str(), "5\t50\t\n");
+  bustub_->txn_manager_->Commit(txn1);
+  delete txn1;
+
+  insert_thread.join();
+  EXPECT_TRUE(inserted);
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, NextKeyLockWaitTest) {
+  // txn1 inserts a = 6. txn2 range-scans a in [4, 6] and waits for the key lock on 6, while txn1 deletes a = 1 from the
+  // same leaf and commits, which shifts the entries under the scan. The scan reads the range again once it holds its
+  // locks, so it returns 5 and 6.
+
+  auto noop_writer = NoopWriter();
+  bustub_->ExecuteSql("CREATE TABLE t (a int, b int);", noop_writer);
+  bustub_->ExecuteSql("CREATE INDEX t_a ON t(a);", noop_writer);
+  bustub_->ExecuteSql("INSERT INTO t VALUES (1, 10), (5, 50), (7, 70), (10, 100);", noop_writer);
+
+  auto *txn1 = bustub_->txn_manager_->Begin();
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (6, 60)", noop_writer, txn1));
+
+  std::atomic<bool> scanned{false};
+  std::stringstream ss;
+  std::thread scan_thread([&] {
+    auto *txn2 = bustub_->txn_manager_->Begin();
+    auto writer = SimpleStreamWriter(ss, true);
+    EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t WHERE a >= 4 AND a <= 6", writer, txn2));
+    scanned = true;
+    bustub_->txn_manager_->Commit(txn2);
+    delete txn2;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(scanned);
+
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("DELETE FROM t WHERE a = 1", noop_writer, txn1));
+  bustub_->txn_manager_->Commit(txn1);
+  delete txn1;
+
+  scan_thread.join();
+  EXPECT_EQ(ss.str(), "5\t50\t\n6\t60\t\n");
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, ReadOnlyTest) {
+  // txn1 (read-only, repeatable read) scans t under one table lock, and may not write.
+  // txn2 (read-only, snapshot) keeps its snapshot while txn3 inserts, without taking any lock.
+  // txn4 (read-only, repeatable read) reads one row through an index without blocking txn5's insert.
+
+  auto noop_writer = NoopWriter();
+  bustub_->ExecuteSql("CREATE TABLE t (a int, b int);", noop_writer);
+  bustub_->ExecuteSql("INSERT INTO t VALUES (1, 10), (2, 20);", noop_writer);
+
+  auto select = [&](Transaction *txn) {
+    std::stringstream ss;
+    auto writer = SimpleStreamWriter(ss, true);
+    EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t", writer, txn));
+    return ss.str();
+  };
+
+  auto *txn1 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::REPEATABLE_READ,
+                                            ConcurrencyControl::TWO_PHASE_LOCKING, AccessMode::READ_ONLY);
+  EXPECT_EQ(txn1->GetWriteSet(), nullptr);
+  EXPECT_EQ(select(txn1), "1\t10\t\n2\t20\t\n");
+  EXPECT_EQ(txn1->GetSharedTableLockSet()->size(), 1U);
+  EXPECT_TRUE(txn1->GetIntentionSharedTableLockSet()->empty());
+  EXPECT_TRUE(txn1->GetSharedRowLockSet()->empty());
+  EXPECT_FALSE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (3, 30)", noop_writer, txn1));
+  EXPECT_TRUE(bustub_->txn_manager_->Commit(txn1));
+  EXPECT_EQ(txn1->GetState(), TransactionState::COMMITTED);
+  EXPECT_TRUE(txn1->GetSharedTableLockSet()->empty());
+  delete txn1;
+
+  auto *txn2 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION,
+                                            ConcurrencyControl::TWO_PHASE_LOCKING, AccessMode::READ_ONLY);
+  EXPECT_EQ(select(txn2), "1\t10\t\n2\t20\t\n");
+  auto *txn3 = bustub_->txn_manager_->Begin();
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (3, 30)", noop_writer, txn3));
+  bustub_->txn_manager_->Commit(txn3);
+  delete txn3;
+  EXPECT_EQ(select(txn2), "1\t10\t\n2\t20\t\n");
+  EXPECT_TRUE(txn2->GetSharedTableLockSet()->empty());
+  EXPECT_TRUE(bustub_->txn_manager_->Commit(txn2));
+  delete txn2;
+
+  // A point read through an index only takes IS and key locks, so a writer can still insert into t
+  bustub_->ExecuteSql("CREATE INDEX t_a ON t(a);", noop_writer);
+  auto *txn4 = bustub_->txn_manager_->Begin(nullptr, IsolationLevel::REPEATABLE_READ,
+                                            ConcurrencyControl::TWO_PHASE_LOCKING, AccessMode::READ_ONLY);
+  std::stringstream ss;
+  auto writer = SimpleStreamWriter(ss, true);
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("SELECT * FROM t WHERE a = 1", writer, txn4));
+  EXPECT_EQ(ss.str(), "1\t10\t\n");
+  EXPECT_TRUE(txn4->GetSharedTableLockSet()->empty());
+  EXPECT_EQ(txn4->GetIntentionSharedTableLockSet()->size(), 1U);
+  auto *txn5 = bustub_->txn_manager_->Begin();
+  EXPECT_TRUE(bustub_->ExecuteSqlTxn("INSERT INTO t VALUES (4, 40)", noop_writer, txn5));
+  EXPECT_TRUE(bustub_->txn_manager_->Commit(txn5));
+  delete txn5;
+  EXPECT_TRUE(bustub_->txn_manager_->Commit(txn4));
+  delete txn4;
+}
+
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, TransactionRegistryTest) {
+  // Threads begin transactions concurrently: every id is unique, and a transaction can be found until it finishes.
+
+  auto *txn_mgr = bustub_->txn_manager_;
+  constexpr int num_threads = 4;
+  constexpr int txns_per_thread = 200;
+  std::vector<std::vector<txn_id_t>> ids(num_threads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([txn_mgr, &ids, i] {
+      for (int j = 0; j < txns_per_thread; j++) {
+        auto *txn = txn_mgr->Begin();
+        ids[i].push_back(txn->GetTransactionId());
+        EXPECT_EQ(txn, TransactionManager::GetTransaction(txn->GetTransactionId()));
+        if (j % 2 == 0) {
+          txn_mgr->Commit(txn);
+        } else {
+          txn_mgr->Abort(txn);
+        }
+        EXPECT_EQ(nullptr, TransactionManager::GetTransaction(txn->GetTransactionId()));
+        delete txn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::set<txn_id_t> unique_ids;
+  for (const auto &thread_ids : ids) {
+    unique_ids.insert(thread_ids.begin(), thread_ids.end());
+  }
+  EXPECT_EQ(num_threads * txns_per_thread, unique_ids.size());
+}
+
 }  // namespace bustub
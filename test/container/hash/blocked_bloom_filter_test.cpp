@@ -0,0 +1,47 @@
+/**
+ * blocked_bloom_filter_test.cpp
+ */
+
+#include "container/hash/blocked_bloom_filter.h"
+
+#include "gtest/gtest.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+TEST(BlockedBloomFilterTest, SampleTest) {
+  BlockedBloomFilter filter(1000);
+
+  for (int i = 0; i < 1000; i++) {
+    auto value = ValueFactory::GetIntegerValue(i * 2);
+    filter.Insert(BlockedBloomFilter::HashKey(value));
+  }
+
+  // no false negatives
+  for (int i = 0; i < 1000; i++) {
+    auto value = ValueFactory::GetIntegerValue(i * 2);
+    EXPECT_TRUE(filter.MayContain(BlockedBloomFilter::HashKey(value)));
+  }
+
+  // integer and bigint keys hash the same way
+  auto bigint = ValueFactory::GetBigIntValue(42);
+  EXPECT_TRUE(filter.MayContain(BlockedBloomFilter::HashKey(bigint)));
+
+  // a decimal holding a whole number equals the integer, so it must hash the same way
+  auto decimal = ValueFactory::GetDecimalValue(42.0);
+  EXPECT_EQ(BlockedBloomFilter::HashKey(decimal), BlockedBloomFilter::HashKey(ValueFactory::GetIntegerValue(42)));
+  EXPECT_EQ(BlockedBloomFilter::HashKey(ValueFactory::GetDecimalValue(-0.0)),
+            BlockedBloomFilter::HashKey(ValueFactory::GetIntegerValue(0)));
+
+  // the false positive rate of odd keys stays low
+  int false_positives = 0;
+  for (int i = 0; i < 10000; i++) {
+    auto value = ValueFactory::GetIntegerValue(i * 2 + 1);
+    if (filter.MayContain(BlockedBloomFilter::HashKey(value))) {
+      false_positives++;
+    }
+  }
+  EXPECT_LT(false_positives, 500);
+}
+
+}  // namespace bustub
@@ -0,0 +1,130 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_join_executor_test.cpp
+//
+// Identification: test/execution/hash_join_executor_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "execution/executors/hash_join_executor.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "concurrency/transaction_manager.h"
+#include "execution/executor_context.h"
+#include "execution/executors/seq_scan_executor.h"
+#include "execution/expressions/column_value_expression.h"
+#include "execution/plans/seq_scan_plan.h"
+#include "execution/plans/values_plan.h"
+#include "fmt/format.h"
+#include "gtest/gtest.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/** Build side that yields a different set of keys every time it is initialized */
+class RoundsExecutor : public AbstractExecutor {
+ public:
+  RoundsExecutor(ExecutorContext *exec_ctx, SchemaRef schema, std::vector<std::vector<int>> rounds)
+      : AbstractExecutor(exec_ctx), schema_(std::move(schema)), rounds_(std::move(rounds)) {}
+
+  void Init() override {
+    round_++;
+    cursor_ = 0;
+  }
+
+  auto Next(Tuple *tuple, RID *rid) -> bool override {
+    const auto &keys = rounds_[round_ - 1];
+    if (cursor_ == keys.size()) {
+      return false;
+    }
+    *tuple = Tuple{{ValueFactory::GetIntegerValue(keys[cursor_++])}, schema_.get()};
+    return true;
+  }
+
+  auto GetOutputSchema() const -> const Schema & override { return *schema_; }
+
+ private:
+  SchemaRef schema_;
+  std::vector<std::vector<int>> rounds_;
+  size_t round_{0};
+  size_t cursor_{0};
+};
+
+// NOLINTNEXTLINE
+TEST(HashJoinExecutorTest, ReInitRebuildsBloomFilter) {
+  const int num = 1000;
+  auto bustub = std::make_unique<BustubInstance>();
+  std::stringstream result;
+  auto writer = SimpleStreamWriter(result, true, " ");
+  bustub->ExecuteSql("CREATE TABLE a (x int, y int);", writer);
+  std::string query = "INSERT INTO a VALUES ";
+  for (int i = 0; i < 2 * num; i++) {
+    query += fmt::format("({}, {}){}", i, i * 10, i == 2 * num - 1 ? ";" : ", ");
+  }
+  bustub->ExecuteSql(query, writer);
+
+  // 第一轮建表用[0, num)，第二轮用[num, 2 * num)，两轮的key数一样，过滤器大小也一样。
+  std::vector<int> first;
+  std::vector<int> second;
+  for (int i = 0; i < num; i++) {
+    first.push_back(i);
+    second.push_back(num + i);
+  }
+
+  auto *txn = bustub->txn_manager_->Begin();
+  ExecutorContext exec_ctx{txn, bustub->catalog_, bustub->buffer_pool_manager_, bustub->txn_manager_,
+                           bustub->lock_manager_};
+  auto *table_info = bustub->catalog_->GetTable("a");
+  auto left_schema = std::make_shared<const Schema>(table_info->schema_);
+  auto right_schema = std::make_shared<const Schema>(std::vector<Column>{Column{"b.x", TypeId::INTEGER}});
+  auto out_schema = std::make_shared<const Schema>(std::vector<Column>{
+      Column{"a.x", TypeId::INTEGER}, Column{"a.y", TypeId::INTEGER}, Column{"b.x", TypeId::INTEGER}});
+  auto scan_plan = std::make_shared<SeqScanPlanNode>(left_schema, table_info->oid_, "a");
+  auto left_key = std::make_shared<ColumnValueExpression>(0, 0, TypeId::INTEGER);
+  auto right_key = std::make_shared<ColumnValueExpression>(1, 0, TypeId::INTEGER);
+  // 右孩子是上面手写的执行器，计划里只放一个同样schema的空values节点占位。
+  auto right_plan = std::make_shared<ValuesPlanNode>(right_schema, std::vector<std::vector<AbstractExpressionRef>>{});
+  HashJoinPlanNode join_plan{out_schema, scan_plan, right_plan, left_key, right_key, JoinType::INNER};
+
+  auto scan = std::make_unique<SeqScanExecutor>(&exec_ctx, scan_plan.get());
+  auto *scan_ptr = scan.get();
+  HashJoinExecutor join{&exec_ctx, &join_plan, std::move(scan),
+                        std::make_unique<RoundsExecutor>(&exec_ctx, right_schema, std::vector{first, second})};
+
+  for (const auto &keys : {first, second}) {
+    join.Init();
+    std::vector<int> joined;
+    Tuple tuple;
+    RID rid;
+    while (join.Next(&tuple, &rid)) {
+      joined.push_back(tuple.GetValue(&join_plan.OutputSchema(), 0).GetAs<int32_t>());
+      EXPECT_EQ(joined.back(), tuple.GetValue(&join_plan.OutputSchema(), 2).GetAs<int32_t>());
+    }
+    EXPECT_EQ(keys, joined);
+  }
+
+  // 再从头扫一遍，第二轮装进扫描的过滤器只应该放过第一轮key里的少量误判，旧的位不能留下来。
+  scan_ptr->Init();
+  int stale = 0;
+  Tuple tuple;
+  RID rid;
+  while (scan_ptr->Next(&tuple, &rid)) {
+    stale += tuple.GetValue(left_schema.get(), 0).GetAs<int32_t>() < num ? 1 : 0;
+  }
+  EXPECT_LT(stale, num / 20);
+
+  bustub->txn_manager_->Commit(txn);
+  delete txn;
+}
+
+}  // namespace bustub
@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// free_space_map_test.cpp
+//
+// Identification: test/table/free_space_map_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "gtest/gtest.h"
+#include "storage/table/free_space_map.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+TEST(FreeSpaceMapTest, SampleTest) {
+  FreeSpaceMap map;
+  EXPECT_EQ(INVALID_PAGE_ID, map.FindPage(1));
+
+  map.Update(1, 100);
+  map.Update(2, 1000);
+  map.Update(3, 3000);
+  EXPECT_EQ(3, map.Size());
+
+  // the page with the least space that is still enough
+  EXPECT_EQ(1, map.FindPage(10));
+  EXPECT_EQ(2, map.FindPage(500));
+  EXPECT_EQ(3, map.FindPage(2000));
+  EXPECT_EQ(INVALID_PAGE_ID, map.FindPage(3500));
+
+  // categories round free space down, so a page is never handed out for more than it has
+  EXPECT_EQ(INVALID_PAGE_ID, map.FindPage(3000 + 1));
+
+  map.Update(3, 10);
+  EXPECT_EQ(INVALID_PAGE_ID, map.FindPage(2000));
+  EXPECT_EQ(2, map.FindPage(500));
+  EXPECT_EQ(3, map.Size());
+}
+
+TEST(FreeSpaceMapTest, TableHeapReuseTest) {
+  Schema schema{std::vector<Column>{{"a", TypeId::INTEGER}, {"b", TypeId::VARCHAR, 100}}};
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(50, disk_manager);
+  auto *lock_manager = new LockManager();
+  auto *log_manager = new LogManager(disk_manager);
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, log_manager, transaction);
+
+  std::vector<RID> rids;
+  for (int i = 0; i < 1000; ++i) {
+    RID rid;
+    Tuple tuple{{ValueFactory::GetIntegerValue(i), ValueFactory::GetVarcharValue(std::string(50, 'x'))}, &schema};
+    ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+    rids.push_back(rid);
+  }
+  std::set<page_id_t> pages;
+  for (const auto &rid : rids) {
+    pages.insert(rid.GetPageId());
+  }
+
+  // free up the first page: once the last page is full, new tuples should go there instead of into a new page
+  page_id_t first_page_id = rids[0].GetPageId();
+  int freed = 0;
+  for (const auto &rid : rids) {
+    if (rid.GetPageId() == first_page_id) {
+      table->MarkDelete(rid, transaction);
+      table->ApplyDelete(rid, transaction);
+      freed++;
+    }
+  }
+  int reused = 0;
+  for (int i = 0; i < freed; ++i) {
+    RID rid;
+    Tuple tuple{{ValueFactory::GetIntegerValue(i), ValueFactory::GetVarcharValue(std::string(50, 'y'))}, &schema};
+    ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+    EXPECT_EQ(1, pages.count(rid.GetPageId()));
+    reused += rid.GetPageId() == first_page_id ? 1 : 0;
+  }
+  EXPECT_GT(reused, 0);
+
+  // a heap opened from its first page rebuilds the map and keeps filling the same pages
+  TableHeap reopened(buffer_pool_manager, lock_manager, log_manager, table->GetFirstPageId());
+  RID rid;
+  Tuple tuple{{ValueFactory::GetIntegerValue(0), ValueFactory::GetVarcharValue(std::string(50, 'z'))}, &schema};
+  ASSERT_TRUE(reopened.InsertTuple(tuple, &rid, transaction));
+  EXPECT_EQ(1, pages.count(rid.GetPageId()));
+
+  disk_manager->ShutDown();
+  remove("test.db");  // remove db file
+  remove("test.log");
+  delete table;
+  delete log_manager;
+  delete lock_manager;
+  delete buffer_pool_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+}  // namespace bustub
@@ -14,13 +14,16 @@
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include "concurrency/transaction_manager.h"
 #include "gtest/gtest.h"
 #include "logging/common.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/tuple.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 // NOLINTNEXTLINE
@@ -71,4 +74,144 @@ TEST(TupleTest, DISABLED_TableHeapTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(TupleTest, ConcatTest) {
+  Schema left_schema{std::vector<Column>{{"a", TypeId::INTEGER}, {"b", TypeId::VARCHAR, 20}}};
+  Schema right_schema{std::vector<Column>{{"c", TypeId::VARCHAR, 20}, {"d", TypeId::BIGINT}}};
+  std::vector<Column> cols = left_schema.GetColumns();
+  cols.insert(cols.end(), right_schema.GetColumns().begin(), right_schema.GetColumns().end());
+  Schema schema{cols};
+
+  Tuple left{{ValueFactory::GetIntegerValue(1), ValueFactory::GetVarcharValue("left")}, &left_schema};
+  Tuple right{{ValueFactory::GetVarcharValue("right side"), ValueFactory::GetBigIntValue(2)}, &right_schema};
+  Tuple joined{left, &left_schema, right, &right_schema};
+
+  Tuple expected{{ValueFactory::GetIntegerValue(1), ValueFactory::GetVarcharValue("left"),
+                  ValueFactory::GetVarcharValue("right side"), ValueFactory::GetBigIntValue(2)},
+                 &schema};
+  ASSERT_EQ(expected.GetLength(), joined.GetLength());
+  for (uint32_t i = 0; i < schema.GetColumnCount(); i++) {
+    EXPECT_EQ(CmpBool::CmpTrue, expected.GetValue(&schema, i).CompareEquals(joined.GetValue(&schema, i)));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, PredicateScanTest) {
+  Schema schema{std::vector<Column>{{"a", TypeId::INTEGER}, {"b", TypeId::VARCHAR, 20}}};
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(50, disk_manager);
+  auto *lock_manager = new LockManager();
+  auto *log_manager = new LogManager(disk_manager);
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, log_manager, transaction);
+
+  for (int i = 0; i < 2000; ++i) {
+    RID rid;
+    Tuple tuple{{ValueFactory::GetIntegerValue(i), ValueFactory::GetVarcharValue(std::to_string(i))}, &schema};
+    table->InsertTuple(tuple, &rid, transaction);
+  }
+
+  // only every third tuple is copied out of the pages; the first tuple fails the predicate as well
+  TableIterator itr = table->Begin(transaction);
+  itr.SetPredicate([&](const Tuple &tuple) { return tuple.GetValue(&schema, 0).GetAs<int32_t>() % 3 == 1; });
+  int expected = 1;
+  while (itr != table->End()) {
+    Tuple tuple = std::move(*itr.operator->());
+    EXPECT_TRUE(tuple.IsAllocated());
+    EXPECT_EQ(expected, tuple.GetValue(&schema, 0).GetAs<int32_t>());
+    EXPECT_EQ(std::to_string(expected), tuple.GetValue(&schema, 1).ToString());
+    expected += 3;
+    ++itr;
+  }
+  EXPECT_EQ(2002, expected);
+
+  disk_manager->ShutDown();
+  remove("test.db");  // remove db file
+  remove("test.log");
+  delete table;
+  delete log_manager;
+  delete lock_manager;
+  delete buffer_pool_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, AppendBatchTest) {
+  Schema schema{std::vector<Column>{{"a", TypeId::INTEGER}, {"b", TypeId::VARCHAR, 20}}};
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManagerInstance(50, disk_manager);
+  auto *lock_manager = new LockManager();
+  auto *log_manager = new LogManager(disk_manager);
+  auto *txn_mgr = new TransactionManager(lock_manager, log_manager);
+  auto *transaction = txn_mgr->Begin();
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, log_manager, transaction);
+
+  RID first_rid;
+  Tuple first{{ValueFactory::GetIntegerValue(-1), ValueFactory::GetVarcharValue("first")}, &schema};
+  ASSERT_TRUE(table->InsertTuple(first, &first_rid, transaction));
+  txn_mgr->Commit(transaction);
+  delete transaction;
+
+  // the batch lands on new pages behind the existing one, slot after slot
+  transaction = txn_mgr->Begin();
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < 2000; ++i) {
+    tuples.emplace_back(std::vector<Value>{ValueFactory::GetIntegerValue(i),
+                                           ValueFactory::GetVarcharValue(std::to_string(i))},
+                        &schema);
+  }
+  std::vector<RID> rids;
+  ASSERT_TRUE(table->AppendBatch(tuples, &rids, transaction));
+  ASSERT_EQ(tuples.size(), rids.size());
+  EXPECT_NE(first_rid.GetPageId(), rids[0].GetPageId());
+  EXPECT_EQ(0, rids[0].GetSlotNum());
+  for (size_t i = 1; i < rids.size(); ++i) {
+    if (rids[i].GetPageId() == rids[i - 1].GetPageId()) {
+      EXPECT_EQ(rids[i - 1].GetSlotNum() + 1, rids[i].GetSlotNum());
+    } else {
+      EXPECT_EQ(0, rids[i].GetSlotNum());
+    }
+  }
+
+  // one write set entry per page, together covering the whole batch
+  uint32_t covered = 0;
+  for (const auto &record : *transaction->GetWriteSet()) {
+    EXPECT_EQ(WType::INSERT, record.wtype_);
+    covered += record.count_;
+  }
+  EXPECT_GT(transaction->GetWriteSet()->size(), 1);
+  EXPECT_EQ(tuples.size(), covered);
+
+  int expected = -1;
+  for (auto itr = table->Begin(transaction); itr != table->End(); ++itr) {
+    EXPECT_EQ(expected, itr->GetValue(&schema, 0).GetAs<int32_t>());
+    expected++;
+  }
+  EXPECT_EQ(2000, expected);
+
+  // aborting undoes every appended tuple
+  txn_mgr->Abort(transaction);
+  delete transaction;
+  transaction = txn_mgr->Begin();
+  int count = 0;
+  for (auto itr = table->Begin(transaction); itr != table->End(); ++itr) {
+    EXPECT_EQ(first_rid, itr->GetRid());
+    count++;
+  }
+  EXPECT_EQ(1, count);
+  txn_mgr->Commit(transaction);
+  delete transaction;
+
+  disk_manager->ShutDown();
+  remove("test.db");  // remove db file
+  remove("test.log");
+  delete table;
+  delete txn_mgr;
+  delete log_manager;
+  delete lock_manager;
+  delete buffer_pool_manager;
+  delete disk_manager;
+}
+
 }  // namespace bustub
@@ -114,20 +114,23 @@ auto ParseBool(const std::string &str) -> bool {
   throw bustub::Exception(fmt::format("unexpected arg: {}", str));
 }
 
-// NOLINTNEXTLINE
-auto main(int argc, char **argv) -> int {
-  argparse::ArgumentParser program("bustub-terrier-bench");
-  program.add_argument("--duration").help("run terrier bench for n milliseconds");
-  program.add_argument("--force-create-index").help("create index in terrier bench");
-  program.add_argument("--force-enable-update").help("use update statement in terrier bench");
-
-  try {
-    program.parse_args(argc, argv);
-  } catch (const std::runtime_error &err) {
-    std::cerr << err.what() << std::endl;
-    std::cerr << program;
-    return 1;
+auto ParseConcurrencyControl(const std::string &str) -> std::vector<bustub::ConcurrencyControl> {
+  if (str == "2pl") {
+    return {bustub::ConcurrencyControl::TWO_PHASE_LOCKING};
+  }
+  if (str == "occ") {
+    return {bustub::ConcurrencyControl::OPTIMISTIC};
   }
+  if (str == "both") {
+    return {bustub::ConcurrencyControl::TWO_PHASE_LOCKING, bustub::ConcurrencyControl::OPTIMISTIC};
+  }
+  throw bustub::Exception(fmt::format("unexpected arg: {}", str));
+}
+
+// run the workload once on a fresh instance, all benchmark transactions using the given concurrency control
+void RunTerrierBench(bustub::ConcurrencyControl cc, bool enable_index, bool enable_update, uint64_t duration_ms) {
+  std::cerr << "x: concurrency control "
+            << (cc == bustub::ConcurrencyControl::OPTIMISTIC ? "optimistic" : "two-phase locking") << std::endl;
 
   auto bustub = std::make_unique<bustub::BustubInstance>();
   auto writer = bustub::SimpleStreamWriter(std::cerr);
@@ -137,18 +140,6 @@ auto main(int argc, char **argv) -> int {
   std::cerr << "x: create schema" << std::endl;
   bustub->ExecuteSql(schema, writer);
 
-  // create index
-
-#ifdef TERRIER_BENCH_ENABLE_INDEX
-  bool enable_index = true;
-#else
-  bool enable_index = false;
-#endif
-
-  if (program.present("--force-create-index")) {
-    enable_index = ParseBool(program.get("--force-create-index"));
-  }
-
   if (enable_index) {
     auto schema = "CREATE INDEX nftid on nft(id);";
     std::cerr << "x: create index" << std::endl;
@@ -157,29 +148,6 @@ auto main(int argc, char **argv) -> int {
     std::cerr << "x: create index disabled" << std::endl;
   }
 
-#ifdef TERRIER_BENCH_ENABLE_UPDATE
-  bool enable_update = true;
-#else
-  bool enable_update = false;
-#endif
-  if (program.present("--force-enable-update")) {
-    enable_update = ParseBool(program.get("--force-enable-update"));
-  }
-
-  if (enable_update) {
-    std::cerr << "x: use update statement" << std::endl;
-  } else {
-    std::cerr << "x: use insert + delete" << std::endl;
-  }
-
-  uint64_t duration_ms = 30000;
-
-  if (program.present("--duration")) {
-    duration_ms = std::stoi(program.get("--duration"));
-  }
-
-  std::cerr << "x: benchmark for " << duration_ms << "ms" << std::endl;
-
   // initialize data
   std::cerr << "x: initialize data" << std::endl;
   std::string query = "INSERT INTO nft VALUES ";
@@ -213,7 +181,7 @@ auto main(int argc, char **argv) -> int {
   total_metrics.Begin();
 
   for (size_t thread_id = 0; thread_id < BUSTUB_TERRIER_THREAD; thread_id++) {
-    threads.emplace_back(std::thread([thread_id, &bustub, enable_update, duration_ms, &total_metrics] {
+    threads.emplace_back(std::thread([thread_id, &bustub, cc, enable_update, duration_ms, &total_metrics] {
       const size_t nft_range_size = BUSTUB_NFT_NUM / BUSTUB_TERRIER_THREAD;
       const size_t nft_range_begin = thread_id * nft_range_size;
       const size_t nft_range_end = (thread_id + 1) * nft_range_size;
@@ -233,7 +201,7 @@ auto main(int argc, char **argv) -> int {
         bool txn_success = true;
 
         if (enable_update) {
-          auto txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ);
+          auto txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ, cc);
           std::string query = fmt::format("UPDATE nft SET terrier = {} WHERE id = {}", terrier_id, nft_id);
           if (!bustub->ExecuteSqlTxn(query, writer, txn)) {
             txn_success = false;
@@ -244,16 +212,17 @@ auto main(int argc, char **argv) -> int {
             exit(1);
           }
 
-          if (txn_success) {
-            bustub->txn_manager_->Commit(txn);
+          if (txn_success && bustub->txn_manager_->Commit(txn)) {
             metrics.TxnCommitted();
+          } else if (txn_success) {
+            metrics.TxnAborted();
           } else {
             bustub->txn_manager_->Abort(txn);
             metrics.TxnAborted();
           }
           delete txn;
         } else {
-          auto txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ);
+          auto txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ, cc);
 
           std::string query = fmt::format("DELETE FROM nft WHERE id = {}", nft_id);
           if (!bustub->ExecuteSqlTxn(query, writer, txn)) {
@@ -269,11 +238,14 @@ auto main(int argc, char **argv) -> int {
             bustub->txn_manager_->Abort(txn);
             metrics.TxnAborted();
             delete txn;
+          } else if (!bustub->txn_manager_->Commit(txn)) {
+            // an optimistic delete that failed validation was already aborted
+            metrics.TxnAborted();
+            delete txn;
           } else {
-            bustub->txn_manager_->Commit(txn);
             delete txn;
 
-            txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ);
+            txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ, cc);
 
             query = fmt::format("INSERT INTO nft VALUES ({}, {})", nft_id, terrier_id);
             if (!bustub->ExecuteSqlTxn(query, writer, txn)) {
@@ -288,9 +260,10 @@ auto main(int argc, char **argv) -> int {
             if (!txn_success) {
               bustub->txn_manager_->Abort(txn);
               metrics.TxnAborted();
-            } else {
-              bustub->txn_manager_->Commit(txn);
+            } else if (bustub->txn_manager_->Commit(txn)) {
               metrics.TxnCommitted();
+            } else {
+              metrics.TxnAborted();
             }
             delete txn;
           }
@@ -304,7 +277,7 @@ auto main(int argc, char **argv) -> int {
   }
 
   for (size_t thread_id = 0; thread_id < BUSTUB_TERRIER_THREAD; thread_id++) {
-    threads.emplace_back(std::thread([thread_id, &bustub, duration_ms, &total_metrics] {
+    threads.emplace_back(std::thread([thread_id, &bustub, cc, duration_ms, &total_metrics] {
       std::random_device r;
       std::default_random_engine gen(r());
       std::uniform_int_distribution<int> terrier_uniform_dist(0, BUSTUB_TERRIER_CNT - 1);
@@ -317,7 +290,7 @@ auto main(int argc, char **argv) -> int {
         auto writer = bustub::SimpleStreamWriter(ss, true);
         auto terrier_id = terrier_uniform_dist(gen);
 
-        auto txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ);
+        auto txn = bustub->txn_manager_->Begin(nullptr, bustub::IsolationLevel::REPEATABLE_READ, cc);
         bool txn_success = true;
 
         std::string query = fmt::format("SELECT count(*) FROM nft WHERE terrier = {}", terrier_id);
@@ -325,9 +298,10 @@ auto main(int argc, char **argv) -> int {
           txn_success = false;
         }
 
-        if (txn_success) {
-          bustub->txn_manager_->Commit(txn);
+        if (txn_success && bustub->txn_manager_->Commit(txn)) {
           metrics.TxnCommitted();
+        } else if (txn_success) {
+          metrics.TxnAborted();
         } else {
           bustub->txn_manager_->Abort(txn);
           metrics.TxnAborted();
@@ -359,6 +333,65 @@ auto main(int argc, char **argv) -> int {
   }
 
   total_metrics.Report();
+}
+
+// NOLINTNEXTLINE
+auto main(int argc, char **argv) -> int {
+  argparse::ArgumentParser program("bustub-terrier-bench");
+  program.add_argument("--duration").help("run terrier bench for n milliseconds");
+  program.add_argument("--force-create-index").help("create index in terrier bench");
+  program.add_argument("--force-enable-update").help("use update statement in terrier bench");
+  program.add_argument("--concurrency-control").help("2pl, occ, or both to compare them on the same workload");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+  }
+
+#ifdef TERRIER_BENCH_ENABLE_INDEX
+  bool enable_index = true;
+#else
+  bool enable_index = false;
+#endif
+
+  if (program.present("--force-create-index")) {
+    enable_index = ParseBool(program.get("--force-create-index"));
+  }
+
+#ifdef TERRIER_BENCH_ENABLE_UPDATE
+  bool enable_update = true;
+#else
+  bool enable_update = false;
+#endif
+  if (program.present("--force-enable-update")) {
+    enable_update = ParseBool(program.get("--force-enable-update"));
+  }
+
+  if (enable_update) {
+    std::cerr << "x: use update statement" << std::endl;
+  } else {
+    std::cerr << "x: use insert + delete" << std::endl;
+  }
+
+  uint64_t duration_ms = 30000;
+
+  if (program.present("--duration")) {
+    duration_ms = std::stoi(program.get("--duration"));
+  }
+
+  std::cerr << "x: benchmark for " << duration_ms << "ms" << std::endl;
+
+  std::vector<bustub::ConcurrencyControl> modes{bustub::ConcurrencyControl::TWO_PHASE_LOCKING};
+  if (program.present("--concurrency-control")) {
+    modes = ParseConcurrencyControl(program.get("--concurrency-control"));
+  }
+
+  for (auto cc : modes) {
+    RunTerrierBench(cc, enable_index, enable_update, duration_ms);
+  }
 
   return 0;
 }